@@ -0,0 +1,108 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "grid/grid.hpp"
+
+// Compares the retention time smoothing pass of Grid::resample against a
+// reference implementation with the previous memory layout. The grid is
+// stored in row major order, with n m/z columns and m retention time rows.
+//
+// Usage: grid_benchmark [n] [m] [kernel_half_width] [repetitions] [threads]
+
+// Previous layout: the kernel is applied cell by cell, striding a full row
+// between consecutive accesses.
+static std::vector<double> smooth_rt_strided(const Grid::Grid &grid,
+                                             double sigma_rt,
+                                             uint64_t rt_kernel_hw) {
+    auto smoothed_data = std::vector<double>(grid.n * grid.m);
+    std::vector<double> kernel;
+    for (size_t j = 0; j < grid.m; ++j) {
+        double current_rt = grid.bins_rt[j];
+        size_t min_k = 0;
+        if (j >= rt_kernel_hw) {
+            min_k = j - rt_kernel_hw;
+        }
+        size_t max_k = grid.m - 1;
+        if ((j + rt_kernel_hw) < grid.m) {
+            max_k = j + rt_kernel_hw;
+        }
+        kernel.resize(max_k - min_k + 1);
+        double sum_weights = 0;
+        for (size_t k = min_k; k <= max_k; ++k) {
+            double a = (current_rt - grid.bins_rt[k]) / sigma_rt;
+            kernel[k - min_k] = std::exp(-0.5 * (a * a));
+            sum_weights += kernel[k - min_k];
+        }
+        for (size_t i = 0; i < grid.n; ++i) {
+            double sum_weighted_values = 0;
+            for (size_t k = min_k; k <= max_k; ++k) {
+                sum_weighted_values +=
+                    kernel[k - min_k] * grid.data[i + k * grid.n];
+            }
+            smoothed_data[i + j * grid.n] = sum_weighted_values / sum_weights;
+        }
+    }
+    return smoothed_data;
+}
+
+template <typename Function>
+static double time_seconds(size_t repetitions, Function func) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < repetitions; ++i) {
+        func();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count() / repetitions;
+}
+
+int main(int argc, char *argv[]) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 30000;
+    size_t m = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 400;
+    size_t hw = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 4;
+    size_t repetitions = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 5;
+    size_t max_threads = argc > 5 ? std::strtoull(argv[5], nullptr, 10) : 1;
+    if (n == 0 || m == 0 || repetitions == 0 || max_threads == 0) {
+        std::cerr << "error: invalid grid dimensions, repetitions or threads"
+                  << std::endl;
+        return -1;
+    }
+
+    // Evenly spaced retention time bins with pseudo random grid data.
+    Grid::Grid grid = {};
+    grid.n = n;
+    grid.m = m;
+    grid.bins_rt.resize(m);
+    for (size_t j = 0; j < m; ++j) {
+        grid.bins_rt[j] = j;
+    }
+    grid.data.resize(n * m);
+    uint64_t state = 42;
+    for (auto &value : grid.data) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        value = static_cast<double>(state >> 11) / (1ULL << 53);
+    }
+    double sigma_rt = hw / 3.0;
+
+    std::vector<double> strided;
+    std::vector<double> blocked;
+    double strided_time = time_seconds(repetitions, [&]() {
+        strided = smooth_rt_strided(grid, sigma_rt, hw);
+    });
+    double blocked_time = time_seconds(repetitions, [&]() {
+        blocked = Grid::smooth_rt(grid, sigma_rt, hw, max_threads);
+    });
+    bool same_results = strided == blocked;
+
+    std::cout << "grid: " << n << "x" << m << ", kernel half width: " << hw
+              << ", threads: " << max_threads << std::endl;
+    std::cout << "strided: " << strided_time << " s" << std::endl;
+    std::cout << "Grid::smooth_rt: " << blocked_time << " s" << std::endl;
+    std::cout << "speedup: " << strided_time / blocked_time << "x"
+              << std::endl;
+    std::cout << "same results: " << (same_results ? "yes" : "no")
+              << std::endl;
+    return same_results ? 0 : -1;
+}
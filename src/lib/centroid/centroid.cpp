@@ -1,57 +1,415 @@
 #include <algorithm>
-#include <thread>
+#include <mutex>
 
 #include "Eigen/Dense"
 
 #include "centroid/centroid.hpp"
 #include "utils/search.hpp"
+#include "utils/thread_pool.hpp"
 
 #define PI 3.141592653589793238
 
-std::vector<Centroid::LocalMax> Centroid::find_local_maxima(
-    const Grid::Grid &grid) {
+// Split the range [0, num_items) in contiguous chunks processed by up to
+// max_threads threads of the shared pool. Each chunk appends its results to
+// its own output vector, and the outputs are concatenated in order.
+template <typename Output, typename Func>
+static std::vector<Output> parallel_collect(size_t num_items,
+                                            size_t max_threads, Func func) {
+    std::vector<std::pair<size_t, std::vector<Output>>> outputs;
+    std::mutex outputs_mutex;
+    ThreadPool::parallel_for(
+        num_items, max_threads, [&](size_t begin, size_t end) {
+            std::vector<Output> chunk;
+            func(begin, end, chunk);
+            std::lock_guard<std::mutex> lock(outputs_mutex);
+            outputs.emplace_back(begin, std::move(chunk));
+        });
+    if (outputs.size() == 1) {
+        return std::move(outputs[0].second);
+    }
+    std::sort(outputs.begin(), outputs.end(),
+              [](const auto &a, const auto &b) { return a.first < b.first; });
+    std::vector<Output> output;
+    for (const auto &chunk : outputs) {
+        output.insert(output.end(), chunk.second.begin(), chunk.second.end());
+    }
+    return output;
+}
+
+// Append the indexes of the points of row j that are local maxima candidates.
+// The comparisons are first stored for the whole row without branches, so
+// that the loop can be vectorized, and then the few candidates are collected.
+template <bool EIGHT, bool PLATEAUS, typename T>
+static void find_row_maxima(const Grid::BasicGrid<T> &grid, size_t j,
+                            std::vector<uint8_t> &is_max,
+                            std::vector<uint64_t> &indexes) {
+    // The definition of a local maxima in a 2D space might have different
+    // interpretations. i.e. We can select the 8 neighbours and the local
+    // maxima will be marked if all points are below the central value.
+    // Alternatively, only a number N of neighbours can be used, for example
+    // only the 4 cardinal directions from the value under study.
+    //
+    // ----------------------------------------------
+    // | top_left     | top          | top_right    |
+    // ----------------------------------------------
+    // | left         | value        | right        |
+    // ----------------------------------------------
+    // | bottom_left  | bottom       | bottom_right |
+    // ----------------------------------------------
+    auto above = [](T value, T neighbour) {
+        if constexpr (PLATEAUS) {
+            return value >= neighbour;
+        } else {
+            return value > neighbour;
+        }
+    };
+    size_t n = grid.n;
+    const T *top = &grid.data[(j - 1) * n];
+    const T *row = &grid.data[j * n];
+    const T *bottom = &grid.data[(j + 1) * n];
+    for (size_t i = 1; i < n - 1; ++i) {
+        T value = row[i];
+        bool local_max = (value != 0) & above(value, row[i - 1]) &
+                         above(value, row[i + 1]) & above(value, top[i]) &
+                         above(value, bottom[i]);
+        if constexpr (EIGHT) {
+            local_max = local_max & above(value, top[i - 1]) &
+                        above(value, top[i + 1]) &
+                        above(value, bottom[i - 1]) &
+                        above(value, bottom[i + 1]);
+        }
+        is_max[i] = local_max;
+    }
+    for (size_t i = 1; i < n - 1; ++i) {
+        if (is_max[i]) {
+            indexes.push_back(i + j * n);
+        }
+    }
+}
+
+// Group the candidates of the plateau mode into connected points with the
+// same value. If any point of a group has an equal neighbour that is not a
+// candidate, that neighbour is lower than one of its own neighbours, and
+// therefore the group is not a local maxima.
+template <typename T>
+static std::vector<Centroid::LocalMax> group_plateaus(
+    const Grid::BasicGrid<T> &grid, const std::vector<uint64_t> &candidates,
+    Centroid::Neighbours::Type neighbours) {
+    std::vector<std::pair<int64_t, int64_t>> offsets = {
+        {-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    if (neighbours == Centroid::Neighbours::EIGHT) {
+        offsets.insert(offsets.end(), {{-1, -1}, {1, -1}, {-1, 1}, {1, 1}});
+    }
     std::vector<Centroid::LocalMax> points;
-    // FIXME: This is performed in O(n^2), but using the divide and conquer
-    // strategy we might achieve O(n * log(n)) or lower.
-    // FIXME: Also, we should consider the corner case where neighbours are
-    // exactly equal, both should be considered a local maxima and the average
-    // of mz and rt should be reported.
-    for (size_t j = 1; j < grid.m - 1; ++j) {
-        for (size_t i = 1; i < grid.n - 1; ++i) {
-            int64_t index = i + j * grid.n;
-
-            // The definition of a local maxima in a 2D space might
-            // have different interpretations. i.e. We can select the 8
-            // neighbours and the local maxima will be marked if all points are
-            // below the central value. Alternatively, only a number N of
-            // neighbours can be used, for example only the 4 cardinal
-            // directions from the value under study.
-            //
-            // ----------------------------------------------
-            // |              | top_value    |              |
-            // ----------------------------------------------
-            // | left_value   | value        | right_value  |
-            // ----------------------------------------------
-            // |              | bottom_value |              |
-            // ----------------------------------------------
-            double value = grid.data[index];
-            double right_value = grid.data[index + 1];
-            double left_value = grid.data[index - 1];
-            double top_value = grid.data[index - grid.n];
-            double bottom_value = grid.data[index + grid.n];
-
-            if ((value != 0) && (value > left_value) && (value > right_value) &&
-                (value > top_value) && (value > bottom_value)) {
-                points.push_back({grid.bins_mz[i], grid.bins_rt[j], value});
+    std::vector<bool> visited(candidates.size());
+    std::vector<size_t> group;
+    for (size_t k = 0; k < candidates.size(); ++k) {
+        if (visited[k]) {
+            continue;
+        }
+        T value = grid.data[candidates[k]];
+        bool is_plateau = true;
+        group = {k};
+        visited[k] = true;
+        for (size_t g = 0; g < group.size(); ++g) {
+            int64_t i = candidates[group[g]] % grid.n;
+            int64_t j = candidates[group[g]] / grid.n;
+            for (const auto &[di, dj] : offsets) {
+                int64_t x = i + di;
+                int64_t y = j + dj;
+                if (x < 0 || y < 0 || x >= static_cast<int64_t>(grid.n) ||
+                    y >= static_cast<int64_t>(grid.m)) {
+                    continue;
+                }
+                uint64_t index = x + y * grid.n;
+                if (grid.data[index] != value) {
+                    continue;
+                }
+                auto it = std::lower_bound(candidates.begin(), candidates.end(),
+                                           index);
+                if (it == candidates.end() || *it != index) {
+                    is_plateau = false;
+                    continue;
+                }
+                size_t neighbour = it - candidates.begin();
+                if (!visited[neighbour]) {
+                    visited[neighbour] = true;
+                    group.push_back(neighbour);
+                }
             }
         }
+        if (!is_plateau) {
+            continue;
+        }
+        double sum_mz = 0;
+        double sum_rt = 0;
+        for (const auto &g : group) {
+            sum_mz += grid.bins_mz[candidates[g] % grid.n];
+            sum_rt += grid.bins_rt[candidates[g] / grid.n];
+        }
+        points.push_back(
+            {sum_mz / group.size(), sum_rt / group.size(), value});
     }
+    return points;
+}
 
+template <typename T>
+std::vector<Centroid::LocalMax> Centroid::find_local_maxima(
+    const Grid::BasicGrid<T> &grid, size_t max_threads,
+    Neighbours::Type neighbours, bool plateaus) {
+    if (grid.n < 3 || grid.m < 3) {
+        return {};
+    }
+    auto find_row_range = [&](size_t begin, size_t end,
+                              std::vector<uint64_t> &indexes) {
+        std::vector<uint8_t> is_max(grid.n);
+        for (size_t j = begin + 1; j < end + 1; ++j) {
+            if (neighbours == Neighbours::EIGHT) {
+                if (plateaus) {
+                    find_row_maxima<true, true>(grid, j, is_max, indexes);
+                } else {
+                    find_row_maxima<true, false>(grid, j, is_max, indexes);
+                }
+            } else {
+                if (plateaus) {
+                    find_row_maxima<false, true>(grid, j, is_max, indexes);
+                } else {
+                    find_row_maxima<false, false>(grid, j, is_max, indexes);
+                }
+            }
+        }
+    };
+    // The candidates are found in row major order.
+    auto candidates = parallel_collect<uint64_t>(grid.m - 2, max_threads,
+                                                 find_row_range);
+    if (plateaus) {
+        return group_plateaus(grid, candidates, neighbours);
+    }
+    std::vector<Centroid::LocalMax> points(candidates.size());
+    for (size_t k = 0; k < candidates.size(); ++k) {
+        size_t i = candidates[k] % grid.n;
+        size_t j = candidates[k] / grid.n;
+        points[k] = {grid.bins_mz[i], grid.bins_rt[j],
+                     grid.data[candidates[k]]};
+    }
     return points;
 }
 
+template std::vector<Centroid::LocalMax> Centroid::find_local_maxima(
+    const Grid::Grid &grid, size_t max_threads, Neighbours::Type neighbours,
+    bool plateaus);
+template std::vector<Centroid::LocalMax> Centroid::find_local_maxima(
+    const Grid::FloatGrid &grid, size_t max_threads,
+    Neighbours::Type neighbours, bool plateaus);
+
+template <typename T>
+std::vector<Centroid::LocalMax> Centroid::find_local_maxima(
+    const Grid::BasicTiledGrid<T> &grid, size_t max_threads) {
+    if (grid.n < 3 || grid.m < 3) {
+        return {};
+    }
+    // The empty tiles can't contain local maxima, since all their values are
+    // zero. The same 4 cardinal neighbours as in the dense grid are used. Each
+    // thread visits a range of rows of tiles.
+    const uint64_t tile_area = Grid::TILE_SIZE * Grid::TILE_SIZE;
+    auto find_tile_rows = [&](size_t y_begin, size_t y_end,
+                              std::vector<Centroid::LocalMax> &points) {
+        for (size_t y = y_begin; y < y_end; ++y) {
+            for (size_t x = 0; x < grid.num_tiles_mz; ++x) {
+                uint64_t tile = grid.tile_index[x + y * grid.num_tiles_mz];
+                if (tile == Grid::NO_TILE) {
+                    continue;
+                }
+                size_t j_min = std::max<size_t>(y * Grid::TILE_SIZE, 1);
+                size_t j_max = std::min<size_t>((y + 1) * Grid::TILE_SIZE,
+                                                grid.m - 1);
+                size_t i_min = std::max<size_t>(x * Grid::TILE_SIZE, 1);
+                size_t i_max = std::min<size_t>((x + 1) * Grid::TILE_SIZE,
+                                                grid.n - 1);
+                for (size_t j = j_min; j < j_max; ++j) {
+                    for (size_t i = i_min; i < i_max; ++i) {
+                        double value =
+                            grid.data[tile * tile_area +
+                                      j % Grid::TILE_SIZE * Grid::TILE_SIZE +
+                                      i % Grid::TILE_SIZE];
+                        if ((value != 0) &&
+                            (value > Grid::value_at(grid, i - 1, j)) &&
+                            (value > Grid::value_at(grid, i + 1, j)) &&
+                            (value > Grid::value_at(grid, i, j - 1)) &&
+                            (value > Grid::value_at(grid, i, j + 1))) {
+                            points.push_back(
+                                {grid.bins_mz[i], grid.bins_rt[j], value});
+                        }
+                    }
+                }
+            }
+        }
+    };
+    return parallel_collect<Centroid::LocalMax>(grid.num_tiles_rt,
+                                                max_threads, find_tile_rows);
+}
+
+template std::vector<Centroid::LocalMax> Centroid::find_local_maxima(
+    const Grid::TiledGrid &grid, size_t max_threads);
+template std::vector<Centroid::LocalMax> Centroid::find_local_maxima(
+    const Grid::FloatTiledGrid &grid, size_t max_threads);
+
+// Smallest reciprocal condition number of the scaled fitting matrix that is
+// solved with the LDLT decomposition.
+static constexpr double MIN_RCOND = 1e-12;
+
+// Solve the symmetric system `A * x = b` of the peak fitting. The powers of
+// the m/z and rt offsets have very different magnitudes, so the system is
+// first scaled to have a unit diagonal. The LDLT decomposition of the scaled
+// matrix is much cheaper than a SVD, which is only used as a fallback when
+// the matrix is close to singular.
+static Eigen::Matrix<double, 5, 1> solve_fitting_system(
+    const Eigen::Matrix<double, 5, 5> &A,
+    const Eigen::Matrix<double, 5, 1> &b) {
+    if ((A.diagonal().array() > 0).all()) {
+        Eigen::Matrix<double, 5, 1> scale =
+            A.diagonal().cwiseSqrt().cwiseInverse();
+        Eigen::Matrix<double, 5, 5> scaled =
+            scale.asDiagonal() * A * scale.asDiagonal();
+        Eigen::LDLT<Eigen::Matrix<double, 5, 5>> ldlt(scaled);
+        if (ldlt.info() == Eigen::Success && ldlt.isPositive() &&
+            ldlt.rcond() > MIN_RCOND) {
+            return scale.asDiagonal() *
+                   ldlt.solve((scale.asDiagonal() * b).eval());
+        }
+    }
+    return A.jacobiSvd(Eigen::ComputeFullU | Eigen::ComputeFullV).solve(b);
+}
+
+// Parameters of the Levenberg-Marquardt refinement.
+static constexpr size_t LM_MAX_ITERATIONS = 20;
+static constexpr double LM_INITIAL_LAMBDA = 1e-3;
+static constexpr double LM_MAX_LAMBDA = 1e10;
+// The iterations stop when a step reduces the cost by less than this fraction.
+static constexpr double LM_TOLERANCE = 1e-4;
+
+// Number of distinct products of two basis functions of the Gaussian model.
+// The first five are the basis functions themselves: 1, mz, mz^2, rt, rt^2.
+// They are followed by mz^3, mz^4, rt^3, rt^4, mz*rt, mz*rt^2, mz^2*rt and
+// mz^2*rt^2.
+static constexpr size_t NUM_MONOMIALS = 13;
+
+// Index of the monomial for the product of the basis functions i and j.
+static constexpr size_t MONOMIAL_INDEX[5][5] = {
+    {0, 1, 2, 3, 4},    //
+    {1, 2, 5, 9, 10},   //
+    {2, 5, 6, 11, 12},  //
+    {3, 9, 11, 4, 7},   //
+    {4, 10, 12, 7, 8},  //
+};
+
+// Refine the linearized fit by minimizing the squared residuals of the
+// intensities with the Levenberg-Marquardt algorithm. The model is
+// `exp(beta * [1, mz, mz^2, rt, rt^2])` with mz/rt relative to the local
+// maximum, the same parametrization as the linearized fit, so its solution
+// can be used as the starting point. The columns of the Jacobian are the
+// basis functions scaled by the model, so `J^T * J` only depends on the
+// monomials weighted by the squared model, which are calculated with a
+// single matrix-vector product. All the per point operations work on whole
+// columns and are vectorized by Eigen. beta is only updated by steps that
+// reduce the cost.
+static void refine_gaussian_fit(const RawData::RawPoints &raw_points,
+                                const Centroid::LocalMax &local_max,
+                                Eigen::Matrix<double, 5, 1> &beta,
+                                Centroid::PeakContext &context) {
+    using Monomials = Eigen::Matrix<double, Eigen::Dynamic, NUM_MONOMIALS>;
+    size_t n = raw_points.num_points;
+    context.monomials.resize(n * NUM_MONOMIALS);
+    context.model.resize(n);
+    context.trial_model.resize(n);
+    context.weights.resize(n);
+    Eigen::Map<Monomials> monomials(context.monomials.data(), n,
+                                    NUM_MONOMIALS);
+    Eigen::Map<Eigen::VectorXd> model(context.model.data(), n);
+    Eigen::Map<Eigen::VectorXd> trial_model(context.trial_model.data(), n);
+    Eigen::Map<Eigen::VectorXd> weights(context.weights.data(), n);
+    Eigen::Map<const Eigen::VectorXd> intensity(raw_points.intensity.data(),
+                                                n);
+    for (size_t i = 0; i < n; ++i) {
+        double mz = raw_points.mz[i] - local_max.mz;
+        double rt = raw_points.rt[i] - local_max.rt;
+        monomials(i, 0) = 1;
+        monomials(i, 1) = mz;
+        monomials(i, 2) = mz * mz;
+        monomials(i, 3) = rt;
+        monomials(i, 4) = rt * rt;
+        monomials(i, 5) = mz * mz * mz;
+        monomials(i, 6) = mz * mz * mz * mz;
+        monomials(i, 7) = rt * rt * rt;
+        monomials(i, 8) = rt * rt * rt * rt;
+        monomials(i, 9) = mz * rt;
+        monomials(i, 10) = mz * rt * rt;
+        monomials(i, 11) = mz * mz * rt;
+        monomials(i, 12) = mz * mz * rt * rt;
+    }
+    auto basis = monomials.leftCols<5>();
+
+    model = (basis * beta).array().exp().matrix();
+    double cost = (intensity - model).squaredNorm();
+    if (!std::isfinite(cost)) {
+        return;
+    }
+    double lambda = LM_INITIAL_LAMBDA;
+    for (size_t iteration = 0; iteration < LM_MAX_ITERATIONS; ++iteration) {
+        weights = model.array().square().matrix();
+        Eigen::Matrix<double, NUM_MONOMIALS, 1> moments =
+            monomials.transpose() * weights;
+        Eigen::Matrix<double, 5, 5> JTJ;
+        for (size_t i = 0; i < 5; ++i) {
+            for (size_t j = 0; j < 5; ++j) {
+                JTJ(i, j) = moments(MONOMIAL_INDEX[i][j]);
+            }
+        }
+        weights = (model.array() * (intensity - model).array()).matrix();
+        Eigen::Matrix<double, 5, 1> JTr = basis.transpose() * weights;
+
+        // Increase the damping until the step reduces the cost.
+        bool improved = false;
+        double trial_cost = cost;
+        while (lambda < LM_MAX_LAMBDA) {
+            Eigen::Matrix<double, 5, 5> A = JTJ;
+            A.diagonal() *= 1 + lambda;
+            Eigen::Matrix<double, 5, 1> trial_beta =
+                beta + solve_fitting_system(A, JTr);
+            if (trial_beta.allFinite() && trial_beta(2) < 0 &&
+                trial_beta(4) < 0) {
+                trial_model = (basis * trial_beta).array().exp().matrix();
+                trial_cost = (intensity - trial_model).squaredNorm();
+                if (trial_cost < cost) {
+                    beta = trial_beta;
+                    improved = true;
+                    break;
+                }
+            }
+            lambda *= 10;
+        }
+        if (!improved) {
+            return;
+        }
+        model = trial_model;
+        bool converged = cost - trial_cost <= LM_TOLERANCE * cost;
+        cost = trial_cost;
+        lambda /= 10;
+        if (converged) {
+            return;
+        }
+    }
+}
+
 std::optional<Centroid::Peak> Centroid::build_peak(
     const RawData::RawData &raw_data, const LocalMax &local_max) {
+    PeakContext context;
+    return build_peak(raw_data, local_max, context);
+}
+
+std::optional<Centroid::Peak> Centroid::build_peak(
+    const RawData::RawData &raw_data, const LocalMax &local_max,
+    PeakContext &context, bool refine_fit) {
     Centroid::Peak peak = {};
     peak.id = 0;
     peak.local_max_mz = local_max.mz;
@@ -68,9 +426,9 @@ std::optional<Centroid::Peak> Centroid::build_peak(
     peak.roi_max_rt = peak.local_max_rt + 2 * theoretical_sigma_rt;
 
     // Extract the raw data points for the ROI.
-    auto raw_points =
-        RawData::raw_points(raw_data, peak.roi_min_mz, peak.roi_max_mz,
-                            peak.roi_min_rt, peak.roi_max_rt);
+    auto &raw_points = context.raw_points;
+    RawData::raw_points(raw_data, peak.roi_min_mz, peak.roi_max_mz,
+                        peak.roi_min_rt, peak.roi_max_rt, raw_points);
     if (raw_points.num_points == 0 || raw_points.num_scans < 3) {
         return std::nullopt;
     }
@@ -147,10 +505,8 @@ std::optional<Centroid::Peak> Centroid::build_peak(
     {
         // Solve the linearized 2D gaussian fitting problem `A * beta = c` with
         // weighted residuals.
-        Eigen::MatrixXd A(5, 5);
-        Eigen::VectorXd c(5);
-        A = Eigen::MatrixXd::Zero(5, 5);
-        c = Eigen::VectorXd::Zero(5);
+        Eigen::Matrix<double, 5, 5> A = Eigen::Matrix<double, 5, 5>::Zero();
+        Eigen::Matrix<double, 5, 1> c = Eigen::Matrix<double, 5, 1>::Zero();
         for (size_t i = 0; i < raw_points.num_points; ++i) {
             double mz = raw_points.mz[i] - local_max.mz;
             double rt = raw_points.rt[i] - local_max.rt;
@@ -200,8 +556,10 @@ std::optional<Centroid::Peak> Centroid::build_peak(
             c(3) += w_2 * std::log(intensity) * rt;
             c(4) += w_2 * std::log(intensity) * rt * rt;
         }
-        Eigen::VectorXd beta(5);
-        beta = A.bdcSvd(Eigen::ComputeThinU | Eigen::ComputeThinV).solve(c);
+        Eigen::Matrix<double, 5, 1> beta = solve_fitting_system(A, c);
+        if (refine_fit && beta.allFinite() && beta(2) < 0 && beta(4) < 0) {
+            refine_gaussian_fit(raw_points, local_max, beta, context);
+        }
         {
             double a = beta(0);
             double b = beta(1);
@@ -254,27 +612,73 @@ std::optional<Centroid::Peak> Centroid::build_peak(
     return peak;
 }
 
-std::vector<Centroid::Peak> Centroid::find_peaks_serial(
-    const RawData::RawData &raw_data, const Grid::Grid &grid,
-    size_t max_peaks) {
-    // Finding local maxima.
-    auto local_max = Centroid::find_local_maxima(grid);
-
+// Build the peaks for the max_peaks local maxima with highest value, or for
+// all of them if max_peaks is zero. The local maxima are visited in descending
+// order in batches, with the peaks of each batch built by up to max_threads
+// threads. The valid peaks are then collected in order, so the result doesn't
+// depend on the number of threads.
+static std::vector<Centroid::Peak> build_peaks(
+    const RawData::RawData &raw_data,
+    std::vector<Centroid::LocalMax> &local_max, size_t max_peaks,
+    size_t max_threads = 1, bool refine_fit = false) {
     // Sort the local_maxima by value.
     auto sort_local_max = [](const Centroid::LocalMax &p1,
                              const Centroid::LocalMax &p2) -> bool {
         return (p2.value < p1.value);
     };
     std::sort(local_max.begin(), local_max.end(), sort_local_max);
+    if (max_peaks == 0) {
+        max_peaks = local_max.size();
+    }
+
+    size_t num_threads = ThreadPool::shared_pool().size() + 1;
+    if (num_threads > max_threads) {
+        num_threads = max_threads;
+    }
 
     std::vector<Centroid::Peak> peaks;
-    for (const auto &max : local_max) {
-        if (peaks.size() == max_peaks) {
-            break;
+    if (num_threads <= 1) {
+        Centroid::PeakContext context;
+        for (const auto &max : local_max) {
+            if (peaks.size() == max_peaks) {
+                break;
+            }
+            auto peak = build_peak(raw_data, max, context, refine_fit);
+            if (peak) {
+                peaks.push_back(peak.value());
+            }
         }
-        auto peak = build_peak(raw_data, max);
-        if (peak) {
-            peaks.push_back(peak.value());
+    } else {
+        std::vector<std::optional<Centroid::Peak>> batch;
+        size_t next = 0;
+        while (peaks.size() < max_peaks && next < local_max.size()) {
+            // At least one local maximum per missing peak is needed, so
+            // the batch is never bigger than that.
+            size_t batch_size = max_peaks - peaks.size();
+            if (batch_size < num_threads) {
+                batch_size = num_threads;
+            }
+            if (batch_size > local_max.size() - next) {
+                batch_size = local_max.size() - next;
+            }
+            batch.assign(batch_size, std::nullopt);
+            ThreadPool::parallel_for(
+                batch_size, num_threads, [&](size_t begin, size_t end) {
+                    Centroid::PeakContext context;
+                    for (size_t k = begin; k < end; ++k) {
+                        batch[k] = build_peak(raw_data, local_max[next + k],
+                                              context, refine_fit);
+                    }
+                });
+            for (const auto &peak : batch) {
+                if (peaks.size() == max_peaks) {
+                    break;
+                }
+                if (peak) {
+                    peaks.push_back(peak.value());
+                }
+            }
+            next += batch_size;
         }
     }
 
@@ -286,50 +690,50 @@ std::vector<Centroid::Peak> Centroid::find_peaks_serial(
     return peaks;
 }
 
-std::vector<Centroid::Peak> Centroid::find_peaks_parallel(
-    const RawData::RawData &raw_data, const Grid::Grid &grid, size_t max_peaks,
-    size_t max_threads) {
+template <typename GridType>
+std::vector<Centroid::Peak> Centroid::find_peaks_serial(
+    const RawData::RawData &raw_data, const GridType &grid, size_t max_peaks,
+    bool refine_fit) {
     // Finding local maxima.
     auto local_max = Centroid::find_local_maxima(grid);
+    return build_peaks(raw_data, local_max, max_peaks, 1, refine_fit);
+}
 
-    // The number of groups/threads is set to the maximum possible concurrency.
-    uint64_t num_threads = std::thread::hardware_concurrency();
-    if (num_threads > max_threads) {
-        num_threads = max_threads;
-    }
-
-    // Split the points into different groups for concurrency.
-    std::vector<std::vector<size_t>> groups =
-        std::vector<std::vector<size_t>>(num_threads);
-    for (size_t i = 0; i < local_max.size(); ++i) {
-        size_t k = i % num_threads;
-        groups[k].push_back(i);
-    }
-
-    std::vector<std::thread> threads(num_threads);
-    std::vector<std::vector<Centroid::Peak>> peaks_array(num_threads);
-    for (size_t i = 0; i < groups.size(); ++i) {
-        threads[i] = std::thread(
-            [&groups, &local_max, &peaks_array, &raw_data, &grid, i]() {
-                for (const auto &k : groups[i]) {
-                    auto peak = build_peak(raw_data, local_max[k]);
-                    if (peak) {
-                        peaks_array[i].push_back(peak.value());
-                    }
+template std::vector<Centroid::Peak> Centroid::find_peaks_serial(
+    const RawData::RawData &raw_data, const Grid::Grid &grid,
+    size_t max_peaks, bool refine_fit);
+template std::vector<Centroid::Peak> Centroid::find_peaks_serial(
+    const RawData::RawData &raw_data, const Grid::FloatGrid &grid,
+    size_t max_peaks, bool refine_fit);
+template std::vector<Centroid::Peak> Centroid::find_peaks_serial(
+    const RawData::RawData &raw_data, const Grid::TiledGrid &grid,
+    size_t max_peaks, bool refine_fit);
+template std::vector<Centroid::Peak> Centroid::find_peaks_serial(
+    const RawData::RawData &raw_data, const Grid::FloatTiledGrid &grid,
+    size_t max_peaks, bool refine_fit);
+
+template <typename GridType>
+std::vector<Centroid::Peak> Centroid::find_peaks_parallel(
+    const RawData::RawData &raw_data, const GridType &grid, size_t max_peaks,
+    size_t max_threads, bool refine_fit) {
+    // Finding local maxima.
+    auto local_max = Centroid::find_local_maxima(grid, max_threads);
+
+    // The local maxima are split in chunks shared between the threads of the
+    // pool, since the cost of building a peak depends on the number of raw
+    // points around it.
+    auto peaks = parallel_collect<Centroid::Peak>(
+        local_max.size(), max_threads,
+        [&](size_t begin, size_t end, std::vector<Centroid::Peak> &output) {
+            Centroid::PeakContext context;
+            for (size_t k = begin; k < end; ++k) {
+                auto peak =
+                    build_peak(raw_data, local_max[k], context, refine_fit);
+                if (peak) {
+                    output.push_back(peak.value());
                 }
-            });
-    }
-
-    // Wait for the threads to finish.
-    for (auto &thread : threads) {
-        thread.join();
-    }
-
-    // Join peak groups.
-    std::vector<Centroid::Peak> peaks;
-    for (size_t i = 0; i < peaks_array.size(); ++i) {
-        peaks.insert(end(peaks), begin(peaks_array[i]), end(peaks_array[i]));
-    }
+            }
+        });
 
     // Sort the peaks by height.
     auto sort_peaks = [](const Centroid::Peak &p1,
@@ -344,13 +748,100 @@ std::vector<Centroid::Peak> Centroid::find_peaks_parallel(
     }
 
     // Return maximum amount of peaks.
-    if (peaks.size() > max_peaks) {
+    if (max_peaks != 0 && peaks.size() > max_peaks) {
         peaks.resize(max_peaks);
     }
 
     return peaks;
 }
 
+template std::vector<Centroid::Peak> Centroid::find_peaks_parallel(
+    const RawData::RawData &raw_data, const Grid::Grid &grid, size_t max_peaks,
+    size_t max_threads, bool refine_fit);
+template std::vector<Centroid::Peak> Centroid::find_peaks_parallel(
+    const RawData::RawData &raw_data, const Grid::FloatGrid &grid,
+    size_t max_peaks, size_t max_threads, bool refine_fit);
+template std::vector<Centroid::Peak> Centroid::find_peaks_parallel(
+    const RawData::RawData &raw_data, const Grid::TiledGrid &grid,
+    size_t max_peaks, size_t max_threads, bool refine_fit);
+template std::vector<Centroid::Peak> Centroid::find_peaks_parallel(
+    const RawData::RawData &raw_data, const Grid::FloatTiledGrid &grid,
+    size_t max_peaks, size_t max_threads, bool refine_fit);
+
+template <typename GridType>
+std::vector<Centroid::Peak> Centroid::find_peaks_top_k(
+    const RawData::RawData &raw_data, const GridType &grid, size_t max_peaks,
+    size_t max_threads, bool refine_fit) {
+    auto local_max = Centroid::find_local_maxima(grid, max_threads);
+    return build_peaks(raw_data, local_max, max_peaks, max_threads,
+                       refine_fit);
+}
+
+template std::vector<Centroid::Peak> Centroid::find_peaks_top_k(
+    const RawData::RawData &raw_data, const Grid::Grid &grid, size_t max_peaks,
+    size_t max_threads, bool refine_fit);
+template std::vector<Centroid::Peak> Centroid::find_peaks_top_k(
+    const RawData::RawData &raw_data, const Grid::FloatGrid &grid,
+    size_t max_peaks, size_t max_threads, bool refine_fit);
+template std::vector<Centroid::Peak> Centroid::find_peaks_top_k(
+    const RawData::RawData &raw_data, const Grid::TiledGrid &grid,
+    size_t max_peaks, size_t max_threads, bool refine_fit);
+template std::vector<Centroid::Peak> Centroid::find_peaks_top_k(
+    const RawData::RawData &raw_data, const Grid::FloatTiledGrid &grid,
+    size_t max_peaks, size_t max_threads, bool refine_fit);
+
+std::vector<Centroid::Peak> Centroid::find_peaks_streaming(
+    const RawData::RawData &raw_data, const Grid::ResampleParams &params,
+    size_t max_peaks, bool refine_fit) {
+    // Only the last three rows of the grid are kept to find the local maxima,
+    // using the same 4 cardinal neighbours as find_local_maxima.
+    std::vector<Centroid::LocalMax> local_max;
+    std::vector<double> rows[3];
+    const Grid::Layout *layout = nullptr;
+    auto find_row_maxima = [&](uint64_t j) {
+        const auto &grid = *layout;
+        const auto &top = rows[(j - 1) % 3];
+        const auto &center = rows[j % 3];
+        const auto &bottom = rows[(j + 1) % 3];
+        for (size_t i = 1; i < grid.n - 1; ++i) {
+            double value = center[i];
+            if ((value != 0) && (value > center[i - 1]) &&
+                (value > center[i + 1]) && (value > top[i]) &&
+                (value > bottom[i])) {
+                local_max.push_back({grid.bins_mz[i], grid.bins_rt[j], value});
+            }
+        }
+    };
+    Grid::StreamingResampler resampler(
+        raw_data, params, [&](uint64_t j, const std::vector<double> &row) {
+            rows[j % 3] = row;
+            if (j >= 2) {
+                find_row_maxima(j - 1);
+            }
+        });
+    layout = &resampler.layout();
+    if (layout->n < 3 || layout->m < 3) {
+        return {};
+    }
+
+    // The scans have to be fed in retention time order.
+    std::vector<const RawData::Scan *> scans;
+    scans.reserve(raw_data.scans.size());
+    for (const auto &scan : raw_data.scans) {
+        scans.push_back(&scan);
+    }
+    std::stable_sort(scans.begin(), scans.end(),
+                     [](const RawData::Scan *a, const RawData::Scan *b) {
+                         return a->retention_time < b->retention_time;
+                     });
+    for (const auto scan : scans) {
+        resampler.add_scan(*scan);
+    }
+    resampler.finish();
+
+    return build_peaks(raw_data, local_max, max_peaks, 1, refine_fit);
+}
+
 double Centroid::peak_overlap(const Centroid::Peak &peak_a,
                               const Centroid::Peak &peak_b) {
     double peak_a_mz = peak_a.fitted_mz;
@@ -63,24 +63,101 @@ struct Peak {
     double fitted_volume;
 };
 
+// The neighbours of a point of the grid that are compared to find the local
+// maxima: Only the 4 cardinal directions, or also the 4 diagonals.
+namespace Neighbours {
+enum Type : uint8_t { FOUR = 0, EIGHT = 1 };
+}  // namespace Neighbours
+
 // Find all candidate points on the given grid by calculating the local maxima
 // at each point of the grid. The local maxima is defined as follows: For the
 // given indexes i and j the point at data[i][j] is greater than the neighbors
-// in all 4 cardinal directions.
-std::vector<LocalMax> find_local_maxima(const Grid::Grid &grid);
+// in all 4 cardinal directions, or in all 8 directions with Neighbours::EIGHT.
+//
+// If plateaus is true, a group of connected points with the same value is
+// also considered a local maxima when all of them are greater or equal than
+// their neighbours. It is reported once, at the average mz and rt of the
+// points in the group.
+//
+// The rows of the grid are split across up to max_threads threads. The
+// results are the same regardless of the number of threads.
+template <typename T>
+std::vector<LocalMax> find_local_maxima(
+    const Grid::BasicGrid<T> &grid, size_t max_threads = 1,
+    Neighbours::Type neighbours = Neighbours::FOUR, bool plateaus = false);
+
+// Same as above with the default 4 neighbours, but only the allocated tiles of
+// the grid are visited.
+template <typename T>
+std::vector<LocalMax> find_local_maxima(const Grid::BasicTiledGrid<T> &grid,
+                                        size_t max_threads = 1);
+
+// Temporary memory used by build_peak. Reusing the same context for all the
+// peaks built on a thread avoids allocating memory for every peak.
+struct PeakContext {
+    RawData::RawPoints raw_points;
+    // Columns with the monomials of the model, and the model values and
+    // weights of the ROI points, used for the non-linear refinement.
+    std::vector<double> monomials;
+    std::vector<double> model;
+    std::vector<double> trial_model;
+    std::vector<double> weights;
+};
 
 // Builds a Peak object for the given local_max.
 std::optional<Peak> build_peak(const RawData::RawData &raw_data,
                                const LocalMax &local_max);
 
-// Find the peaks in serial.
+// Same as above, using the given context for the temporary data. The peak
+// parameters are first estimated with a weighted least squares fit of the
+// logarithm of the intensities, which is fast but biased for noisy or
+// overlapping peaks. If refine_fit is true, this solution is refined with a
+// non-linear least squares fit of the intensities.
+std::optional<Peak> build_peak(const RawData::RawData &raw_data,
+                               const LocalMax &local_max,
+                               PeakContext &context, bool refine_fit = false);
+
+// Find the peaks in serial. The grid can be any of the dense or tiled grid
+// types. In this and the following functions, at most max_peaks peaks are
+// returned, or all of them if max_peaks is zero, and refine_fit enables the
+// non-linear refinement of the peak fitting described in build_peak.
+template <typename GridType>
 std::vector<Peak> find_peaks_serial(const RawData::RawData &raw_data,
-                                    const Grid::Grid &grid, size_t max_peaks);
+                                    const GridType &grid, size_t max_peaks,
+                                    bool refine_fit = false);
 
 // Find the peaks in parallel.
+template <typename GridType>
 std::vector<Peak> find_peaks_parallel(const RawData::RawData &raw_data,
-                                      const Grid::Grid &grid, size_t max_peaks,
-                                      size_t max_threads);
+                                      const GridType &grid, size_t max_peaks,
+                                      size_t max_threads,
+                                      bool refine_fit = false);
+
+// Find the peaks in parallel, stopping as soon as max_peaks valid peaks have
+// been built. The local maxima are processed in batches in descending order of
+// their smoothed height, and the result is the same as find_peaks_serial for
+// any number of threads.
+template <typename GridType>
+std::vector<Peak> find_peaks_top_k(const RawData::RawData &raw_data,
+                                   const GridType &grid, size_t max_peaks,
+                                   size_t max_threads,
+                                   bool refine_fit = false);
+
+// Find the peaks in serial without storing the full grid. The grid rows are
+// generated with Grid::StreamingResampler and the local maxima are detected on
+// a sliding window of three rows. The results are the same as calling
+// find_peaks_serial with the grid returned by Grid::resample.
+//
+// Only the memory used by the grid is bounded. The local maxima of the whole
+// run are collected before the peaks are built, since they are processed in
+// descending order of height, and the peaks are fitted on the points of
+// raw_data, which therefore has to be fully loaded in memory. For files that
+// don't fit in memory, read and process the retention time range in several
+// windows instead.
+std::vector<Peak> find_peaks_streaming(const RawData::RawData &raw_data,
+                                       const Grid::ResampleParams &params,
+                                       size_t max_peaks,
+                                       bool refine_fit = false);
 
 // Calculate the overlaping area between two peaks.
 double peak_overlap(const Peak &peak_a, const Peak &peak_b);
@@ -1,11 +1,13 @@
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 
 #include "grid/grid.hpp"
 #include "utils/serialization.hpp"
 #include "utils/search.hpp"
+#include "utils/thread_pool.hpp"
 
-uint64_t Grid::x_index(const Grid &grid, double mz) {
+uint64_t Grid::x_index(const Layout &grid, double mz) {
     switch (grid.instrument_type) {
         case Instrument::ORBITRAP: {
             double a = grid.fwhm_mz / std::pow(grid.reference_mz, 1.5);
@@ -35,12 +37,42 @@ uint64_t Grid::x_index(const Grid &grid, double mz) {
     }
 }
 
-uint64_t Grid::y_index(const Grid &grid, double rt) {
+Grid::MzIndex::MzIndex(const Layout &layout)
+    : instrument_type(layout.instrument_type),
+      min_mz(layout.min_mz),
+      scale(0),
+      offset(0),
+      numerator(0),
+      denominator(1) {
+    switch (instrument_type) {
+        case Instrument::ORBITRAP: {
+            double a = layout.fwhm_mz / std::pow(layout.reference_mz, 1.5);
+            scale = layout.k * 2 / a;
+            offset = 1 / std::sqrt(layout.min_mz);
+        } break;
+        case Instrument::FTICR: {
+            scale = layout.k;
+            numerator = layout.reference_mz * layout.reference_mz;
+            denominator = layout.fwhm_mz * layout.min_mz;
+        } break;
+        case Instrument::TOF: {
+            scale = layout.k * layout.reference_mz / layout.fwhm_mz;
+        } break;
+        case Instrument::QUAD: {
+            scale = layout.k;
+            denominator = layout.fwhm_mz;
+        } break;
+        default:
+            break;
+    }
+}
+
+uint64_t Grid::y_index(const Layout &grid, double rt) {
     double delta_rt = grid.fwhm_rt / grid.k;
     return std::ceil((rt - grid.min_rt) / delta_rt);
 }
 
-double Grid::mz_at(const Grid &grid, uint64_t i) {
+double Grid::mz_at(const Layout &grid, uint64_t i) {
     switch (grid.instrument_type) {
         case Instrument::ORBITRAP: {
             double a = 1 / std::sqrt(grid.min_mz);
@@ -70,15 +102,14 @@ double Grid::mz_at(const Grid &grid, uint64_t i) {
     }
 }
 
-double Grid::rt_at(const Grid &grid, uint64_t j) {
+double Grid::rt_at(const Layout &grid, uint64_t j) {
     double delta_rt = (grid.max_rt - grid.min_rt) / (grid.m - 1);
     return grid.min_rt + delta_rt * j;
 }
 
-Grid::Grid Grid::resample(const RawData::RawData &raw_data,
-                          const ResampleParams &params) {
-    // Initialize the Grid.
-    Grid grid;
+// Initialize the dimensions and bins of a grid for the given raw data.
+static void init_layout(Grid::Layout &grid, const RawData::RawData &raw_data,
+                        const Grid::ResampleParams &params) {
     grid.k = params.num_samples_mz;
     grid.t = params.num_samples_rt;
     grid.reference_mz = raw_data.reference_mz;
@@ -91,32 +122,44 @@ Grid::Grid Grid::resample(const RawData::RawData &raw_data,
     grid.max_rt = raw_data.max_rt;
 
     // Calculate the necessary dimensions for the Grid.
-    uint64_t n = x_index(grid, raw_data.max_mz) + 1;
-    uint64_t m = y_index(grid, raw_data.max_rt) + 1;
-    grid.n = n;
-    grid.m = m;
-    grid.data = std::vector<double>(n * m);
-    grid.bins_mz = std::vector<double>(n);
-    grid.bins_rt = std::vector<double>(m);
+    grid.n = Grid::x_index(grid, raw_data.max_mz) + 1;
+    grid.m = Grid::y_index(grid, raw_data.max_rt) + 1;
+    grid.bins_mz = std::vector<double>(grid.n);
+    grid.bins_rt = std::vector<double>(grid.m);
 
     // Generate bins_mz.
-    for (size_t i = 0; i < n; ++i) {
-        grid.bins_mz[i] = mz_at(grid, i);
+    for (size_t i = 0; i < grid.n; ++i) {
+        grid.bins_mz[i] = Grid::mz_at(grid, i);
     }
 
     // Generate bins_rt.
-    for (size_t j = 0; j < m; ++j) {
-        grid.bins_rt[j] = rt_at(grid, j);
+    for (size_t j = 0; j < grid.m; ++j) {
+        grid.bins_rt[j] = Grid::rt_at(grid, j);
     }
+}
+
+// Smoothing parameters shared by the resampling methods.
+struct Smoothing {
+    double sigma_rt;
+    std::vector<double> sigma_mz;
+    uint64_t rt_kernel_hw;
+    uint64_t mz_kernel_hw;
+};
+
+static Smoothing init_smoothing(const Grid::Layout &grid,
+                                const RawData::RawData &raw_data,
+                                const Grid::ResampleParams &params) {
+    Smoothing smoothing;
 
     // Pre-calculate the smoothing sigma values for all bins of the grid.
-    double sigma_rt = RawData::fwhm_to_sigma(raw_data.fwhm_rt) *
-                      params.smoothing_coef_rt / std::sqrt(2);
-    auto sigma_mz_vec = std::vector<double>(n);
-    for (size_t i = 0; i < n; ++i) {
-        sigma_mz_vec[i] = RawData::fwhm_to_sigma(RawData::theoretical_fwhm(
-                              raw_data, grid.bins_mz[i])) *
-                          params.smoothing_coef_mz / std::sqrt(2);
+    smoothing.sigma_rt = RawData::fwhm_to_sigma(raw_data.fwhm_rt) *
+                         params.smoothing_coef_rt / std::sqrt(2);
+    smoothing.sigma_mz = std::vector<double>(grid.n);
+    for (size_t i = 0; i < grid.n; ++i) {
+        smoothing.sigma_mz[i] =
+            RawData::fwhm_to_sigma(
+                RawData::theoretical_fwhm(raw_data, grid.bins_mz[i])) *
+            params.smoothing_coef_mz / std::sqrt(2);
     }
 
     // Pre-calculate the kernel half widths for rt and mz.
@@ -128,71 +171,199 @@ Grid::Grid Grid::resample(const RawData::RawData &raw_data,
     double delta_rt = grid.fwhm_rt / params.num_samples_rt;
     double delta_mz = grid.fwhm_mz / params.num_samples_mz;
     double sigma_mz_ref = RawData::fwhm_to_sigma(grid.fwhm_mz);
-    uint64_t rt_kernel_hw = 3 * sigma_rt / delta_rt;
-    uint64_t mz_kernel_hw = 3 * sigma_mz_ref / delta_mz;
+    smoothing.rt_kernel_hw = 3 * smoothing.sigma_rt / delta_rt;
+    smoothing.mz_kernel_hw = 3 * sigma_mz_ref / delta_mz;
+    return smoothing;
+}
 
-    // Gaussian splatting.
-    {
-        auto weights = std::vector<double>(n * m);
-        for (size_t s = 0; s < raw_data.scans.size(); ++s) {
-            const auto &scan = raw_data.scans[s];
-            double current_rt = scan.retention_time;
-
-            // Find the bin for the current retention time.
-            size_t index_rt = y_index(grid, current_rt);
-
-            // Find the min/max indexes for the rt kernel.
-            size_t j_min = 0;
-            if (index_rt >= rt_kernel_hw) {
-                j_min = index_rt - rt_kernel_hw;
+template <typename T>
+std::vector<T> Grid::smooth_rt(const BasicGrid<T> &grid, double sigma_rt,
+                               uint64_t rt_kernel_hw, size_t max_threads) {
+    auto smoothed_data = std::vector<T>(grid.n * grid.m);
+
+    // Retention time smoothing. Each thread smooths a range of rows. The
+    // kernel weights only depend on the row, so they are calculated once
+    // for all the columns. The columns are processed in small blocks that
+    // are accumulated in registers, so that the inner loop runs over
+    // contiguous memory and can be vectorized, instead of striding across
+    // rows for every cell.
+    auto smooth_rows = [&](size_t row_begin, size_t row_end) {
+        std::vector<double> kernel;
+        for (size_t j = row_begin; j < row_end; ++j) {
+            double current_rt = grid.bins_rt[j];
+            size_t min_k = 0;
+            if (j >= rt_kernel_hw) {
+                min_k = j - rt_kernel_hw;
+            }
+            size_t max_k = grid.m - 1;
+            if ((j + rt_kernel_hw) < grid.m) {
+                max_k = j + rt_kernel_hw;
             }
-            size_t j_max = grid.m - 1;
-            if ((index_rt + rt_kernel_hw) < grid.m) {
-                j_max = index_rt + rt_kernel_hw;
+            kernel.resize(max_k - min_k + 1);
+            double sum_weights = 0;
+            for (size_t k = min_k; k <= max_k; ++k) {
+                double a = (current_rt - grid.bins_rt[k]) / sigma_rt;
+                kernel[k - min_k] = std::exp(-0.5 * (a * a));
+                sum_weights += kernel[k - min_k];
             }
+            const size_t block_size = 8;
+            T *smoothed_row = &smoothed_data[j * grid.n];
+            size_t i = 0;
+            for (; i + block_size <= grid.n; i += block_size) {
+                double sum_weighted_values[block_size] = {};
+                for (size_t k = min_k; k <= max_k; ++k) {
+                    double weight = kernel[k - min_k];
+                    const T *row = &grid.data[i + k * grid.n];
+                    for (size_t b = 0; b < block_size; ++b) {
+                        sum_weighted_values[b] += weight * row[b];
+                    }
+                }
+                for (size_t b = 0; b < block_size; ++b) {
+                    smoothed_row[i + b] = sum_weighted_values[b] / sum_weights;
+                }
+            }
+            for (; i < grid.n; ++i) {
+                double sum_weighted_values = 0;
+                for (size_t k = min_k; k <= max_k; ++k) {
+                    sum_weighted_values +=
+                        kernel[k - min_k] * grid.data[i + k * grid.n];
+                }
+                smoothed_row[i] = sum_weighted_values / sum_weights;
+            }
+        }
+    };
+    ThreadPool::parallel_for(grid.m, max_threads, smooth_rows);
+    return smoothed_data;
+}
+
+template std::vector<double> Grid::smooth_rt<double>(const Grid &grid,
+                                                     double sigma_rt,
+                                                     uint64_t rt_kernel_hw,
+                                                     size_t max_threads);
+template std::vector<float> Grid::smooth_rt<float>(const FloatGrid &grid,
+                                                   double sigma_rt,
+                                                   uint64_t rt_kernel_hw,
+                                                   size_t max_threads);
 
-            for (size_t k = 0; k < scan.num_points; ++k) {
-                double current_intensity = scan.intensity[k];
-                double current_mz = scan.mz[k];
+template <typename T>
+Grid::BasicGrid<T> Grid::resample(const RawData::RawData &raw_data,
+                                  const ResampleParams &params,
+                                  size_t max_threads) {
+    // Initialize the Grid.
+    BasicGrid<T> grid;
+    init_layout(grid, raw_data, params);
+    MzIndex mz_index(grid);
+    uint64_t n = grid.n;
+    uint64_t m = grid.m;
+    grid.data = std::vector<T>(n * m);
 
-                // Find the bin for the current mz.
-                size_t index_mz = x_index(grid, current_mz);
+    auto smoothing = init_smoothing(grid, raw_data, params);
+    double sigma_rt = smoothing.sigma_rt;
+    const auto &sigma_mz_vec = smoothing.sigma_mz;
+    uint64_t rt_kernel_hw = smoothing.rt_kernel_hw;
+    uint64_t mz_kernel_hw = smoothing.mz_kernel_hw;
 
-                double sigma_mz = sigma_mz_vec[index_mz];
+    // Gaussian splatting.
+    //
+    // The grid is split in bands of retention time rows and each thread only
+    // splats onto the rows of its own band. The scans are visited in the same
+    // order for every band, so the results don't depend on the number of
+    // threads. Each thread accumulates the values and weights for a few rows
+    // at a time in double precision, instead of using temporary arrays with
+    // the size of the entire grid.
+    //
+    // The 2D Gaussian kernel is separable, so the weight of each grid point is
+    // the product of a m/z and a retention time weight. These are calculated
+    // once per point and once per scan respectively.
+    {
+        size_t band_rows = 4 * (2 * rt_kernel_hw + 1);
+        auto splat_rows = [&](size_t row_begin, size_t row_end) {
+            std::vector<double> values;
+            std::vector<double> weights;
+            std::vector<double> weights_rt;
+            std::vector<double> weights_mz;
+            for (size_t band_begin = row_begin; band_begin < row_end;
+                 band_begin += band_rows) {
+                size_t band_end = std::min(band_begin + band_rows, row_end);
+                values.assign((band_end - band_begin) * n, 0);
+                weights.assign((band_end - band_begin) * n, 0);
+                for (size_t s = 0; s < raw_data.scans.size(); ++s) {
+                    const auto &scan = raw_data.scans[s];
+                    double current_rt = scan.retention_time;
 
-                // Find the min/max indexes for the mz kernel.
-                size_t i_min = 0;
-                if (index_mz >= mz_kernel_hw) {
-                    i_min = index_mz - mz_kernel_hw;
-                }
-                size_t i_max = grid.n - 1;
-                if ((index_mz + mz_kernel_hw) < grid.n) {
-                    i_max = index_mz + mz_kernel_hw;
-                }
+                    // Find the bin for the current retention time.
+                    size_t index_rt = y_index(grid, current_rt);
+
+                    // Find the min/max indexes for the rt kernel, limited to
+                    // the rows of this band.
+                    size_t j_min = band_begin;
+                    if (index_rt >= rt_kernel_hw) {
+                        j_min = std::max(j_min, index_rt - rt_kernel_hw);
+                    }
+                    size_t j_max = band_end - 1;
+                    if ((index_rt + rt_kernel_hw) < band_end) {
+                        j_max = index_rt + rt_kernel_hw;
+                    }
+                    if (j_min > j_max) {
+                        continue;
+                    }
+                    weights_rt.resize(j_max - j_min + 1);
+                    for (size_t j = j_min; j <= j_max; ++j) {
+                        double b = (grid.bins_rt[j] - current_rt) / sigma_rt;
+                        weights_rt[j - j_min] = std::exp(-0.5 * b * b);
+                    }
+
+                    for (size_t k = 0; k < scan.num_points; ++k) {
+                        double current_intensity = scan.intensity[k];
+                        double current_mz = scan.mz[k];
 
-                for (size_t j = j_min; j <= j_max; ++j) {
-                    for (size_t i = i_min; i <= i_max; ++i) {
-                        double x = grid.bins_mz[i];
-                        double y = grid.bins_rt[j];
+                        // Find the bin for the current mz.
+                        size_t index_mz = mz_index.x_index(current_mz);
 
-                        // Calculate the Gaussian weight for this point.
-                        double a = (x - current_mz) / sigma_mz;
-                        double b = (y - current_rt) / sigma_rt;
-                        double weight = std::exp(-0.5 * (a * a + b * b));
+                        double sigma_mz = sigma_mz_vec[index_mz];
 
-                        grid.data[i + j * n] += weight * current_intensity;
-                        weights[i + j * n] += weight;
+                        // Find the min/max indexes for the mz kernel.
+                        size_t i_min = 0;
+                        if (index_mz >= mz_kernel_hw) {
+                            i_min = index_mz - mz_kernel_hw;
+                        }
+                        size_t i_max = grid.n - 1;
+                        if ((index_mz + mz_kernel_hw) < grid.n) {
+                            i_max = index_mz + mz_kernel_hw;
+                        }
+
+                        weights_mz.resize(i_max - i_min + 1);
+                        for (size_t i = i_min; i <= i_max; ++i) {
+                            double a =
+                                (grid.bins_mz[i] - current_mz) / sigma_mz;
+                            weights_mz[i - i_min] = std::exp(-0.5 * a * a);
+                        }
+
+                        for (size_t j = j_min; j <= j_max; ++j) {
+                            double weight_rt = weights_rt[j - j_min];
+                            size_t offset = (j - band_begin) * n;
+                            for (size_t i = i_min; i <= i_max; ++i) {
+                                double weight =
+                                    weights_mz[i - i_min] * weight_rt;
+                                values[i + offset] +=
+                                    weight * current_intensity;
+                                weights[i + offset] += weight;
+                            }
+                        }
                     }
                 }
+
+                // Normalize the band and store it in the grid.
+                for (size_t i = 0; i < values.size(); ++i) {
+                    double weight = weights[i];
+                    if (weight == 0) {
+                        weight = 1;
+                    }
+                    grid.data[band_begin * n + i] = values[i] / weight;
+                }
             }
-        }
-        for (size_t i = 0; i < (n * m); ++i) {
-            double weight = weights[i];
-            if (weight == 0) {
-                weight = 1;
-            }
-            grid.data[i] = grid.data[i] / weight;
-        }
+        };
+        ThreadPool::parallel_for(m, max_threads, splat_rows, band_rows);
     }
 
     // Gaussian smoothing.
@@ -200,73 +371,621 @@ Grid::Grid Grid::resample(const RawData::RawData &raw_data,
     // The Gaussian 2D filter is separable. We obtain the same result with
     // faster performance by applying two 1D kernel convolutions instead. This
     // is specially noticeable on the full image.
+    grid.data = smooth_rt(grid, sigma_rt, rt_kernel_hw, max_threads);
     {
-        auto smoothed_data = std::vector<double>(grid.n * grid.m);
+        auto smoothed_data = std::vector<T>(grid.n * grid.m);
 
-        // Retention time smoothing.
-        for (size_t j = 0; j < grid.m; ++j) {
-            double current_rt = grid.bins_rt[j];
-            size_t min_k = 0;
-            if (j >= rt_kernel_hw) {
-                min_k = j - rt_kernel_hw;
-            }
-            size_t max_k = grid.m - 1;
-            if ((j + rt_kernel_hw) < grid.m) {
-                max_k = j + rt_kernel_hw;
-            }
-            for (size_t i = 0; i < grid.n; ++i) {
+        // mz smoothing. Each thread smooths a range of columns.
+        //
+        // Since sigma_mz is not constant, we need to calculate the kernel
+        // weights for each potential mz value. They are shared by all the rows.
+        auto smooth_columns = [&](size_t column_begin, size_t column_end) {
+            std::vector<double> kernel;
+            for (size_t i = column_begin; i < column_end; ++i) {
+                double sigma_mz = sigma_mz_vec[i];
+                double current_mz = grid.bins_mz[i];
+
+                size_t min_k = 0;
+                if (i >= mz_kernel_hw) {
+                    min_k = i - mz_kernel_hw;
+                }
+                size_t max_k = grid.n - 1;
+                if ((i + mz_kernel_hw) < grid.n) {
+                    max_k = i + mz_kernel_hw;
+                }
+                kernel.resize(max_k - min_k + 1);
                 double sum_weights = 0;
-                double sum_weighted_values = 0;
                 for (size_t k = min_k; k <= max_k; ++k) {
-                    double a = (current_rt - grid.bins_rt[k]) / sigma_rt;
-                    double weight = std::exp(-0.5 * (a * a));
-                    sum_weights += weight;
-                    sum_weighted_values += weight * grid.data[i + k * grid.n];
+                    double a = (current_mz - grid.bins_mz[k]) / sigma_mz;
+                    kernel[k - min_k] = std::exp(-0.5 * (a * a));
+                    sum_weights += kernel[k - min_k];
+                }
+                for (size_t j = 0; j < grid.m; ++j) {
+                    double sum_weighted_values = 0;
+                    for (size_t k = min_k; k <= max_k; ++k) {
+                        sum_weighted_values +=
+                            kernel[k - min_k] * grid.data[k + j * grid.n];
+                    }
+                    smoothed_data[i + j * grid.n] =
+                        sum_weighted_values / sum_weights;
                 }
-                smoothed_data[i + j * grid.n] =
-                    sum_weighted_values / sum_weights;
             }
+        };
+        ThreadPool::parallel_for(grid.n, max_threads, smooth_columns);
+        grid.data = std::move(smoothed_data);
+    }
+    return grid;
+}
+
+template Grid::Grid Grid::resample<double>(const RawData::RawData &raw_data,
+                                           const ResampleParams &params,
+                                           size_t max_threads);
+template Grid::FloatGrid Grid::resample<float>(
+    const RawData::RawData &raw_data, const ResampleParams &params,
+    size_t max_threads);
+
+template <typename T>
+Grid::BasicTiledGrid<T> Grid::resample_tiled(const RawData::RawData &raw_data,
+                                             const ResampleParams &params,
+                                             size_t max_threads) {
+    // Initialize the Grid.
+    BasicTiledGrid<T> grid;
+    init_layout(grid, raw_data, params);
+    MzIndex mz_index(grid);
+    uint64_t n = grid.n;
+    uint64_t m = grid.m;
+    grid.num_tiles_mz = (n + TILE_SIZE - 1) / TILE_SIZE;
+    grid.num_tiles_rt = (m + TILE_SIZE - 1) / TILE_SIZE;
+    const uint64_t tile_area = TILE_SIZE * TILE_SIZE;
+
+    auto smoothing = init_smoothing(grid, raw_data, params);
+    double sigma_rt = smoothing.sigma_rt;
+    const auto &sigma_mz_vec = smoothing.sigma_mz;
+    uint64_t rt_kernel_hw = smoothing.rt_kernel_hw;
+    uint64_t mz_kernel_hw = smoothing.mz_kernel_hw;
+
+    // Find the bins within reach of the splatting kernel of each scan/point.
+    // Both return false if the range doesn't overlap [begin, end].
+    auto rt_range = [&](double rt, size_t half_width, size_t begin,
+                        size_t end, size_t &j_min, size_t &j_max) {
+        size_t index_rt = y_index(grid, rt);
+        j_min = begin;
+        if (index_rt >= half_width) {
+            j_min = std::max(j_min, index_rt - half_width);
+        }
+        j_max = end;
+        if ((index_rt + half_width) < end) {
+            j_max = index_rt + half_width;
+        }
+        return j_min <= j_max;
+    };
+    auto mz_range = [&](size_t index_mz, size_t half_width, size_t &i_min,
+                        size_t &i_max) {
+        i_min = 0;
+        if (index_mz >= half_width) {
+            i_min = index_mz - half_width;
         }
-        grid.data = smoothed_data;
+        i_max = grid.n - 1;
+        if ((index_mz + half_width) < grid.n) {
+            i_max = index_mz + half_width;
+        }
+    };
+
+    // Allocate the tiles that can contain signal. The smoothing step spreads
+    // the splatted values by one more kernel half width in each dimension.
+    {
+        auto used = std::vector<uint8_t>(grid.num_tiles_mz * grid.num_tiles_rt);
+        auto mark_tiles = [&](size_t tile_begin, size_t tile_end) {
+            size_t row_begin = tile_begin * TILE_SIZE;
+            size_t row_end = std::min(tile_end * TILE_SIZE, m) - 1;
+            for (const auto &scan : raw_data.scans) {
+                size_t j_min = 0;
+                size_t j_max = 0;
+                if (!rt_range(scan.retention_time, 2 * rt_kernel_hw,
+                              row_begin, row_end, j_min, j_max)) {
+                    continue;
+                }
+                for (size_t k = 0; k < scan.num_points; ++k) {
+                    size_t i_min = 0;
+                    size_t i_max = 0;
+                    mz_range(mz_index.x_index(scan.mz[k]), 2 * mz_kernel_hw,
+                             i_min, i_max);
+                    for (size_t y = j_min / TILE_SIZE; y <= j_max / TILE_SIZE;
+                         ++y) {
+                        for (size_t x = i_min / TILE_SIZE;
+                             x <= i_max / TILE_SIZE; ++x) {
+                            used[x + y * grid.num_tiles_mz] = 1;
+                        }
+                    }
+                }
+            }
+        };
+        ThreadPool::parallel_for(grid.num_tiles_rt, max_threads, mark_tiles);
+
+        grid.tile_index = std::vector<uint64_t>(used.size(), NO_TILE);
+        uint64_t num_tiles = 0;
+        for (size_t i = 0; i < used.size(); ++i) {
+            if (used[i]) {
+                grid.tile_index[i] = num_tiles++;
+            }
+        }
+        grid.data = std::vector<T>(num_tiles * tile_area);
+    }
+
+    // Gaussian splatting.
+    //
+    // Same as in the dense resampling, but the values and weights of each row
+    // of tiles are accumulated only for the allocated tiles. Since the tiles
+    // are numbered in row major order, the tiles of each row are contiguous.
+    {
+        auto splat_rows = [&](size_t tile_begin, size_t tile_end) {
+            std::vector<double> values;
+            std::vector<double> weights;
+            std::vector<double> weights_rt;
+            std::vector<double> weights_mz;
+            for (size_t y = tile_begin; y < tile_end; ++y) {
+                // Find the allocated tiles for this row.
+                uint64_t first_tile = NO_TILE;
+                uint64_t num_tiles = 0;
+                for (size_t x = 0; x < grid.num_tiles_mz; ++x) {
+                    uint64_t tile = grid.tile_index[x + y * grid.num_tiles_mz];
+                    if (tile != NO_TILE) {
+                        first_tile = std::min(first_tile, tile);
+                        ++num_tiles;
+                    }
+                }
+                if (num_tiles == 0) {
+                    continue;
+                }
+                values.assign(num_tiles * tile_area, 0);
+                weights.assign(num_tiles * tile_area, 0);
+
+                size_t row_begin = y * TILE_SIZE;
+                size_t row_end = std::min(row_begin + TILE_SIZE, m) - 1;
+                for (const auto &scan : raw_data.scans) {
+                    double current_rt = scan.retention_time;
+                    size_t j_min = 0;
+                    size_t j_max = 0;
+                    if (!rt_range(current_rt, rt_kernel_hw, row_begin,
+                                  row_end, j_min, j_max)) {
+                        continue;
+                    }
+                    weights_rt.resize(j_max - j_min + 1);
+                    for (size_t j = j_min; j <= j_max; ++j) {
+                        double b = (grid.bins_rt[j] - current_rt) / sigma_rt;
+                        weights_rt[j - j_min] = std::exp(-0.5 * b * b);
+                    }
+
+                    for (size_t k = 0; k < scan.num_points; ++k) {
+                        double current_intensity = scan.intensity[k];
+                        double current_mz = scan.mz[k];
+                        size_t index_mz = mz_index.x_index(current_mz);
+                        double sigma_mz = sigma_mz_vec[index_mz];
+                        size_t i_min = 0;
+                        size_t i_max = 0;
+                        mz_range(index_mz, mz_kernel_hw, i_min, i_max);
+
+                        weights_mz.resize(i_max - i_min + 1);
+                        for (size_t i = i_min; i <= i_max; ++i) {
+                            double a =
+                                (grid.bins_mz[i] - current_mz) / sigma_mz;
+                            weights_mz[i - i_min] = std::exp(-0.5 * a * a);
+                        }
+
+                        for (size_t j = j_min; j <= j_max; ++j) {
+                            double weight_rt = weights_rt[j - j_min];
+                            size_t row_offset = (j - row_begin) * TILE_SIZE;
+                            // Split the kernel at the tile boundaries.
+                            for (size_t i = i_min; i <= i_max;) {
+                                size_t x = i / TILE_SIZE;
+                                size_t column = x * TILE_SIZE;
+                                size_t segment_end =
+                                    std::min(i_max, column + TILE_SIZE - 1);
+                                uint64_t tile =
+                                    grid.tile_index[x + y * grid.num_tiles_mz];
+                                size_t offset =
+                                    (tile - first_tile) * tile_area +
+                                    row_offset;
+                                for (; i <= segment_end; ++i) {
+                                    double weight =
+                                        weights_mz[i - i_min] * weight_rt;
+                                    values[offset + i - column] +=
+                                        weight * current_intensity;
+                                    weights[offset + i - column] += weight;
+                                }
+                            }
+                        }
+                    }
+                }
+
+                // Normalize the tiles and store them in the grid.
+                for (size_t i = 0; i < values.size(); ++i) {
+                    double weight = weights[i];
+                    if (weight == 0) {
+                        weight = 1;
+                    }
+                    grid.data[first_tile * tile_area + i] = values[i] / weight;
+                }
+            }
+        };
+        ThreadPool::parallel_for(grid.num_tiles_rt, max_threads, splat_rows);
+    }
+
+    // Gaussian smoothing.
+    //
+    // Same as in the dense resampling, but only the allocated tiles are
+    // smoothed, and the empty tiles are skipped when adding up the weighted
+    // values.
+    auto smoothed_data = std::vector<T>(grid.data.size());
+    {
+        // Retention time smoothing.
+        auto smooth_rows = [&](size_t tile_begin, size_t tile_end) {
+            std::vector<double> kernel;
+            for (size_t y = tile_begin; y < tile_end; ++y) {
+                for (size_t x = 0; x < grid.num_tiles_mz; ++x) {
+                    uint64_t tile = grid.tile_index[x + y * grid.num_tiles_mz];
+                    if (tile == NO_TILE) {
+                        continue;
+                    }
+                    size_t row_end = std::min(y * TILE_SIZE + TILE_SIZE, m);
+                    for (size_t j = y * TILE_SIZE; j < row_end; ++j) {
+                        double current_rt = grid.bins_rt[j];
+                        size_t min_k = 0;
+                        if (j >= rt_kernel_hw) {
+                            min_k = j - rt_kernel_hw;
+                        }
+                        size_t max_k = grid.m - 1;
+                        if ((j + rt_kernel_hw) < grid.m) {
+                            max_k = j + rt_kernel_hw;
+                        }
+                        kernel.resize(max_k - min_k + 1);
+                        double sum_weights = 0;
+                        for (size_t k = min_k; k <= max_k; ++k) {
+                            double a =
+                                (current_rt - grid.bins_rt[k]) / sigma_rt;
+                            kernel[k - min_k] = std::exp(-0.5 * (a * a));
+                            sum_weights += kernel[k - min_k];
+                        }
+                        double sum_weighted_values[TILE_SIZE] = {};
+                        for (size_t k = min_k; k <= max_k; ++k) {
+                            uint64_t source_tile =
+                                grid.tile_index[x + k / TILE_SIZE *
+                                                        grid.num_tiles_mz];
+                            if (source_tile == NO_TILE) {
+                                continue;
+                            }
+                            double weight = kernel[k - min_k];
+                            const T *row =
+                                &grid.data[source_tile * tile_area +
+                                           k % TILE_SIZE * TILE_SIZE];
+                            for (size_t b = 0; b < TILE_SIZE; ++b) {
+                                sum_weighted_values[b] += weight * row[b];
+                            }
+                        }
+                        T *smoothed_row = &smoothed_data[tile * tile_area +
+                                                         j % TILE_SIZE *
+                                                             TILE_SIZE];
+                        for (size_t b = 0; b < TILE_SIZE; ++b) {
+                            smoothed_row[b] =
+                                sum_weighted_values[b] / sum_weights;
+                        }
+                    }
+                }
+            }
+        };
+        ThreadPool::parallel_for(grid.num_tiles_rt, max_threads, smooth_rows);
     }
     {
-        auto smoothed_data = std::vector<double>(grid.n * grid.m);
+        // mz smoothing. The rows of each tile are copied with their
+        // neighbouring values into a buffer, so that the kernel can be applied
+        // without looking up the tile of each value. The results are stored
+        // back in the grid.
+        auto smoothed_at = [&](size_t i, size_t j) -> T {
+            uint64_t tile = grid.tile_index[i / TILE_SIZE +
+                                            j / TILE_SIZE * grid.num_tiles_mz];
+            if (tile == NO_TILE) {
+                return 0;
+            }
+            return smoothed_data[tile * tile_area +
+                                 j % TILE_SIZE * TILE_SIZE + i % TILE_SIZE];
+        };
+        auto smooth_columns = [&](size_t tile_begin, size_t tile_end) {
+            std::vector<double> kernels(TILE_SIZE * (2 * mz_kernel_hw + 1));
+            std::vector<double> sum_weights(TILE_SIZE);
+            std::vector<size_t> min_ks(TILE_SIZE);
+            std::vector<size_t> max_ks(TILE_SIZE);
+            std::vector<double> buffer(TILE_SIZE + 2 * mz_kernel_hw);
+            for (size_t y = tile_begin; y < tile_end; ++y) {
+                for (size_t x = 0; x < grid.num_tiles_mz; ++x) {
+                    uint64_t tile = grid.tile_index[x + y * grid.num_tiles_mz];
+                    if (tile == NO_TILE) {
+                        continue;
+                    }
 
-        // mz smoothing.
-        //
-        // Since sigma_mz is not constant, we need to calculate the kernel half
-        // width for each potential mz value.
+                    // Calculate the kernels for the columns of this tile.
+                    size_t column_begin = x * TILE_SIZE;
+                    size_t column_end = std::min(column_begin + TILE_SIZE, n);
+                    for (size_t i = column_begin; i < column_end; ++i) {
+                        double sigma_mz = sigma_mz_vec[i];
+                        double current_mz = grid.bins_mz[i];
+                        size_t b = i - column_begin;
+                        min_ks[b] = 0;
+                        if (i >= mz_kernel_hw) {
+                            min_ks[b] = i - mz_kernel_hw;
+                        }
+                        max_ks[b] = grid.n - 1;
+                        if ((i + mz_kernel_hw) < grid.n) {
+                            max_ks[b] = i + mz_kernel_hw;
+                        }
+                        sum_weights[b] = 0;
+                        double *kernel = &kernels[b * (2 * mz_kernel_hw + 1)];
+                        for (size_t k = min_ks[b]; k <= max_ks[b]; ++k) {
+                            double a =
+                                (current_mz - grid.bins_mz[k]) / sigma_mz;
+                            kernel[k - min_ks[b]] = std::exp(-0.5 * (a * a));
+                            sum_weights[b] += kernel[k - min_ks[b]];
+                        }
+                    }
+
+                    size_t row_end = std::min(y * TILE_SIZE + TILE_SIZE, m);
+                    for (size_t j = y * TILE_SIZE; j < row_end; ++j) {
+                        // The buffer holds the columns
+                        // [column_begin - hw, column_begin + TILE_SIZE + hw).
+                        for (size_t p = 0; p < buffer.size(); ++p) {
+                            buffer[p] = 0;
+                            if (column_begin + p < mz_kernel_hw) {
+                                continue;
+                            }
+                            size_t i = column_begin + p - mz_kernel_hw;
+                            if (i < n) {
+                                buffer[p] = smoothed_at(i, j);
+                            }
+                        }
+                        T *smoothed_row = &grid.data[tile * tile_area +
+                                                     j % TILE_SIZE * TILE_SIZE];
+                        for (size_t i = column_begin; i < column_end; ++i) {
+                            size_t b = i - column_begin;
+                            const double *kernel =
+                                &kernels[b * (2 * mz_kernel_hw + 1)];
+                            double sum_weighted_values = 0;
+                            for (size_t k = min_ks[b]; k <= max_ks[b]; ++k) {
+                                sum_weighted_values +=
+                                    kernel[k - min_ks[b]] *
+                                    buffer[k + mz_kernel_hw - column_begin];
+                            }
+                            smoothed_row[b] =
+                                sum_weighted_values / sum_weights[b];
+                        }
+                    }
+                }
+            }
+        };
+        ThreadPool::parallel_for(grid.num_tiles_rt, max_threads,
+                                 smooth_columns);
+    }
+    return grid;
+}
+
+template Grid::TiledGrid Grid::resample_tiled<double>(
+    const RawData::RawData &raw_data, const ResampleParams &params,
+    size_t max_threads);
+template Grid::FloatTiledGrid Grid::resample_tiled<float>(
+    const RawData::RawData &raw_data, const ResampleParams &params,
+    size_t max_threads);
+
+template <typename T>
+Grid::BasicGrid<T> Grid::to_dense(const BasicTiledGrid<T> &grid) {
+    BasicGrid<T> dense_grid;
+    static_cast<Layout &>(dense_grid) = grid;
+    dense_grid.data = std::vector<T>(grid.n * grid.m);
+    for (size_t j = 0; j < grid.m; ++j) {
         for (size_t i = 0; i < grid.n; ++i) {
-            double sigma_mz = sigma_mz_vec[i];
-            double current_mz = grid.bins_mz[i];
+            dense_grid.data[i + j * grid.n] = value_at(grid, i, j);
+        }
+    }
+    return dense_grid;
+}
 
-            size_t min_k = 0;
-            if (i >= mz_kernel_hw) {
-                min_k = i - mz_kernel_hw;
+template Grid::Grid Grid::to_dense<double>(const TiledGrid &grid);
+template Grid::FloatGrid Grid::to_dense<float>(const FloatTiledGrid &grid);
+
+Grid::StreamingResampler::StreamingResampler(const RawData::RawData &raw_data,
+                                             const ResampleParams &params,
+                                             RowCallback callback)
+    : grid([&] {
+          Layout layout;
+          init_layout(layout, raw_data, params);
+          return layout;
+      }()),
+      mz_index(grid),
+      callback(std::move(callback)),
+      last_rt(-std::numeric_limits<double>::infinity()),
+      finished(false),
+      splat_begin(0),
+      normalized_begin(0),
+      next_row(0) {
+    auto smoothing = init_smoothing(grid, raw_data, params);
+    sigma_rt = smoothing.sigma_rt;
+    sigma_mz = std::move(smoothing.sigma_mz);
+    rt_kernel_hw = smoothing.rt_kernel_hw;
+    mz_kernel_hw = smoothing.mz_kernel_hw;
+
+    // The m/z kernel of each column is the same for all rows.
+    size_t kernel_size = 2 * mz_kernel_hw + 1;
+    mz_kernels = std::vector<double>(grid.n * kernel_size);
+    mz_kernel_sums = std::vector<double>(grid.n);
+    for (size_t i = 0; i < grid.n; ++i) {
+        size_t min_k = i >= mz_kernel_hw ? i - mz_kernel_hw : 0;
+        size_t max_k = std::min(i + mz_kernel_hw, grid.n - 1);
+        double sum_weights = 0;
+        for (size_t k = min_k; k <= max_k; ++k) {
+            double a = (grid.bins_mz[i] - grid.bins_mz[k]) / sigma_mz[i];
+            double weight = std::exp(-0.5 * (a * a));
+            mz_kernels[i * kernel_size + k - min_k] = weight;
+            sum_weights += weight;
+        }
+        mz_kernel_sums[i] = sum_weights;
+    }
+}
+
+bool Grid::StreamingResampler::add_scan(const RawData::Scan &scan) {
+    double current_rt = scan.retention_time;
+    if (finished || current_rt < last_rt) {
+        return false;
+    }
+    last_rt = current_rt;
+
+    // The following scans can't contribute to the rows before the rt kernel
+    // of this scan.
+    size_t index_rt = y_index(grid, current_rt);
+    if (index_rt >= rt_kernel_hw) {
+        complete_rows(index_rt - rt_kernel_hw);
+    }
+
+    // Find the min/max indexes for the rt kernel.
+    size_t j_min = index_rt >= rt_kernel_hw ? index_rt - rt_kernel_hw : 0;
+    size_t j_max = grid.m - 1;
+    if ((index_rt + rt_kernel_hw) < grid.m) {
+        j_max = index_rt + rt_kernel_hw;
+    }
+    if (j_min > j_max) {
+        return true;
+    }
+    while (splat_begin + values.size() <= j_max) {
+        values.emplace_back(grid.n);
+        weights.emplace_back(grid.n);
+    }
+    weights_rt.resize(j_max - j_min + 1);
+    for (size_t j = j_min; j <= j_max; ++j) {
+        double b = (grid.bins_rt[j] - current_rt) / sigma_rt;
+        weights_rt[j - j_min] = std::exp(-0.5 * b * b);
+    }
+
+    for (size_t k = 0; k < scan.num_points; ++k) {
+        double current_intensity = scan.intensity[k];
+        double current_mz = scan.mz[k];
+
+        // Find the bin for the current mz.
+        size_t index_mz = mz_index.x_index(current_mz);
+        double sigma = sigma_mz[index_mz];
+
+        // Find the min/max indexes for the mz kernel.
+        size_t i_min = index_mz >= mz_kernel_hw ? index_mz - mz_kernel_hw : 0;
+        size_t i_max = grid.n - 1;
+        if ((index_mz + mz_kernel_hw) < grid.n) {
+            i_max = index_mz + mz_kernel_hw;
+        }
+
+        weights_mz.resize(i_max - i_min + 1);
+        for (size_t i = i_min; i <= i_max; ++i) {
+            double a = (grid.bins_mz[i] - current_mz) / sigma;
+            weights_mz[i - i_min] = std::exp(-0.5 * a * a);
+        }
+
+        for (size_t j = j_min; j <= j_max; ++j) {
+            double weight_rt = weights_rt[j - j_min];
+            auto &row_values = values[j - splat_begin];
+            auto &row_weights = weights[j - splat_begin];
+            for (size_t i = i_min; i <= i_max; ++i) {
+                double weight = weights_mz[i - i_min] * weight_rt;
+                row_values[i] += weight * current_intensity;
+                row_weights[i] += weight;
             }
-            size_t max_k = grid.n - 1;
-            if ((i + mz_kernel_hw) < grid.n) {
-                max_k = i + mz_kernel_hw;
+        }
+    }
+    return true;
+}
+
+void Grid::StreamingResampler::finish() {
+    if (finished) {
+        return;
+    }
+    complete_rows(grid.m);
+    finished = true;
+}
+
+void Grid::StreamingResampler::complete_rows(uint64_t end) {
+    end = std::min(end, grid.m);
+    while (splat_begin < end) {
+        if (values.empty()) {
+            values.emplace_back(grid.n);
+            weights.emplace_back(grid.n);
+        }
+        auto row_values = std::move(values.front());
+        const auto &row_weights = weights.front();
+        for (size_t i = 0; i < grid.n; ++i) {
+            double weight = row_weights[i];
+            if (weight == 0) {
+                weight = 1;
             }
-            for (size_t j = 0; j < grid.m; ++j) {
-                double sum_weights = 0;
-                double sum_weighted_values = 0;
-                for (size_t k = min_k; k <= max_k; ++k) {
-                    double a = (current_mz - grid.bins_mz[k]) / sigma_mz;
-                    double weight = std::exp(-0.5 * (a * a));
-                    sum_weights += weight;
-                    sum_weighted_values += weight * grid.data[k + j * grid.n];
-                }
-                smoothed_data[i + j * grid.n] =
-                    sum_weighted_values / sum_weights;
+            row_values[i] = row_values[i] / weight;
+        }
+        normalized.push_back(std::move(row_values));
+        values.pop_front();
+        weights.pop_front();
+        ++splat_begin;
+        emit_rows();
+    }
+}
+
+void Grid::StreamingResampler::emit_rows() {
+    size_t kernel_size = 2 * mz_kernel_hw + 1;
+    std::vector<double> kernel;
+    while (next_row < grid.m) {
+        size_t j = next_row;
+        size_t min_k = j >= rt_kernel_hw ? j - rt_kernel_hw : 0;
+        size_t max_k = std::min(j + rt_kernel_hw, grid.m - 1);
+        if (normalized_begin + normalized.size() <= max_k) {
+            break;
+        }
+
+        // Retention time smoothing.
+        double current_rt = grid.bins_rt[j];
+        kernel.resize(max_k - min_k + 1);
+        double sum_weights = 0;
+        for (size_t k = min_k; k <= max_k; ++k) {
+            double a = (current_rt - grid.bins_rt[k]) / sigma_rt;
+            kernel[k - min_k] = std::exp(-0.5 * (a * a));
+            sum_weights += kernel[k - min_k];
+        }
+        smoothed_rt.assign(grid.n, 0);
+        for (size_t k = min_k; k <= max_k; ++k) {
+            double weight = kernel[k - min_k];
+            const auto &normalized_row = normalized[k - normalized_begin];
+            for (size_t i = 0; i < grid.n; ++i) {
+                smoothed_rt[i] += weight * normalized_row[i];
+            }
+        }
+        for (size_t i = 0; i < grid.n; ++i) {
+            smoothed_rt[i] /= sum_weights;
+        }
+
+        // mz smoothing.
+        row.resize(grid.n);
+        for (size_t i = 0; i < grid.n; ++i) {
+            size_t min_i = i >= mz_kernel_hw ? i - mz_kernel_hw : 0;
+            size_t max_i = std::min(i + mz_kernel_hw, grid.n - 1);
+            const double *mz_kernel = &mz_kernels[i * kernel_size];
+            double sum_weighted_values = 0;
+            for (size_t k = min_i; k <= max_i; ++k) {
+                sum_weighted_values += mz_kernel[k - min_i] * smoothed_rt[k];
             }
+            row[i] = sum_weighted_values / mz_kernel_sums[i];
+        }
+        callback(j, row);
+        ++next_row;
+
+        // Drop the rows that are no longer needed.
+        while (normalized_begin + rt_kernel_hw < next_row) {
+            normalized.pop_front();
+            ++normalized_begin;
         }
-        grid.data = smoothed_data;
     }
-    return grid;
 }
 
-Grid::Grid Grid::subset(Grid grid, double min_mz, double max_mz, double min_rt, double max_rt) {
+template <typename T>
+Grid::BasicGrid<T> Grid::subset(BasicGrid<T> grid, double min_mz,
+                                double max_mz, double min_rt, double max_rt) {
     // Find min/max bin in mz and rt.
     size_t min_mz_idx = Search::lower_bound(grid.bins_mz, min_mz);
     size_t max_mz_idx = Search::lower_bound(grid.bins_mz, max_mz);
@@ -274,7 +993,7 @@ Grid::Grid Grid::subset(Grid grid, double min_mz, double max_mz, double min_rt,
     size_t max_rt_idx = Search::lower_bound(grid.bins_rt, max_rt);
 
     // Initialize new grid.
-    Grid new_grid;
+    BasicGrid<T> new_grid;
     new_grid.n = max_mz_idx - min_mz_idx;
     new_grid.m = max_rt_idx - min_rt_idx;
     new_grid.k = grid.k;
@@ -289,7 +1008,7 @@ Grid::Grid Grid::subset(Grid grid, double min_mz, double max_mz, double min_rt,
     new_grid.max_rt = grid.bins_mz[max_rt_idx];
 
     // Initialize new grid memory.
-    new_grid.data = std::vector<double>(new_grid.n * new_grid.m);
+    new_grid.data = std::vector<T>(new_grid.n * new_grid.m);
 
     // Initialize bins.
     new_grid.bins_mz = std::vector<double>(new_grid.n);
@@ -315,3 +1034,10 @@ Grid::Grid Grid::subset(Grid grid, double min_mz, double max_mz, double min_rt,
 
     return new_grid;
 }
+
+template Grid::Grid Grid::subset<double>(Grid grid, double min_mz,
+                                         double max_mz, double min_rt,
+                                         double max_rt);
+template Grid::FloatGrid Grid::subset<float>(FloatGrid grid, double min_mz,
+                                             double max_mz, double min_rt,
+                                             double max_rt);
@@ -1,14 +1,20 @@
 #ifndef GRID_GRID_HPP
 #define GRID_GRID_HPP
 
+#include <cmath>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
 #include <vector>
 
 #include "raw_data/raw_data.hpp"
 
 namespace Grid {
 
-struct Grid {
+// The dimensions, bins and parameters of a grid, which don't depend on the
+// type used for storing the grid data.
+struct Layout {
     // Represent the grid dimensions in index coordinates:
     //   n: Number of sampling points in mz.
     //   m: Number of sampling points in rt.
@@ -19,15 +25,8 @@ struct Grid {
     uint64_t k;
     uint64_t t;
 
-    // The Grid data is stored as an array, and the mz and rt corresponding to
-    // each bin is memoized for quick indexing when searching.
-    // TODO(alex): Not sure that these should be doubles anymore, it uses
-    // a significant amount of memory and is storing smoothed data, which
-    // already alters the precision of the initial measurements. The issue is
-    // that the resampling procedure involves the summation of many numbers on
-    // several grid points, which might significantly alter results. More
-    // testing is needed.
-    std::vector<double> data;
+    // The mz and rt corresponding to each bin is memoized for quick indexing
+    // when searching.
     std::vector<double> bins_mz;
     std::vector<double> bins_rt;
 
@@ -45,6 +44,100 @@ struct Grid {
     double max_rt;
 };
 
+// The Grid data is stored as an array of n * m values in row major order
+// (Consecutive values correspond to consecutive mz bins). Since the grid is
+// storing smoothed data, single precision is usually enough and halves the
+// memory requirements. Note that the intermediate sums in the resampling
+// procedure are always performed in double precision.
+template <typename T>
+struct BasicGrid : Layout {
+    std::vector<T> data;
+};
+using Grid = BasicGrid<double>;
+using FloatGrid = BasicGrid<float>;
+
+// A grid where the data is split into square tiles of TILE_SIZE x TILE_SIZE
+// values. Most of the mz/rt plane of an LC-MS run is empty, so only the tiles
+// that can contain signal are allocated, and the rest are assumed to be zero.
+static constexpr uint64_t TILE_SIZE = 64;
+static constexpr uint64_t NO_TILE = std::numeric_limits<uint64_t>::max();
+template <typename T>
+struct BasicTiledGrid : Layout {
+    // Number of tiles in the mz and rt dimensions.
+    uint64_t num_tiles_mz;
+    uint64_t num_tiles_rt;
+
+    // Position of each tile in the data array, stored in row major order
+    // (tile_index[x + y * num_tiles_mz]), or NO_TILE for empty tiles.
+    std::vector<uint64_t> tile_index;
+
+    // Data of the allocated tiles. Each tile uses TILE_SIZE * TILE_SIZE
+    // consecutive values in row major order. The values of a tile that fall
+    // outside of the grid are zero.
+    std::vector<T> data;
+};
+using TiledGrid = BasicTiledGrid<double>;
+using FloatTiledGrid = BasicTiledGrid<float>;
+
+// Get the value at index i/j of a tiled grid.
+template <typename T>
+inline T value_at(const BasicTiledGrid<T> &grid, uint64_t i, uint64_t j) {
+    uint64_t tile =
+        grid.tile_index[i / TILE_SIZE + j / TILE_SIZE * grid.num_tiles_mz];
+    if (tile == NO_TILE) {
+        return 0;
+    }
+    return grid.data[tile * TILE_SIZE * TILE_SIZE +
+                     (j % TILE_SIZE) * TILE_SIZE + i % TILE_SIZE];
+}
+
+// Calculate the index i/j for the given mz/rt on the grid. This calculation is
+// performed in linear time.
+uint64_t x_index(const Layout &grid, double mz);
+uint64_t y_index(const Layout &grid, double rt);
+
+// Calculate the mz/rt at index i/j for a given grid. The calculation is
+// performed in linear time.
+double mz_at(const Layout &grid, uint64_t i);
+double rt_at(const Layout &grid, uint64_t j);
+
+// Precalculated version of x_index for repeated evaluations, as in the
+// resampling loops where it is called for every raw data point. The terms of
+// the instrument specific formula that don't depend on the mz are calculated
+// once, including the std::pow for ORBITRAP instruments. The operations are
+// performed in the same order as in x_index, so the results are identical.
+class MzIndex {
+   public:
+    explicit MzIndex(const Layout &grid);
+
+    uint64_t x_index(double mz) const {
+        switch (instrument_type) {
+            case Instrument::ORBITRAP:
+                return static_cast<uint64_t>(scale *
+                                             (offset - 1 / std::sqrt(mz)));
+            case Instrument::FTICR:
+                return static_cast<uint64_t>(scale * (1 - min_mz / mz) *
+                                             numerator / denominator);
+            case Instrument::TOF:
+                return static_cast<uint64_t>(scale * std::log(mz / min_mz));
+            case Instrument::QUAD:
+                return static_cast<uint64_t>(scale * (mz - min_mz) /
+                                             denominator);
+            default:
+                // Can't handle unknown instruments.
+                return 0;
+        }
+    }
+
+   private:
+    Instrument::Type instrument_type;
+    double min_mz;
+    double scale;
+    double offset;
+    double numerator;
+    double denominator;
+};
+
 // Applies 2D kernel smoothing. The smoothing is performed in two passes.  First
 // the raw data points are mapped into a 2D matrix by splatting them. Sparse
 // areas might result in artifacts when the data is noisy, for this reason, the
@@ -59,20 +152,110 @@ struct ResampleParams {
     double smoothing_coef_mz;
     double smoothing_coef_rt;
 };
-Grid resample(const RawData::RawData &raw_data, const ResampleParams &params);
 
-// Calculate the index i/j for the given mz/rt on the grid. This calculation is
-// performed in linear time.
-uint64_t x_index(const Grid &grid, double mz);
-uint64_t y_index(const Grid &grid, double rt);
+// The splatting and smoothing steps are split across up to max_threads threads.
+// The result is the same regardless of the number of threads used. The grid
+// data is stored as T, which can be either double or float.
+template <typename T = double>
+BasicGrid<T> resample(const RawData::RawData &raw_data,
+                      const ResampleParams &params, size_t max_threads = 1);
 
-// Calculate the mz/rt at index i/j for a given grid. The calculation is
-// performed in linear time.
-double mz_at(const Grid &grid, uint64_t i);
-double rt_at(const Grid &grid, uint64_t j);
+// Same as above, but the result is stored in a tiled grid. Only the tiles
+// within reach of the splatting and smoothing kernels of the raw data points
+// are allocated and smoothed, so the memory and time requirements depend on
+// the amount of signal instead of the size of the grid. The values are the
+// same as in the dense grid.
+template <typename T = double>
+BasicTiledGrid<T> resample_tiled(const RawData::RawData &raw_data,
+                                 const ResampleParams &params,
+                                 size_t max_threads = 1);
+
+// Retention time smoothing pass of resample. Each row of the grid data is
+// convolved with a Gaussian kernel of the given sigma, truncated at
+// rt_kernel_hw rows on each side and normalized by the sum of its weights. The
+// smoothed data is returned in the same row major order.
+template <typename T>
+std::vector<T> smooth_rt(const BasicGrid<T> &grid, double sigma_rt,
+                         uint64_t rt_kernel_hw, size_t max_threads = 1);
+
+// StreamingResampler performs the same resampling procedure as resample, but
+// consuming one scan at a time. Only a sliding band of grid rows around the
+// current retention time is kept in memory. As soon as a row can't receive
+// more contributions from the remaining scans, it is smoothed and passed to
+// the callback, so that the full grid never has to be stored. The emitted rows
+// are identical to the rows of the dense grid.
+class StreamingResampler {
+   public:
+    // Receives the index and values of each finished row of the grid, in
+    // increasing order.
+    using RowCallback =
+        std::function<void(uint64_t j, const std::vector<double> &row)>;
+
+    // The raw data is only used for its parameters and bounds, which must be
+    // known in advance. Its scans are not read.
+    StreamingResampler(const RawData::RawData &raw_data,
+                       const ResampleParams &params, RowCallback callback);
+
+    // Splat the given scan into the grid. The scans must be added in
+    // increasing retention time order, otherwise the scan is ignored and
+    // false is returned.
+    bool add_scan(const RawData::Scan &scan);
+
+    // Emit all the remaining rows. No more scans can be added afterwards.
+    void finish();
+
+    // The dimensions and bins of the resulting grid.
+    const Layout &layout() const { return grid; }
+
+   private:
+    // Normalize the splatted rows before the given row index, and emit the
+    // rows that have all their neighbours available for smoothing.
+    void complete_rows(uint64_t end);
+    void emit_rows();
+
+    Layout grid;
+    MzIndex mz_index;
+    RowCallback callback;
+
+    // Smoothing parameters. The m/z kernel weights and their sums are
+    // precalculated for each column.
+    double sigma_rt;
+    std::vector<double> sigma_mz;
+    uint64_t rt_kernel_hw;
+    uint64_t mz_kernel_hw;
+    std::vector<double> mz_kernels;
+    std::vector<double> mz_kernel_sums;
+
+    // Retention time of the last scan.
+    double last_rt;
+    bool finished;
+
+    // Splatted values and weights for the rows starting at splat_begin.
+    uint64_t splat_begin;
+    std::deque<std::vector<double>> values;
+    std::deque<std::vector<double>> weights;
+
+    // Normalized rows starting at normalized_begin, kept until they are no
+    // longer needed for smoothing.
+    uint64_t normalized_begin;
+    std::deque<std::vector<double>> normalized;
+
+    // Index of the next row to be emitted, and scratch buffers.
+    uint64_t next_row;
+    std::vector<double> weights_rt;
+    std::vector<double> weights_mz;
+    std::vector<double> smoothed_rt;
+    std::vector<double> row;
+};
+
+// Convert a tiled grid into a dense grid.
+template <typename T>
+BasicGrid<T> to_dense(const BasicTiledGrid<T> &grid);
 
 // Extract a subset from the grid based on the given constrained dimensions.
-Grid subset(Grid grid, double min_mz, double max_mz, double min_rt, double max_rt);
+template <typename T>
+BasicGrid<T> subset(BasicGrid<T> grid, double min_mz, double max_mz,
+                    double min_rt, double max_rt);
 
 }  // namespace Grid
 
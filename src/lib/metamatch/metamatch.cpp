@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <limits>
 #include <map>
 #include <sstream>
 
@@ -403,3 +404,30 @@ std::vector<MetaMatch::PeakCluster> MetaMatch::find_peak_clusters(
 
     return clusters;
 }
+
+template <typename Cluster>
+static std::vector<double> cluster_file_values(
+    const std::vector<Cluster>& clusters, std::vector<double> Cluster::*member,
+    size_t num_files) {
+    std::vector<double> matrix(clusters.size() * num_files,
+                               std::numeric_limits<double>::quiet_NaN());
+    for (size_t i = 0; i < clusters.size(); ++i) {
+        const auto& values = clusters[i].*member;
+        size_t n = std::min(values.size(), num_files);
+        std::copy(values.begin(), values.begin() + n,
+                  matrix.begin() + i * num_files);
+    }
+    return matrix;
+}
+
+std::vector<double> MetaMatch::file_values_matrix(
+    const std::vector<PeakCluster>& clusters,
+    std::vector<double> PeakCluster::*member, size_t num_files) {
+    return cluster_file_values(clusters, member, num_files);
+}
+
+std::vector<double> MetaMatch::file_values_matrix(
+    const std::vector<FeatureCluster>& clusters,
+    std::vector<double> FeatureCluster::*member, size_t num_files) {
+    return cluster_file_values(clusters, member, num_files);
+}
@@ -71,6 +71,18 @@ std::vector<FeatureCluster> find_feature_clusters(
     double keep_perc, double intensity_threshold, double n_sig_mz,
     double n_sig_rt);
 
+// Arrange a per file quantification of the clusters (e.g. PeakCluster::heights)
+// as a row major matrix with one row per cluster and num_files columns, which
+// is the layout used for the quantitative tables. The matrix always has
+// num_files columns, even if there are no clusters, and missing values are set
+// to NaN.
+std::vector<double> file_values_matrix(
+    const std::vector<PeakCluster>& clusters,
+    std::vector<double> PeakCluster::*member, size_t num_files);
+std::vector<double> file_values_matrix(
+    const std::vector<FeatureCluster>& clusters,
+    std::vector<double> FeatureCluster::*member, size_t num_files);
+
 }  // namespace MetaMatch
 
 #endif /* METAMATCH_METAMATCH_HPP */
@@ -1,73 +1,79 @@
 #include "protein_inference/protein_inference.hpp"
 
 #include <algorithm>
-#include <map>
 
 ProteinInference::Graph ProteinInference::create_graph(
     const IdentData::IdentData &ident_data) {
-    std::map<std::string, uint64_t> protein_map;
-    std::map<std::string, uint64_t> psm_map;
     ProteinInference::Graph graph;
-    // FIXME: Rework this to use the new IdentData data structures.
-    // Initialize nodes.
-    // for (size_t i = 0; i < ident_data.protein_hypotheses.size(); ++i) {
-    //     const auto &protein_hypothesis = ident_data.protein_hypotheses[i];
-    //     if (protein_map.count(protein_hypothesis.db_sequence_id) == 0) {
-    //         ProteinInference::Node node = {};
-    //         node.type = ProteinInference::PROTEIN;
-    //         node.id = protein_hypothesis.db_sequence_id;
-    //         node.num = 0;
-    //         node.nodes = {};
-    //         protein_map[protein_hypothesis.db_sequence_id] =
-    //             graph.protein_nodes.size();
-    //         graph.protein_nodes.push_back(node);
-    //     }
-    //     for (const auto &psm : protein_hypothesis.spectrum_ids) {
-    //         if (psm_map.count(psm) == 0) {
-    //             ProteinInference::Node node = {};
-    //             node.type = ProteinInference::PSM;
-    //             node.id = psm;
-    //             node.num = 0;
-    //             node.nodes = {};
-    //             psm_map[psm] = graph.psm_nodes.size();
-    //             graph.psm_nodes.push_back(node);
-    //         }
-    //     }
-    // }
-    // // Create graph by assigning edges to the adjacency list of each node.
-    // for (size_t i = 0; i < ident_data.protein_hypotheses.size(); ++i) {
-    //     const auto &protein_hypothesis = ident_data.protein_hypotheses[i];
 
-    //     // Check if protein already in the graph.
-    //     auto protein_index = protein_map.at(protein_hypothesis.db_sequence_id);
+    // Find the proteins (DBSequence) that can explain each peptide, using the
+    // indices resolved when reading the identifications. The protein nodes
+    // are created in order of appearance on the PeptideEvidence list.
+    std::vector<std::vector<uint64_t>> peptide_proteins(
+        ident_data.peptides.size());
+    std::vector<uint64_t> protein_map(ident_data.db_sequences.size(),
+                                      IdentData::NO_INDEX);
+    for (const auto &peptide_evidence : ident_data.peptide_evidence) {
+        if (peptide_evidence.peptide_index >= ident_data.peptides.size() ||
+            peptide_evidence.db_sequence_index >=
+                ident_data.db_sequences.size()) {
+            continue;
+        }
+        auto &protein_index = protein_map[peptide_evidence.db_sequence_index];
+        if (protein_index == IdentData::NO_INDEX) {
+            ProteinInference::Node node = {};
+            node.type = ProteinInference::PROTEIN;
+            const auto &db_sequence =
+                ident_data.db_sequences[peptide_evidence.db_sequence_index];
+            node.id = ident_data.ids[db_sequence.id];
+            node.num = 0;
+            node.nodes = {};
+            protein_index = graph.protein_nodes.size();
+            graph.protein_nodes.push_back(node);
+        }
+        peptide_proteins[peptide_evidence.peptide_index].push_back(
+            protein_index);
+    }
 
-    //     for (const auto &psm : protein_hypothesis.spectrum_ids) {
-    //         auto psm_index = psm_map.at(psm);
+    // Update nodes. We need to make sure that the node was not included
+    // already on the adjacency list, as the same peptide can be found in
+    // multiple locations of a protein.
+    auto ptr_in_node_list =
+        [](uint64_t target_node,
+           const std::vector<std::optional<uint64_t>> &node_list) {
+            for (const auto &node : node_list) {
+                if (node == target_node) {
+                    return true;
+                }
+            }
+            return false;
+        };
 
-    //         // Update nodes. We need to make sure that the node was not
-    //         // included already on the adjacency list.
-    //         auto ptr_in_node_list =
-    //             [](uint64_t target_node,
-    //                std::vector<std::optional<uint64_t>> &node_list) {
-    //                 for (const auto &node : node_list) {
-    //                     if (node == target_node) {
-    //                         return true;
-    //                     }
-    //                 }
-    //                 return false;
-    //             };
-    //         if (!ptr_in_node_list(psm_index,
-    //                               graph.protein_nodes[protein_index].nodes)) {
-    //             graph.protein_nodes[protein_index].nodes.push_back(psm_index);
-    //             ++graph.protein_nodes[protein_index].num;
-    //         }
-    //         if (!ptr_in_node_list(protein_index,
-    //                               graph.psm_nodes[psm_index].nodes)) {
-    //             graph.psm_nodes[psm_index].nodes.push_back(protein_index);
-    //             ++graph.psm_nodes[psm_index].num;
-    //         }
-    //     }
-    // }
+    // Create a node for each PSM that can be explained by at least one
+    // protein, assigning edges to the adjacency list of each node.
+    for (const auto &spectrum_match : ident_data.spectrum_matches) {
+        if (spectrum_match.match_index >= ident_data.peptides.size() ||
+            peptide_proteins[spectrum_match.match_index].empty()) {
+            continue;
+        }
+        uint64_t psm_index = graph.psm_nodes.size();
+        ProteinInference::Node psm_node = {};
+        psm_node.type = ProteinInference::PSM;
+        psm_node.id = ident_data.ids[spectrum_match.id];
+        psm_node.num = 0;
+        psm_node.nodes = {};
+        for (const auto &protein_index :
+             peptide_proteins[spectrum_match.match_index]) {
+            if (ptr_in_node_list(protein_index, psm_node.nodes)) {
+                continue;
+            }
+            psm_node.nodes.push_back(protein_index);
+            ++psm_node.num;
+            graph.protein_nodes[protein_index].nodes.push_back(psm_index);
+            ++graph.protein_nodes[protein_index].num;
+        }
+        graph.psm_nodes.push_back(psm_node);
+    }
     return graph;
 }
 
@@ -50,8 +50,10 @@ struct InferredProtein {
     std::string psm_id;
 };
 
-// Initializes the initial graph. The returning vector corresponds to the
-// protein nodes, which contain links to their respective PSMs.
+// Initializes the initial graph. The protein nodes correspond to the
+// DBSequences and the PSM nodes to the SpectrumMatches, linked through the
+// Peptide/PeptideEvidence indices of the given IdentData (See
+// IdentData::resolve_references).
 Graph create_graph(const IdentData::IdentData &ident_data);
 
 // Performs Occam's razor protein inference, where we select the minimum number
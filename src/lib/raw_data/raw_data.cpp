@@ -1,5 +1,9 @@
+#include <algorithm>
+#include <numeric>
+
 #include "raw_data/raw_data.hpp"
 #include "utils/search.hpp"
+#include "utils/thread_pool.hpp"
 
 double RawData::theoretical_fwhm(const RawData &raw_data, double mz) {
     double e = 0;
@@ -29,6 +33,54 @@ double RawData::fwhm_to_sigma(double fwhm) {
     return fwhm / (2 * std::sqrt(2 * std::log(2)));
 }
 
+// Find the index of the first scan with retention time greater or equal than
+// min_rt.
+static size_t first_scan(const RawData::RawData &raw_data, double min_rt) {
+    size_t min_j = Search::lower_bound(raw_data.retention_times, min_rt);
+    if (raw_data.scans[min_j].retention_time < min_rt) {
+        ++min_j;
+    }
+    return min_j;
+}
+
+// Sum or find the maximum intensity of the points of the scan within the
+// min/max_mz range. The scan must not be empty.
+static double aggregate_intensity(const RawData::Scan &scan, double min_mz,
+                                  double max_mz, Xic::Method method) {
+    size_t min_i = Search::lower_bound(scan.mz, min_mz);
+    size_t max_i = scan.num_points;
+    if (scan.mz[min_i] < min_mz) {
+        ++min_i;
+    }
+
+    double aggregated_intensity = 0;
+    switch (method) {
+        case Xic::SUM: {
+            // Sum all points in the scan.
+            for (size_t i = min_i; i < max_i; ++i) {
+                if (scan.mz[i] > max_mz) {
+                    break;
+                }
+                aggregated_intensity += scan.intensity[i];
+            }
+        } break;
+        case Xic::MAX: {
+            // Find max point in the scan.
+            for (size_t i = min_i; i < max_i; ++i) {
+                if (scan.mz[i] > max_mz) {
+                    break;
+                }
+                if (scan.intensity[i] > aggregated_intensity) {
+                    aggregated_intensity = scan.intensity[i];
+                }
+            }
+        } break;
+        default:
+            break;
+    }
+    return aggregated_intensity;
+}
+
 Xic::Xic RawData::xic(const RawData &raw_data, double min_mz, double max_mz,
                       double min_rt, double max_rt, Xic::Method method) {
     Xic::Xic result = {};
@@ -43,11 +95,8 @@ Xic::Xic RawData::xic(const RawData &raw_data, double min_mz, double max_mz,
     }
 
     // Find scan indices.
-    size_t min_j = Search::lower_bound(raw_data.retention_times, min_rt);
+    size_t min_j = first_scan(raw_data, min_rt);
     size_t max_j = scans.size();
-    if (scans[min_j].retention_time < min_rt) {
-        ++min_j;
-    }
     for (size_t j = min_j; j < max_j; ++j) {
         const auto &scan = scans[j];
         if (scan.num_points == 0) {
@@ -57,61 +106,105 @@ Xic::Xic RawData::xic(const RawData &raw_data, double min_mz, double max_mz,
             break;
         }
 
-        double internal_min_mz = min_mz;
-        double internal_max_mz = max_mz;
-        if (internal_min_mz < scan.mz[0]) {
-            internal_min_mz = scan.mz[0];
-        }
-        if (internal_max_mz > scan.mz[scan.num_points - 1]) {
-            internal_max_mz = scan.mz[scan.num_points - 1];
-        }
-        size_t min_i = Search::lower_bound(scan.mz, min_mz);
-        size_t max_i = scan.num_points;
-        if (scan.mz[min_i] < min_mz) {
-            ++min_i;
+        if (method != Xic::SUM && method != Xic::MAX) {
+            result.method = Xic::UNKNOWN;
+            return result;
         }
+        result.retention_time.push_back(scan.retention_time);
+        result.intensity.push_back(
+            aggregate_intensity(scan, min_mz, max_mz, method));
+    }
+    return result;
+}
 
-        double aggregated_intensity = 0;
-        switch (method) {
-            case Xic::SUM: {
-                // Sum all points in the scan.
-                for (size_t i = min_i; i < max_i; ++i) {
-                    if (scan.mz[i] > max_mz) {
-                        break;
-                    }
-                    aggregated_intensity += scan.intensity[i];
-                }
-            } break;
-            case Xic::MAX: {
-                // Find max point in the scan.
-                for (size_t i = min_i; i < max_i; ++i) {
-                    if (scan.mz[i] > max_mz) {
-                        break;
-                    }
-                    if (scan.intensity[i] > aggregated_intensity) {
-                        aggregated_intensity = scan.intensity[i];
-                    }
+Xic::Batch RawData::xic_batch(const RawData &raw_data,
+                              const std::vector<Xic::Window> &windows,
+                              Xic::Method method, size_t max_threads) {
+    Xic::Batch result = {};
+    result.method = method;
+    result.offsets = std::vector<uint64_t>(windows.size() + 1);
+    const auto &scans = raw_data.scans;
+    if (scans.empty()) {
+        return result;
+    }
+    if (method != Xic::SUM && method != Xic::MAX) {
+        result.method = Xic::UNKNOWN;
+        return result;
+    }
+
+    // The number of values of each Xic is the number of non empty scans in
+    // its retention time range, so the final position of every value can be
+    // calculated before extracting them.
+    std::vector<uint64_t> non_empty_scans(scans.size() + 1);
+    for (size_t j = 0; j < scans.size(); ++j) {
+        non_empty_scans[j + 1] =
+            non_empty_scans[j] + (scans[j].num_points == 0 ? 0 : 1);
+    }
+    std::vector<size_t> min_j(windows.size());
+    std::vector<size_t> max_j(windows.size());
+    for (size_t k = 0; k < windows.size(); ++k) {
+        const auto &window = windows[k];
+        min_j[k] = first_scan(raw_data, window.min_rt);
+        max_j[k] = std::upper_bound(raw_data.retention_times.begin() + min_j[k],
+                                    raw_data.retention_times.end(),
+                                    window.max_rt) -
+                   raw_data.retention_times.begin();
+        max_j[k] = std::max(min_j[k], max_j[k]);
+        result.offsets[k + 1] = result.offsets[k] + non_empty_scans[max_j[k]] -
+                                non_empty_scans[min_j[k]];
+    }
+    result.retention_time = std::vector<double>(result.offsets.back());
+    result.intensity = std::vector<double>(result.offsets.back());
+
+    // Visit the windows in retention time order, so that consecutive windows
+    // read the same scans while they are still in cache.
+    std::vector<size_t> order(windows.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return min_j[a] < min_j[b];
+    });
+    auto extract = [&](size_t begin, size_t end) {
+        for (size_t n = begin; n < end; ++n) {
+            size_t k = order[n];
+            uint64_t offset = result.offsets[k];
+            for (size_t j = min_j[k]; j < max_j[k]; ++j) {
+                const auto &scan = scans[j];
+                if (scan.num_points == 0) {
+                    continue;
                 }
-            } break;
-            default: {
-                result.method = Xic::UNKNOWN;
-                return result;
-            } break;
+                result.retention_time[offset] = scan.retention_time;
+                result.intensity[offset] =
+                    aggregate_intensity(scan, windows[k].min_mz,
+                                        windows[k].max_mz, method);
+                ++offset;
+            }
         }
+    };
 
-        result.retention_time.push_back(scan.retention_time);
-        result.intensity.push_back(aggregated_intensity);
-    }
+    // Each chunk is a contiguous range of the sorted windows.
+    ThreadPool::parallel_for(windows.size(), max_threads, extract);
     return result;
 }
 
 RawData::RawPoints RawData::raw_points(const RawData &raw_data, double min_mz,
                                        double max_mz, double min_rt,
                                        double max_rt) {
-    RawPoints raw_points = {};
+    RawPoints points = {};
+    raw_points(raw_data, min_mz, max_mz, min_rt, max_rt, points);
+    return points;
+}
+
+void RawData::raw_points(const RawData &raw_data, double min_mz,
+                         double max_mz, double min_rt, double max_rt,
+                         RawPoints &raw_points) {
+    raw_points.num_points = 0;
+    raw_points.num_scans = 0;
+    raw_points.rt.clear();
+    raw_points.mz.clear();
+    raw_points.intensity.clear();
     const auto &scans = raw_data.scans;
     if (scans.size() == 0) {
-        return raw_points;
+        return;
     }
 
     size_t min_j = Search::lower_bound(raw_data.retention_times, min_rt);
@@ -149,6 +242,79 @@ RawData::RawPoints RawData::raw_points(const RawData &raw_data, double min_mz,
             ++raw_points.num_scans;
         }
     }
+}
 
-    return raw_points;
+void RawData::filter_retention_time(RawData &raw_data, double min_rt,
+                                    double max_rt) {
+    auto &scans = raw_data.scans;
+    auto &retention_times = raw_data.retention_times;
+    size_t num_kept = 0;
+    size_t num_kept_times = 0;
+    for (size_t i = 0; i < scans.size(); ++i) {
+        // The retention times are used if available, as in the columnar scan
+        // index.
+        double retention_time = i < retention_times.size()
+                                    ? retention_times[i]
+                                    : scans[i].retention_time;
+        if (retention_time < min_rt || retention_time > max_rt) {
+            continue;
+        }
+        if (i < retention_times.size()) {
+            retention_times[num_kept_times++] = retention_times[i];
+        }
+        scans[num_kept] = std::move(scans[i]);
+        ++num_kept;
+    }
+    scans.resize(num_kept);
+    retention_times.resize(num_kept_times);
+}
+
+IdentData::IdInterner::IdInterner(std::vector<std::string> &ids)
+    : ids(ids), indices(ids.size(), Hash{this}, Equal{this}) {
+    for (size_t i = 0; i < ids.size(); ++i) {
+        indices.insert(i);
+    }
+}
+
+uint64_t IdentData::IdInterner::intern(std::string_view id) {
+    lookup = id;
+    auto it = indices.find(NO_INDEX);
+    if (it != indices.end()) {
+        return *it;
+    }
+    ids.emplace_back(id);
+    indices.insert(ids.size() - 1);
+    return ids.size() - 1;
+}
+
+void IdentData::resolve_references(IdentData &ident_data) {
+    // The elements are found by the index of their id in the pool, so no
+    // strings have to be compared.
+    size_t num_ids = ident_data.ids.size();
+    std::vector<uint64_t> db_sequence_indices(num_ids, NO_INDEX);
+    std::vector<uint64_t> peptide_indices(num_ids, NO_INDEX);
+    auto add_index = [num_ids](auto &indices, uint64_t id, uint64_t index) {
+        if (id < num_ids && indices[id] == NO_INDEX) {
+            indices[id] = index;
+        }
+    };
+    for (size_t i = 0; i < ident_data.db_sequences.size(); ++i) {
+        add_index(db_sequence_indices, ident_data.db_sequences[i].id, i);
+    }
+    for (size_t i = 0; i < ident_data.peptides.size(); ++i) {
+        add_index(peptide_indices, ident_data.peptides[i].id, i);
+    }
+    auto find_index = [num_ids](const auto &indices, uint64_t id) {
+        return id < num_ids ? indices[id] : NO_INDEX;
+    };
+    for (auto &spectrum_match : ident_data.spectrum_matches) {
+        spectrum_match.match_index =
+            find_index(peptide_indices, spectrum_match.match_id);
+    }
+    for (auto &peptide_evidence : ident_data.peptide_evidence) {
+        peptide_evidence.db_sequence_index =
+            find_index(db_sequence_indices, peptide_evidence.db_sequence_id);
+        peptide_evidence.peptide_index =
+            find_index(peptide_indices, peptide_evidence.peptide_id);
+    }
 }
@@ -4,8 +4,11 @@
 #include <cassert>
 #include <cmath>
 #include <cstdint>
+#include <limits>
 #include <string>
+#include <string_view>
 #include <tuple>
+#include <unordered_set>
 #include <vector>
 
 // The instrument in which the data was acquired.
@@ -44,6 +47,23 @@ struct Xic {
     double min_rt;
     double max_rt;
 };
+
+// Region of interest used to calculate one of the Xic of a Batch.
+struct Window {
+    double min_mz;
+    double max_mz;
+    double min_rt;
+    double max_rt;
+};
+
+// Multiple Xic stored contiguously. The retention times and intensities for
+// window i are in the range [offsets[i], offsets[i + 1]) of the data vectors.
+struct Batch {
+    std::vector<uint64_t> offsets;
+    std::vector<double> retention_time;
+    std::vector<double> intensity;
+    Method method;
+};
 }  // namespace Xic
 
 // In this namespace we have access to the data structures for working with raw
@@ -134,6 +154,14 @@ struct RawPoints {
 Xic::Xic xic(const RawData &raw_data, double min_mz, double max_mz,
              double min_rt, double max_rt, Xic::Method method);
 
+// Calculate the extracted ion chromatograms for multiple windows at once. The
+// windows are visited in retention time order, split across up to max_threads
+// threads, and the results are written directly to their final position. The
+// results are the same as calling xic for each window.
+Xic::Batch xic_batch(const RawData &raw_data,
+                     const std::vector<Xic::Window> &windows,
+                     Xic::Method method, size_t max_threads);
+
 // Calculate the theoretical FWHM of the peak for the given mz.
 double theoretical_fwhm(const RawData &raw_data, double mz);
 
@@ -143,21 +171,43 @@ double fwhm_to_sigma(double fwhm);
 // Find the raw data points within the square region defined by min/max_mz/rt.
 RawPoints raw_points(const RawData &raw_data, double min_mz, double max_mz,
                      double min_rt, double max_rt);
+
+// Same as above, but the points are stored in the given RawPoints, reusing the
+// memory of its vectors.
+void raw_points(const RawData &raw_data, double min_mz, double max_mz,
+                double min_rt, double max_rt, RawPoints &raw_points);
+
+// Remove the scans with a retention time outside [min_rt, max_rt], together
+// with their entries in retention_times. The remaining fields describe the
+// entire run, as when reading a window from a columnar file.
+void filter_retention_time(RawData &raw_data, double min_rt, double max_rt);
 }  // namespace RawData
 
 // In this namespace we have access to the data structures for working with
 // identification data.
 namespace IdentData {
+// Index used for references between identification elements that could not be
+// resolved.
+constexpr uint64_t NO_INDEX = std::numeric_limits<uint64_t>::max();
+
+// The string identifiers of the elements below are stored only once, in the
+// IdentData::ids pool, and each element holds the index of its identifier in
+// the pool instead. This avoids keeping a copy of every id and reference for
+// each of the millions of PSM a file can contain.
+
 // A SpectrumMatch represents a unique identification. In a proteomics
 // experiment this could be considered a Peptide Spectrum Match (PSM). Multiple
 // PSM can be assigned to a single MS/MS event.
 struct SpectrumMatch {
-    std::string id;
+    // Index of the id in IdentData::ids.
+    uint64_t id;
     // If the matching passes the threshold set up by the search engine.
     bool pass_threshold;
-    // The corresponding ID for the matched molecule. In a Proteomics
-    // experiment, the match_id corresponds to a Peptide.id.
-    std::string match_id;
+    // Index in IdentData::ids of the ID of the matched molecule. In a
+    // Proteomics experiment, the match_id corresponds to a Peptide.id.
+    uint64_t match_id;
+    // The index of match_id in IdentData::peptides or NO_INDEX.
+    uint64_t match_index;
     // The charge state assigned to this match.
     uint8_t charge_state;
     // The theoretical mass-to-charge ratio as calculated from the matched
@@ -184,7 +234,8 @@ struct SpectrumMatch {
 
 // A database sequence used for identification.
 struct DBSequence {
-    std::string id;
+    // Index of the id in IdentData::ids.
+    uint64_t id;
     // A unique accession for this sequence.
     std::string accession;
     // The database reference used as a source for this sequence.
@@ -211,7 +262,8 @@ struct PeptideModification {
 
 // A peptide that can be associated with an entry from a database sequence.
 struct Peptide {
-    std::string id;
+    // Index of the id in IdentData::ids.
+    uint64_t id;
     // The amino acid sequence of this peptide without any  modifications.
     std::string sequence;
     // The modifications associated with this peptide, if any.
@@ -223,11 +275,16 @@ struct Peptide {
 // sequences, or different locations within a sequence. The combination of
 // db_sequence_id and peptide_id must be unique.
 struct PeptideEvidence {
-    std::string id;
-    // The unique identifier of DBSequence::id.
-    std::string db_sequence_id;
-    // The unique identifier of Peptide::id.
-    std::string peptide_id;
+    // Index of the id in IdentData::ids.
+    uint64_t id;
+    // The indices in IdentData::ids of the DBSequence::id and Peptide::id
+    // referenced by this evidence.
+    uint64_t db_sequence_id;
+    uint64_t peptide_id;
+    // The indices of db_sequence_id in IdentData::db_sequences and of
+    // peptide_id in IdentData::peptides or NO_INDEX.
+    uint64_t db_sequence_index;
+    uint64_t peptide_index;
     // If this match was associated with a decoy sequence.
     bool decoy;
 };
@@ -245,11 +302,57 @@ struct ProteinHypothesis {
 // Contains all data structures that model a proteomics identification set for
 // one sample.
 struct IdentData {
+    // Pool with the distinct ids of all elements.
+    std::vector<std::string> ids;
     std::vector<DBSequence> db_sequences;
     std::vector<Peptide> peptides;
     std::vector<PeptideEvidence> peptide_evidence;
     std::vector<SpectrumMatch> spectrum_matches;
 };
+
+// Adds ids to the pool of an IdentData, storing each distinct id only once.
+// The interner keeps a reference to the pool, which must outlive it.
+class IdInterner {
+    // The set contains indices into the pool, hashed and compared by the id
+    // they point to, so that it stays valid when the pool grows. The NO_INDEX
+    // key stands for the id being looked up, which is only copied into the
+    // pool if it is not found.
+    struct Hash {
+        const IdInterner *interner;
+        size_t operator()(uint64_t index) const {
+            return std::hash<std::string_view>()(interner->id_at(index));
+        }
+    };
+    struct Equal {
+        const IdInterner *interner;
+        bool operator()(uint64_t a, uint64_t b) const {
+            return interner->id_at(a) == interner->id_at(b);
+        }
+    };
+    std::string_view id_at(uint64_t index) const {
+        return index == NO_INDEX ? lookup : ids[index];
+    }
+
+    std::vector<std::string> &ids;
+    std::string_view lookup;
+    std::unordered_set<uint64_t, Hash, Equal> indices;
+
+   public:
+    // The ids already in the pool are reused by intern.
+    explicit IdInterner(std::vector<std::string> &ids);
+
+    // The set functors point to this interner, so it can't be copied.
+    IdInterner(const IdInterner &) = delete;
+    IdInterner &operator=(const IdInterner &) = delete;
+
+    // Returns the index of the given id in the pool, adding it if needed.
+    uint64_t intern(std::string_view id);
+};
+
+// Resolve the id references between the elements of the given IdentData into
+// their indices (SpectrumMatch::match_index, PeptideEvidence::db_sequence_index
+// and PeptideEvidence::peptide_index).
+void resolve_references(IdentData &ident_data);
 }  // namespace IdentData
 
 #endif /* RAWDATA_RAWDATA_HPP */
@@ -0,0 +1,396 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "raw_data/raw_data_columnar.hpp"
+#include "utils/base64.hpp"
+#include "utils/compression.hpp"
+#include "utils/serialization.hpp"
+
+// Size in bytes of the fixed size sections of the file.
+static constexpr size_t HEADER_SIZE = 8 + 4 + 1 + 8 * 8 + 8;
+static constexpr size_t SCAN_RECORD_SIZE =
+    8 * 7 + 1 + 8 * 2 + 8 + 1 + 8 * 2 + 1 + 8;
+static constexpr size_t BLOCK_RECORD_SIZE = 8 * 3 + 1;
+static constexpr size_t FOOTER_SIZE = 8 * 2;
+
+// Maximum compression factor of the deflate format.
+static constexpr uint64_t MAX_DEFLATE_RATIO = 1032;
+
+static bool host_is_little_endian() {
+    uint16_t value = 1;
+    uint8_t first_byte = 0;
+    std::memcpy(&first_byte, &value, 1);
+    return first_byte == 1;
+}
+
+// Copy the values into the output buffer in little endian byte order.
+static void store_doubles(uint8_t *output, const double *values, size_t n) {
+    // The values of empty scans can be a null pointer, which memcpy doesn't
+    // accept even if nothing is copied.
+    if (n == 0) {
+        return;
+    }
+    if (host_is_little_endian()) {
+        std::memcpy(output, values, n * sizeof(double));
+        return;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t bits = 0;
+        std::memcpy(&bits, &values[i], sizeof(double));
+        for (size_t k = 0; k < 8; ++k) {
+            output[i * 8 + k] = static_cast<uint8_t>(bits >> (8 * k));
+        }
+    }
+}
+
+// Location of a block of columns in the file.
+struct Block {
+    uint64_t offset;
+    uint64_t stored_size;
+    uint64_t num_points;
+    bool compressed;
+};
+
+bool RawData::Columnar::write_raw_data(std::ostream &stream,
+                                       const RawData &raw_data,
+                                       bool compress) {
+    uint64_t num_scans = raw_data.scans.size();
+
+    // The retention time of each scan in the index. The reader finds the scans
+    // of a retention time window with a binary search, so they must be sorted.
+    auto scan_rt = [&](size_t i) {
+        return i < raw_data.retention_times.size()
+                   ? raw_data.retention_times[i]
+                   : raw_data.scans[i].retention_time;
+    };
+    for (size_t i = 1; i < num_scans; ++i) {
+        if (!(scan_rt(i - 1) <= scan_rt(i))) {
+            return false;
+        }
+    }
+
+    // Header.
+    stream.write(MAGIC, sizeof(MAGIC));
+    Serialization::write_uint32(stream, VERSION);
+    Serialization::write_uint8(stream, raw_data.instrument_type);
+    Serialization::write_double(stream, raw_data.min_mz);
+    Serialization::write_double(stream, raw_data.max_mz);
+    Serialization::write_double(stream, raw_data.min_rt);
+    Serialization::write_double(stream, raw_data.max_rt);
+    Serialization::write_double(stream, raw_data.resolution_ms1);
+    Serialization::write_double(stream, raw_data.resolution_msn);
+    Serialization::write_double(stream, raw_data.reference_mz);
+    Serialization::write_double(stream, raw_data.fwhm_rt);
+    Serialization::write_uint64(stream, num_scans);
+
+    // Number of points stored for each scan.
+    auto scan_size = [&](size_t i) {
+        const auto &scan = raw_data.scans[i];
+        return std::min({static_cast<size_t>(scan.num_points), scan.mz.size(),
+                         scan.intensity.size()});
+    };
+
+    // Blocks. Consecutive scans are grouped until the block reaches
+    // BLOCK_POINTS.
+    std::vector<Block> blocks;
+    std::vector<uint64_t> scan_blocks(num_scans);
+    std::vector<uint64_t> scan_offsets(num_scans);
+    std::vector<uint8_t> columns;
+    std::vector<uint8_t> compressed_columns;
+    uint64_t position = HEADER_SIZE;
+    size_t first_scan = 0;
+    while (first_scan < num_scans) {
+        size_t last_scan = first_scan;
+        uint64_t num_points = 0;
+        while (last_scan < num_scans &&
+               (last_scan == first_scan ||
+                num_points + scan_size(last_scan) <= BLOCK_POINTS)) {
+            scan_blocks[last_scan] = blocks.size();
+            scan_offsets[last_scan] = num_points;
+            num_points += scan_size(last_scan);
+            ++last_scan;
+        }
+
+        // The m/z values of all scans are followed by their intensities.
+        columns.resize(num_points * 2 * sizeof(double));
+        for (size_t i = first_scan; i < last_scan; ++i) {
+            const auto &scan = raw_data.scans[i];
+            store_doubles(&columns[scan_offsets[i] * sizeof(double)],
+                          scan.mz.data(), scan_size(i));
+            store_doubles(
+                &columns[(num_points + scan_offsets[i]) * sizeof(double)],
+                scan.intensity.data(), scan_size(i));
+        }
+
+        // Blocks that don't benefit from compression are stored as is.
+        Block block = {position, columns.size(), num_points, false};
+        const auto *data = &columns;
+        if (compress &&
+            Compression::deflate(columns.data(), columns.size(),
+                                 compressed_columns) == Z_OK &&
+            compressed_columns.size() < columns.size()) {
+            block.stored_size = compressed_columns.size();
+            block.compressed = true;
+            data = &compressed_columns;
+        }
+        stream.write(reinterpret_cast<const char *>(data->data()),
+                     data->size());
+        position += block.stored_size;
+        blocks.push_back(block);
+        first_scan = last_scan;
+    }
+
+    // Scan index.
+    uint64_t scan_index_offset = position;
+    for (size_t i = 0; i < num_scans; ++i) {
+        const auto &scan = raw_data.scans[i];
+        const auto &precursor_info = scan.precursor_information;
+        Serialization::write_double(stream, scan_rt(i));
+        Serialization::write_double(stream, scan.retention_time);
+        Serialization::write_uint64(stream, scan.scan_number);
+        Serialization::write_uint64(stream, scan.ms_level);
+        Serialization::write_uint64(stream, scan_size(i));
+        Serialization::write_uint64(stream, scan_blocks[i]);
+        Serialization::write_uint64(stream, scan_offsets[i]);
+        Serialization::write_uint8(stream, scan.polarity);
+        Serialization::write_double(stream, scan.max_intensity);
+        Serialization::write_double(stream, scan.total_intensity);
+        Serialization::write_uint64(stream, precursor_info.scan_number);
+        Serialization::write_uint8(stream, precursor_info.charge);
+        Serialization::write_double(stream, precursor_info.mz);
+        Serialization::write_double(stream, precursor_info.intensity);
+        Serialization::write_uint8(stream, precursor_info.activation_method);
+        Serialization::write_double(stream, precursor_info.window_wideness);
+    }
+
+    // Block index.
+    uint64_t block_index_offset =
+        scan_index_offset + num_scans * SCAN_RECORD_SIZE;
+    for (const auto &block : blocks) {
+        Serialization::write_uint64(stream, block.offset);
+        Serialization::write_uint64(stream, block.stored_size);
+        Serialization::write_uint64(stream, block.num_points);
+        Serialization::write_bool(stream, block.compressed);
+    }
+
+    // Footer.
+    Serialization::write_uint64(stream, scan_index_offset);
+    Serialization::write_uint64(stream, block_index_offset);
+    return stream.good();
+}
+
+// Reads little endian values from a memory buffer. Reading past the end of
+// the buffer returns zeros and sets good to false.
+struct BufferReader {
+    std::string_view buffer;
+    size_t position;
+    bool good;
+
+    uint64_t read_uint(size_t num_bytes) {
+        if (position > buffer.size() || buffer.size() - position < num_bytes) {
+            good = false;
+            return 0;
+        }
+        uint64_t value = 0;
+        for (size_t k = 0; k < num_bytes; ++k) {
+            value |= static_cast<uint64_t>(
+                         static_cast<uint8_t>(buffer[position + k]))
+                     << (8 * k);
+        }
+        position += num_bytes;
+        return value;
+    }
+    uint8_t read_uint8() { return static_cast<uint8_t>(read_uint(1)); }
+    uint32_t read_uint32() { return static_cast<uint32_t>(read_uint(4)); }
+    uint64_t read_uint64() { return read_uint(8); }
+    double read_double() {
+        uint64_t bits = read_uint(8);
+        double value = 0;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+bool RawData::Columnar::is_columnar(std::string_view buffer) {
+    return buffer.size() >= sizeof(MAGIC) &&
+           buffer.compare(0, sizeof(MAGIC),
+                          std::string_view(MAGIC, sizeof(MAGIC))) == 0;
+}
+
+std::optional<RawData::RawData> RawData::Columnar::read_raw_data(
+    std::string_view buffer, double min_rt, double max_rt) {
+    if (!is_columnar(buffer) || buffer.size() < HEADER_SIZE + FOOTER_SIZE) {
+        return std::nullopt;
+    }
+
+    // Header.
+    auto reader = BufferReader{buffer, sizeof(MAGIC), true};
+    if (reader.read_uint32() != VERSION) {
+        return std::nullopt;
+    }
+    RawData raw_data = {};
+    raw_data.instrument_type =
+        static_cast<Instrument::Type>(reader.read_uint8());
+    raw_data.min_mz = reader.read_double();
+    raw_data.max_mz = reader.read_double();
+    raw_data.min_rt = reader.read_double();
+    raw_data.max_rt = reader.read_double();
+    raw_data.resolution_ms1 = reader.read_double();
+    raw_data.resolution_msn = reader.read_double();
+    raw_data.reference_mz = reader.read_double();
+    raw_data.fwhm_rt = reader.read_double();
+    uint64_t num_scans = reader.read_uint64();
+
+    // Footer.
+    reader.position = buffer.size() - FOOTER_SIZE;
+    uint64_t scan_index_offset = reader.read_uint64();
+    uint64_t block_index_offset = reader.read_uint64();
+    size_t index_end = buffer.size() - FOOTER_SIZE;
+    if (scan_index_offset > block_index_offset ||
+        block_index_offset > index_end ||
+        (block_index_offset - scan_index_offset) / SCAN_RECORD_SIZE !=
+            num_scans ||
+        (index_end - block_index_offset) % BLOCK_RECORD_SIZE != 0) {
+        return std::nullopt;
+    }
+    uint64_t num_blocks = (index_end - block_index_offset) / BLOCK_RECORD_SIZE;
+
+    // Find the first scan in range with a binary search over the index, the
+    // retention time is the first field of each record.
+    auto retention_time = [&](size_t i) {
+        auto record_reader = BufferReader{
+            buffer, scan_index_offset + i * SCAN_RECORD_SIZE, true};
+        return record_reader.read_double();
+    };
+    size_t first_scan = 0;
+    size_t last_scan = num_scans;
+    while (first_scan < last_scan) {
+        size_t mid = first_scan + (last_scan - first_scan) / 2;
+        if (retention_time(mid) < min_rt) {
+            first_scan = mid + 1;
+        } else {
+            last_scan = mid;
+        }
+    }
+
+    // Read the scans until we are out of the retention time range,
+    // decompressing each block once.
+    Compression::Inflator inflator;
+    std::vector<uint8_t> decompressed;
+    uint64_t current_block = std::numeric_limits<uint64_t>::max();
+    const uint8_t *columns = nullptr;
+    uint64_t block_points = 0;
+    reader.position = scan_index_offset + first_scan * SCAN_RECORD_SIZE;
+    for (size_t i = first_scan; i < num_scans; ++i) {
+        double scan_rt = reader.read_double();
+        if (scan_rt > max_rt) {
+            break;
+        }
+        Scan scan = {};
+        auto &precursor_info = scan.precursor_information;
+        scan.retention_time = reader.read_double();
+        scan.scan_number = reader.read_uint64();
+        scan.ms_level = reader.read_uint64();
+        scan.num_points = reader.read_uint64();
+        uint64_t block_index = reader.read_uint64();
+        uint64_t block_offset = reader.read_uint64();
+        scan.polarity = static_cast<Polarity::Type>(reader.read_uint8());
+        scan.max_intensity = reader.read_double();
+        scan.total_intensity = reader.read_double();
+        precursor_info.scan_number = reader.read_uint64();
+        precursor_info.charge = reader.read_uint8();
+        precursor_info.mz = reader.read_double();
+        precursor_info.intensity = reader.read_double();
+        precursor_info.activation_method =
+            static_cast<ActivationMethod::Type>(reader.read_uint8());
+        precursor_info.window_wideness = reader.read_double();
+        if (!reader.good || block_index >= num_blocks) {
+            return std::nullopt;
+        }
+
+        // Load the block containing this scan.
+        if (block_index != current_block) {
+            auto block_reader = BufferReader{
+                buffer, block_index_offset + block_index * BLOCK_RECORD_SIZE,
+                true};
+            uint64_t offset = block_reader.read_uint64();
+            uint64_t stored_size = block_reader.read_uint64();
+            block_points = block_reader.read_uint64();
+            bool compressed = block_reader.read_uint8() != 0;
+            uint64_t columns_size = block_points * 2 * sizeof(double);
+            if (offset > scan_index_offset ||
+                stored_size > scan_index_offset - offset ||
+                block_points > columns_size) {
+                return std::nullopt;
+            }
+
+            // The decompressed columns are allocated before inflating, so the
+            // number of points is checked first. Blocks have at most
+            // BLOCK_POINTS points unless they contain a single bigger scan,
+            // and deflate can't compress more than MAX_DEFLATE_RATIO times.
+            if (block_points > std::max(BLOCK_POINTS, scan.num_points) ||
+                (compressed &&
+                 columns_size / MAX_DEFLATE_RATIO > stored_size)) {
+                return std::nullopt;
+            }
+            const auto *data =
+                reinterpret_cast<const uint8_t *>(buffer.data() + offset);
+            if (compressed) {
+                if (inflator.inflate(data, stored_size, decompressed,
+                                     columns_size) != Z_OK ||
+                    decompressed.size() != columns_size) {
+                    return std::nullopt;
+                }
+                data = decompressed.data();
+            } else if (stored_size != columns_size) {
+                return std::nullopt;
+            }
+            columns = data;
+            current_block = block_index;
+        }
+        if (block_offset > block_points ||
+            scan.num_points > block_points - block_offset) {
+            return std::nullopt;
+        }
+        size_t num_bytes = scan.num_points * sizeof(double);
+        Base64::interpret_values(columns + block_offset * sizeof(double),
+                                 num_bytes, 64, true, scan.mz);
+        Base64::interpret_values(
+            columns + (block_points + block_offset) * sizeof(double),
+            num_bytes, 64, true, scan.intensity);
+        raw_data.scans.push_back(std::move(scan));
+        raw_data.retention_times.push_back(scan_rt);
+    }
+    return raw_data;
+}
+
+std::optional<RawData::RawData> RawData::Columnar::read_raw_data(
+    std::string_view buffer) {
+    return read_raw_data(buffer, -std::numeric_limits<double>::infinity(),
+                         std::numeric_limits<double>::infinity());
+}
+
+std::optional<RawData::RawPoints> RawData::Columnar::raw_points(
+    std::string_view buffer, double min_mz, double max_mz, double min_rt,
+    double max_rt) {
+    auto raw_data = read_raw_data(buffer, min_rt, max_rt);
+    if (!raw_data) {
+        return std::nullopt;
+    }
+    return ::RawData::raw_points(raw_data.value(), min_mz, max_mz, min_rt,
+                                 max_rt);
+}
+
+std::optional<Xic::Xic> RawData::Columnar::xic(std::string_view buffer,
+                                               double min_mz, double max_mz,
+                                               double min_rt, double max_rt,
+                                               Xic::Method method) {
+    auto raw_data = read_raw_data(buffer, min_rt, max_rt);
+    if (!raw_data) {
+        return std::nullopt;
+    }
+    return ::RawData::xic(raw_data.value(), min_mz, max_mz, min_rt, max_rt,
+                          method);
+}
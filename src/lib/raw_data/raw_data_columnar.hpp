@@ -0,0 +1,65 @@
+#ifndef RAWDATA_RAWDATACOLUMNAR_HPP
+#define RAWDATA_RAWDATACOLUMNAR_HPP
+
+#include <iostream>
+#include <optional>
+#include <string_view>
+
+#include "raw_data/raw_data.hpp"
+
+// This namespace contains a versioned binary file format for RawData::RawData
+// meant to be read from memory mapped files (See MappedFile::File). The file is
+// laid out as follows:
+//
+//     | Header | Block 0 | ... | Block N | Scan index | Block index | Footer |
+//
+// Each block stores the m/z and intensity values of a group of consecutive
+// scans as two contiguous columns, and is compressed independently. The scan
+// index holds a fixed size record with the retention time, metadata and
+// location of each scan, so that only the blocks overlapping a retention time
+// window have to be decompressed. The footer contains the offsets of both
+// indexes, which allows writing the file in a single pass. All values are
+// stored in little endian byte order.
+namespace RawData::Columnar {
+
+// The header starts with these bytes, followed by the format version.
+static constexpr char MAGIC[8] = {'P', 'A', 'S', 'T', 'A', 'Q', 'R', 'D'};
+static constexpr uint32_t VERSION = 1;
+
+// Target number of points per block. Scans are never split between blocks, so
+// a block can be bigger if a single scan contains more points.
+static constexpr uint64_t BLOCK_POINTS = 65536;
+
+// Write the raw data to the stream in the columnar format. The stream must be
+// opened in binary mode. If compress is true the blocks are compressed with
+// zlib. The scans must be sorted by retention time, otherwise nothing is
+// written and false is returned.
+bool write_raw_data(std::ostream &stream, const RawData &raw_data,
+                    bool compress = true);
+
+// Check if the buffer starts with a columnar raw data header.
+bool is_columnar(std::string_view buffer);
+
+// Read the scans with retention time within [min_rt, max_rt] from a buffer
+// containing a columnar raw data file. Only the blocks that contain these
+// scans are decompressed. The remaining fields of the RawData (min/max m/z,
+// rt, resolution...) describe the entire file. Returns std::nullopt if the
+// buffer doesn't contain a valid file.
+std::optional<RawData> read_raw_data(std::string_view buffer, double min_rt,
+                                     double max_rt);
+
+// Same as above, but all the scans are read.
+std::optional<RawData> read_raw_data(std::string_view buffer);
+
+// Same as RawData::raw_points and RawData::xic, but only the scans in the
+// retention time range are read from the buffer.
+std::optional<RawPoints> raw_points(std::string_view buffer, double min_mz,
+                                    double max_mz, double min_rt,
+                                    double max_rt);
+std::optional<Xic::Xic> xic(std::string_view buffer, double min_mz,
+                            double max_mz, double min_rt, double max_rt,
+                            Xic::Method method);
+
+}  // namespace RawData::Columnar
+
+#endif /* RAWDATA_RAWDATACOLUMNAR_HPP */
@@ -106,11 +106,28 @@ bool RawData::Serialize::write_raw_data(std::ostream &stream,
     return stream.good();
 }
 
+// Ids are stored as strings, so that the file doesn't depend on the layout of
+// the pool.
+static bool read_id(std::istream &stream, uint64_t *id,
+                    IdentData::IdInterner &interner) {
+    std::string value;
+    Serialization::read_string(stream, &value);
+    *id = interner.intern(value);
+    return stream.good();
+}
+
+static bool write_id(std::ostream &stream, uint64_t id,
+                     const std::vector<std::string> &ids) {
+    Serialization::write_string(stream, id < ids.size() ? ids[id] : "");
+    return stream.good();
+}
+
 bool IdentData::Serialize::read_spectrum_match(std::istream &stream,
-                                               SpectrumMatch *spectrum_match) {
-    Serialization::read_string(stream, &spectrum_match->id);
+                                               SpectrumMatch *spectrum_match,
+                                               IdInterner &interner) {
+    read_id(stream, &spectrum_match->id, interner);
     Serialization::read_bool(stream, &spectrum_match->pass_threshold);
-    Serialization::read_string(stream, &spectrum_match->match_id);
+    read_id(stream, &spectrum_match->match_id, interner);
     Serialization::read_uint8(stream, &spectrum_match->charge_state);
     Serialization::read_double(stream, &spectrum_match->theoretical_mz);
     Serialization::read_double(stream, &spectrum_match->experimental_mz);
@@ -120,10 +137,11 @@ bool IdentData::Serialize::read_spectrum_match(std::istream &stream,
 }
 
 bool IdentData::Serialize::write_spectrum_match(
-    std::ostream &stream, const SpectrumMatch &spectrum_match) {
-    Serialization::write_string(stream, spectrum_match.id);
+    std::ostream &stream, const SpectrumMatch &spectrum_match,
+    const std::vector<std::string> &ids) {
+    write_id(stream, spectrum_match.id, ids);
     Serialization::write_bool(stream, spectrum_match.pass_threshold);
-    Serialization::write_string(stream, spectrum_match.match_id);
+    write_id(stream, spectrum_match.match_id, ids);
     Serialization::write_uint8(stream, spectrum_match.charge_state);
     Serialization::write_double(stream, spectrum_match.theoretical_mz);
     Serialization::write_double(stream, spectrum_match.experimental_mz);
@@ -133,17 +151,19 @@ bool IdentData::Serialize::write_spectrum_match(
 }
 
 bool IdentData::Serialize::read_db_sequence(std::istream &stream,
-                                            DBSequence *db_sequence) {
-    Serialization::read_string(stream, &db_sequence->id);
+                                            DBSequence *db_sequence,
+                                            IdInterner &interner) {
+    read_id(stream, &db_sequence->id, interner);
     Serialization::read_string(stream, &db_sequence->accession);
     Serialization::read_string(stream, &db_sequence->db_reference);
     Serialization::read_string(stream, &db_sequence->description);
     return stream.good();
 }
 
-bool IdentData::Serialize::write_db_sequence(std::ostream &stream,
-                                             const DBSequence &db_sequence) {
-    Serialization::write_string(stream, db_sequence.id);
+bool IdentData::Serialize::write_db_sequence(
+    std::ostream &stream, const DBSequence &db_sequence,
+    const std::vector<std::string> &ids) {
+    write_id(stream, db_sequence.id, ids);
     Serialization::write_string(stream, db_sequence.accession);
     Serialization::write_string(stream, db_sequence.db_reference);
     Serialization::write_string(stream, db_sequence.description);
@@ -173,8 +193,9 @@ bool IdentData::Serialize::write_peptide_mod(
 }
 
 bool IdentData::Serialize::read_peptide(std::istream &stream,
-                                        Peptide *peptide) {
-    Serialization::read_string(stream, &peptide->id);
+                                        Peptide *peptide,
+                                        IdInterner &interner) {
+    read_id(stream, &peptide->id, interner);
     Serialization::read_string(stream, &peptide->sequence);
     Serialization::read_vector<PeptideModification>(
         stream, &peptide->modifications, read_peptide_mod);
@@ -182,8 +203,9 @@ bool IdentData::Serialize::read_peptide(std::istream &stream,
 }
 
 bool IdentData::Serialize::write_peptide(std::ostream &stream,
-                                         const Peptide &peptide) {
-    Serialization::write_string(stream, peptide.id);
+                                         const Peptide &peptide,
+                                         const std::vector<std::string> &ids) {
+    write_id(stream, peptide.id, ids);
     Serialization::write_string(stream, peptide.sequence);
     Serialization::write_vector<PeptideModification>(
         stream, peptide.modifications, write_peptide_mod);
@@ -191,45 +213,80 @@ bool IdentData::Serialize::write_peptide(std::ostream &stream,
 }
 
 bool IdentData::Serialize::read_peptide_evidence(
-    std::istream &stream, PeptideEvidence *peptide_evidence) {
-    Serialization::read_string(stream, &peptide_evidence->id);
-    Serialization::read_string(stream, &peptide_evidence->db_sequence_id);
-    Serialization::read_string(stream, &peptide_evidence->peptide_id);
+    std::istream &stream, PeptideEvidence *peptide_evidence,
+    IdInterner &interner) {
+    read_id(stream, &peptide_evidence->id, interner);
+    read_id(stream, &peptide_evidence->db_sequence_id, interner);
+    read_id(stream, &peptide_evidence->peptide_id, interner);
     Serialization::read_bool(stream, &peptide_evidence->decoy);
     return stream.good();
 }
 
 bool IdentData::Serialize::write_peptide_evidence(
-    std::ostream &stream, const PeptideEvidence &peptide_evidence) {
-    Serialization::write_string(stream, peptide_evidence.id);
-    Serialization::write_string(stream, peptide_evidence.db_sequence_id);
-    Serialization::write_string(stream, peptide_evidence.peptide_id);
+    std::ostream &stream, const PeptideEvidence &peptide_evidence,
+    const std::vector<std::string> &ids) {
+    write_id(stream, peptide_evidence.id, ids);
+    write_id(stream, peptide_evidence.db_sequence_id, ids);
+    write_id(stream, peptide_evidence.peptide_id, ids);
     Serialization::write_bool(stream, peptide_evidence.decoy);
     return stream.good();
 }
 
+// The elements are serialized with the same layout as
+// Serialization::read_vector and Serialization::write_vector, passing the pool
+// of ids to each element.
+template <typename T>
+static bool read_elements(
+    std::istream &stream, std::vector<T> *elements,
+    bool(f)(std::istream &, T *, IdentData::IdInterner &),
+    IdentData::IdInterner &interner) {
+    uint64_t num_elements = 0;
+    Serialization::read_uint64(stream, &num_elements);
+    *elements = std::vector<T>(num_elements);
+    for (size_t i = 0; i < num_elements; ++i) {
+        f(stream, &(*elements)[i], interner);
+    }
+    return stream.good();
+}
+
+template <typename T>
+static bool write_elements(
+    std::ostream &stream, const std::vector<T> &elements,
+    bool(f)(std::ostream &, const T &, const std::vector<std::string> &),
+    const std::vector<std::string> &ids) {
+    Serialization::write_uint64(stream, elements.size());
+    for (const auto &element : elements) {
+        f(stream, element, ids);
+    }
+    return stream.good();
+}
+
 bool IdentData::Serialize::read_ident_data(std::istream &stream,
                                            IdentData *ident_data) {
-    Serialization::read_vector<DBSequence>(stream, &ident_data->db_sequences,
-                                           read_db_sequence);
-    Serialization::read_vector<Peptide>(stream, &ident_data->peptides,
-                                        read_peptide);
-    Serialization::read_vector<SpectrumMatch>(
-        stream, &ident_data->spectrum_matches, read_spectrum_match);
-    Serialization::read_vector<PeptideEvidence>(
-        stream, &ident_data->peptide_evidence, read_peptide_evidence);
+    ident_data->ids.clear();
+    IdInterner interner(ident_data->ids);
+    read_elements<DBSequence>(stream, &ident_data->db_sequences,
+                              read_db_sequence, interner);
+    read_elements<Peptide>(stream, &ident_data->peptides, read_peptide,
+                           interner);
+    read_elements<SpectrumMatch>(stream, &ident_data->spectrum_matches,
+                                 read_spectrum_match, interner);
+    read_elements<PeptideEvidence>(stream, &ident_data->peptide_evidence,
+                                   read_peptide_evidence, interner);
+    // The indices are not stored, as they can be derived from the ids.
+    resolve_references(*ident_data);
     return stream.good();
 }
 
 bool IdentData::Serialize::write_ident_data(std::ostream &stream,
                                             const IdentData &ident_data) {
-    Serialization::write_vector<DBSequence>(stream, ident_data.db_sequences,
-                                            write_db_sequence);
-    Serialization::write_vector<Peptide>(stream, ident_data.peptides,
-                                         write_peptide);
-    Serialization::write_vector<SpectrumMatch>(
-        stream, ident_data.spectrum_matches, write_spectrum_match);
-    Serialization::write_vector<PeptideEvidence>(
-        stream, ident_data.peptide_evidence, write_peptide_evidence);
+    write_elements<DBSequence>(stream, ident_data.db_sequences,
+                               write_db_sequence, ident_data.ids);
+    write_elements<Peptide>(stream, ident_data.peptides, write_peptide,
+                            ident_data.ids);
+    write_elements<SpectrumMatch>(stream, ident_data.spectrum_matches,
+                                  write_spectrum_match, ident_data.ids);
+    write_elements<PeptideEvidence>(stream, ident_data.peptide_evidence,
+                                    write_peptide_evidence, ident_data.ids);
     return stream.good();
 }
@@ -29,14 +29,22 @@ bool write_raw_data(std::ostream &stream, const RawData &raw_data);
 // structures into a binary stream.
 namespace IdentData::Serialize {
 
+// The ids of the elements are stored as strings, so the functions below take
+// the pool of the IdentData they belong to. Ids are added to the pool of the
+// given interner when reading.
+
 // IdentData::SpectrumMatch
-bool read_spectrum_match(std::istream &stream, SpectrumMatch *spectrum_match);
+bool read_spectrum_match(std::istream &stream, SpectrumMatch *spectrum_match,
+                         IdInterner &interner);
 bool write_spectrum_match(std::ostream &stream,
-                          const SpectrumMatch &spectrum_match);
+                          const SpectrumMatch &spectrum_match,
+                          const std::vector<std::string> &ids);
 
 // IdentData::DBSequence
-bool read_db_sequence(std::istream &stream, DBSequence *db_sequence);
-bool write_db_sequence(std::ostream &stream, const DBSequence &db_sequence);
+bool read_db_sequence(std::istream &stream, DBSequence *db_sequence,
+                      IdInterner &interner);
+bool write_db_sequence(std::ostream &stream, const DBSequence &db_sequence,
+                       const std::vector<std::string> &ids);
 
 // IdentData::PeptideModification
 bool read_peptide_mod(std::istream &stream, PeptideModification *peptide_mod);
@@ -44,14 +52,18 @@ bool write_peptide_mod(std::ostream &stream,
                        const PeptideModification &peptide_mod);
 
 // IdentData::Peptide
-bool read_peptide(std::istream &stream, Peptide *peptide);
-bool write_peptide(std::ostream &stream, const Peptide &peptide);
+bool read_peptide(std::istream &stream, Peptide *peptide,
+                  IdInterner &interner);
+bool write_peptide(std::ostream &stream, const Peptide &peptide,
+                   const std::vector<std::string> &ids);
 
 // IdentData::PeptideEvidence
 bool read_peptide_evidence(std::istream &stream,
-                           PeptideEvidence *peptide_evidence);
+                           PeptideEvidence *peptide_evidence,
+                           IdInterner &interner);
 bool write_peptide_evidence(std::ostream &stream,
-                            const PeptideEvidence &peptide_evidence);
+                            const PeptideEvidence &peptide_evidence,
+                            const std::vector<std::string> &ids);
 
 // IdentData::IdentData
 bool read_ident_data(std::istream &stream, IdentData *ident_data);
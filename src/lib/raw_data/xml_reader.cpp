@@ -1,701 +1,1294 @@
 #include <zlib.h>
-#include <regex>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
 #include <sstream>
 
 #include "utils/base64.hpp"
 #include "utils/compression.hpp"
+#include "utils/thread_pool.hpp"
 #include "xml_reader.hpp"
 
-RawData::Scan parse_mzxml_scan(std::istream &stream,
-                               std::optional<XmlReader::Tag> &tag,
-                               double min_mz, double max_mz, double min_rt,
-                               double max_rt, Polarity::Type polarity,
-                               size_t ms_level) {
-    RawData::Scan scan;
-    uint64_t precursor_id = 0;
-    scan.precursor_information.scan_number = 0;
-    auto scan_attributes = tag.value().attributes;
+// Parse numeric values from string views without allocating. Leading
+// whitespace is ignored to match the behaviour of std::stoi.
+template <typename T>
+static bool parse_int(std::string_view str, T &value) {
+    size_t i = 0;
+    while (i < str.size() && std::isspace(static_cast<uint8_t>(str[i]))) {
+        ++i;
+    }
+    if (i < str.size() && str[i] == '+') {
+        ++i;
+    }
+    auto result =
+        std::from_chars(str.data() + i, str.data() + str.size(), value);
+    return result.ec == std::errc();
+}
 
-    // Find scan number.
-    if (scan_attributes.find("num") == scan_attributes.end()) {
-        return {};
+// NOTE: std::from_chars for floating point values is not available in all the
+// compilers we support, so we use strtod on a null terminated copy instead.
+static bool parse_double(std::string_view str, double &value) {
+    char buffer[64];
+    size_t n = std::min(str.size(), sizeof(buffer) - 1);
+    std::memcpy(buffer, str.data(), n);
+    buffer[n] = '\0';
+    char *end = nullptr;
+    value = std::strtod(buffer, &end);
+    return end != buffer;
+}
+
+// Read the remainder of the stream into memory.
+static std::string read_stream(std::istream &stream) {
+    return std::string(std::istreambuf_iterator<char>(stream),
+                       std::istreambuf_iterator<char>());
+}
+
+// Create an empty RawData::RawData for the given instrument configuration.
+static RawData::RawData empty_raw_data(Instrument::Type instrument_type,
+                                       double resolution_ms1,
+                                       double resolution_msn,
+                                       double reference_mz) {
+    RawData::RawData raw_data = {};
+    raw_data.instrument_type = instrument_type;
+    raw_data.min_mz = std::numeric_limits<double>::infinity();
+    raw_data.max_mz = -std::numeric_limits<double>::infinity();
+    raw_data.min_rt = std::numeric_limits<double>::infinity();
+    raw_data.max_rt = -std::numeric_limits<double>::infinity();
+    raw_data.resolution_ms1 = resolution_ms1;
+    raw_data.resolution_msn = resolution_msn;
+    raw_data.reference_mz = reference_mz;
+    raw_data.fwhm_rt = 0;  // TODO(alex): Should this be passed as well?
+    raw_data.scans = {};
+    raw_data.retention_times = {};
+    // TODO(alex): Can we automatically detect the instrument type and set
+    // resolution from the header?
+    return raw_data;
+}
+
+// Add a non empty scan to the raw data, updating the m/z and rt ranges.
+static void append_scan(RawData::RawData &raw_data, RawData::Scan &&scan) {
+    raw_data.retention_times.push_back(scan.retention_time);
+    if (scan.retention_time < raw_data.min_rt) {
+        raw_data.min_rt = scan.retention_time;
+    }
+    if (scan.retention_time > raw_data.max_rt) {
+        raw_data.max_rt = scan.retention_time;
+    }
+    if (scan.mz[0] < raw_data.min_mz) {
+        raw_data.min_mz = scan.mz[0];
+    }
+    if (scan.mz[scan.mz.size() - 1] > raw_data.max_mz) {
+        raw_data.max_mz = scan.mz[scan.mz.size() - 1];
+    }
+    raw_data.scans.push_back(std::move(scan));
+}
+
+// Scratch memory and decompression state reused when decoding the binary
+// arrays of consecutive scans. Each reader thread needs its own context.
+struct DecodeContext {
+    Compression::Inflator inflator;
+    std::vector<uint8_t> decoded;
+    std::vector<uint8_t> decompressed;
+};
+
+// Decode a base64 encoded array, decompressing it if necessary. The returned
+// pointer refers to one of the context buffers and is valid until the next
+// call. Returns nullptr if the data could not be decompressed.
+static const std::vector<uint8_t> *decode_binary_data(
+    DecodeContext &context, std::string_view data, bool compressed,
+    size_t decompressed_len) {
+    Base64::decode_base64(data, context.decoded);
+    if (!compressed) {
+        return &context.decoded;
     }
-    scan.scan_number = std::stoi(scan_attributes["num"]);
+    int status = context.inflator.inflate(context.decoded.data(),
+                                          context.decoded.size(),
+                                          context.decompressed,
+                                          decompressed_len);
+    if (status != Z_OK) {
+        return nullptr;
+    }
+    return &context.decompressed;
+}
+
+// Remove the peaks of the scan that are outside the m/z range or have no
+// intensity, and calculate the number of points, max_intensity and
+// total_intensity of the remaining ones.
+static void filter_peaks(RawData::Scan &scan, double min_mz, double max_mz) {
+    auto &mzs = scan.mz;
+    auto &intensities = scan.intensity;
+    size_t num_points = std::min(mzs.size(), intensities.size());
+    double intensity_sum = 0;
+    double max_intensity = 0;
+    size_t scan_size = 0;
+    for (size_t i = 0; i < num_points; ++i) {
+        if (mzs[i] < min_mz || mzs[i] > max_mz || intensities[i] == 0.0) {
+            continue;
+        }
+        if (intensities[i] > max_intensity) {
+            max_intensity = intensities[i];
+        }
+        intensity_sum += intensities[i];
+        mzs[scan_size] = mzs[i];
+        intensities[scan_size] = intensities[i];
+        ++scan_size;
+    }
+    // Resize to number of elements that are actually included and shrink
+    // capacity.
+    mzs.resize(scan_size);
+    intensities.resize(scan_size);
+    mzs.shrink_to_fit();
+    intensities.shrink_to_fit();
+    scan.num_points = scan_size;
+    scan.max_intensity = max_intensity;
+    scan.total_intensity = intensity_sum;
+}
+
+std::optional<double> XmlReader::parse_duration(std::string_view duration) {
+    // The format is [-]PnDTnHnMnS, where every component is optional but at
+    // least one must be present, and the time components are preceded by
+    // 'T'. For more information about the format see:
+    //    https://www.w3.org/TR/xmlschema-2/#duration
+    size_t i = 0;
+    while (i < duration.size() &&
+           std::isspace(static_cast<uint8_t>(duration[i]))) {
+        ++i;
+    }
+    bool negative = false;
+    if (i < duration.size() && duration[i] == '-') {
+        negative = true;
+        ++i;
+    }
+    if (i == duration.size() || duration[i] != 'P') {
+        return std::nullopt;
+    }
+    ++i;
+
+    double days = 0.0;
+    double hours = 0.0;
+    double minutes = 0.0;
+    double seconds = 0.0;
+    // Designators must appear in this order, each at most once.
+    constexpr char designators[] = {'D', 'T', 'H', 'M', 'S'};
+    size_t next_designator = 0;
+    bool time = false;
+    bool empty = true;
+    while (i < duration.size() &&
+           !std::isspace(static_cast<uint8_t>(duration[i]))) {
+        if (duration[i] == 'T') {
+            if (next_designator > 1 || i + 1 == duration.size()) {
+                return std::nullopt;
+            }
+            time = true;
+            next_designator = 2;
+            ++i;
+            continue;
+        }
+        size_t number_start = i;
+        size_t num_digits = 0;
+        size_t num_dots = 0;
+        while (i < duration.size()) {
+            if (std::isdigit(static_cast<uint8_t>(duration[i]))) {
+                ++num_digits;
+            } else if (duration[i] == '.') {
+                ++num_dots;
+            } else {
+                break;
+            }
+            ++i;
+        }
+        if (num_digits == 0 || num_dots > 1 || i == duration.size()) {
+            return std::nullopt;
+        }
+        double value = 0.0;
+        if (!parse_double(duration.substr(number_start, i - number_start),
+                          value)) {
+            return std::nullopt;
+        }
+        char designator = duration[i];
+        size_t k = next_designator;
+        while (k < sizeof(designators) && designators[k] != designator) {
+            ++k;
+        }
+        // Days are only valid in the date part and hours, minutes and
+        // seconds only in the time part.
+        if (k == sizeof(designators) || (k == 0) == time) {
+            return std::nullopt;
+        }
+        switch (designator) {
+            case 'D':
+                days = value;
+                break;
+            case 'H':
+                hours = value;
+                break;
+            case 'M':
+                minutes = value;
+                break;
+            case 'S':
+                seconds = value;
+                break;
+        }
+        next_designator = k + 1;
+        empty = false;
+        ++i;
+    }
+    while (i < duration.size() &&
+           std::isspace(static_cast<uint8_t>(duration[i]))) {
+        ++i;
+    }
+    if (empty || i != duration.size()) {
+        return std::nullopt;
+    }
+
+    double total = seconds;
+    total += minutes * 60;
+    total += hours * 60 * 60;
+    total += days * 24 * 60 * 60;
+    return negative ? -total : total;
+}
+
+// Extract the retention time in seconds from the attributes of a scan tag.
+static std::optional<double> mzxml_retention_time(
+    const XmlReader::TagView &tag) {
+    auto retention_time_attribute = tag.attribute("retentionTime");
+    if (!retention_time_attribute) {
+        return std::nullopt;
+    }
+    return XmlReader::parse_duration(retention_time_attribute.value());
+}
+
+// Parse the contents of the scan tag that was just read from the cursor, up to
+// and including its closing tag. Nested scans are parsed recursively, with
+// the enclosing scan as their precursor. Scans with one of the requested MS
+// levels that are within the given ranges are added to the RawData of that
+// level.
+static void parse_mzxml_scan(XmlReader::Cursor &cursor,
+                             const XmlReader::TagView &tag,
+                             uint64_t precursor_id, DecodeContext &context,
+                             double min_mz, double max_mz, double min_rt,
+                             double max_rt, Polarity::Type polarity,
+                             const std::vector<size_t> &ms_levels,
+                             std::vector<RawData::RawData> &raw_data) {
+    RawData::Scan scan = {};
+    scan.precursor_information.scan_number = precursor_id;
+    // Position of the scan MS level in ms_levels. If the scan is not going to
+    // be stored, this is equal to ms_levels.size().
+    size_t level_index = ms_levels.size();
+    // Number of m/z-intensity pairs in the scan.
+    size_t num_points = 0;
+
+    // Find scan number.
+    auto num = tag.attribute("num");
+    bool valid = num && parse_int(num.value(), scan.scan_number);
 
     // Find polarity.
-    if (scan_attributes.find("polarity") != scan_attributes.end()) {
-        if (scan_attributes["polarity"] == "+") {
+    if (auto scan_polarity = tag.attribute("polarity")) {
+        if (scan_polarity.value() == "+") {
             scan.polarity = Polarity::POSITIVE;
-        } else if (scan_attributes["polarity"] == "-") {
+        } else if (scan_polarity.value() == "-") {
             scan.polarity = Polarity::NEGATIVE;
         } else {
             scan.polarity = Polarity::BOTH;
         }
         if (polarity != Polarity::BOTH && scan.polarity != polarity) {
-            return {};
+            valid = false;
         }
     }
 
     // Find MS level.
-    if (scan_attributes.find("msLevel") == scan_attributes.end()) {
-        return {};
+    auto ms_level_attribute = tag.attribute("msLevel");
+    if (valid && ms_level_attribute &&
+        parse_int(ms_level_attribute.value(), scan.ms_level)) {
+        level_index = std::find(ms_levels.begin(), ms_levels.end(),
+                                scan.ms_level) -
+                      ms_levels.begin();
     }
-    size_t scan_ms_level = std::stoi(scan_attributes["msLevel"]);
-    scan.ms_level = scan_ms_level;
 
     // Fill up the rest of the scan information.
-    if (scan_ms_level == ms_level) {
-        // Find the number of m/z-intensity pairs in the scan.
-        if (scan_attributes.find("peaksCount") == scan_attributes.end()) {
-            return {};
+    if (level_index != ms_levels.size()) {
+        auto peaks_count = tag.attribute("peaksCount");
+        if (!peaks_count || !parse_int(peaks_count.value(), num_points)) {
+            level_index = ms_levels.size();
         }
-        size_t num_points = std::stoi(scan_attributes["peaksCount"]);
 
         // Extract the retention time.
-        if (scan_attributes.find("retentionTime") == scan_attributes.end()) {
-            // NOTE(alex): On the spec, the retention time attribute is
-            // optional, however, we do require it.
-            return {};
-        }
-
-        // The time is in xs:duration units. Here we are only accounting
-        // for the data as stored in seconds, minutes and hours. It is
-        // unlikely that we are going to need to parse the days, months
-        // and years. For more information about the format see:
-        //    https://www.ibm.com/support/knowledgecenter/en/ssw_ibm_i_72/rzasp/rzasp_xsduration.htm
-        std::regex rt_regex(
-            R"(P.*T(?:([[:digit:]]+)H)?(?:([[:digit:]]+)M)?(?:([[:digit:]]+\.?[[:digit:]]*)S))");
-        std::smatch matches;
-        if (!std::regex_search(scan_attributes["retentionTime"], matches,
-                               rt_regex) ||
-            matches.size() != 4) {
-            return {};
-        }
-        double retention_time = std::stod(matches[3]);
-        if (matches[2] != "") {
-            retention_time += std::stod(matches[2]) * 60;
-        }
-        if (matches[1] != "") {
-            retention_time += std::stod(matches[1]) * 60 * 60;
-        }
-        scan.retention_time = retention_time;
-
-        // Check if we are on the desired region as defined by
-        if (retention_time < min_rt) {
-            return {};
-        }
-        // Assuming linearity of the retention time on the mzXML file.
-        // TODO: We should stop searching for the next scan, since we are out of
-        // bounds.
-        if (retention_time > max_rt) {
-            return {};
-        }
-
-        // Fetch the next tag. We are interested in the contents of this scan
-        // tag: precursorMz and peaks.
-        auto next_tag = XmlReader::read_tag(stream);
-        while (stream.good() && !stream.eof()) {
-            if (next_tag.value().name == "scan" && next_tag.value().closed) {
-                break;
-            }
-            // We are not interested in subscans here. Continue until we find
-            // the corresponding output.
-            // FIXME: This only works with ONE subscan! ms1->ms2, if we are in
-            // ms1 and our ms2 contain subscans, it will FAIL. We need to
-            // recursively check child scans.
-            if (next_tag.value().name == "scan" && !next_tag.value().closed) {
-                next_tag = XmlReader::read_tag(stream);
-                while (stream.good() && !stream.eof()) {
-                    if (next_tag.value().name == "scan" &&
-                        next_tag.value().closed) {
-                        break;
-                    }
-                    next_tag = XmlReader::read_tag(stream);
-                }
-            }
-            if (next_tag.value().name == "peaks") {
-                auto peak_attributes = next_tag.value().attributes;
-
-                // Extract the precision from the peaks tag.
-                if (peak_attributes.find("precision") ==
-                    peak_attributes.end()) {
-                    return {};
-                }
-                int precision = std::stoi(peak_attributes["precision"]);
-
-                // Extract the byteOrder from the peaks tag. This determines
-                // the endianness in which the data was stored. `network` ==
-                // `big_endian`.
-                if (peak_attributes.find("byteOrder") ==
-                    peak_attributes.end()) {
-                    return {};
-                }
-                auto byte_order = peak_attributes["byteOrder"];
-                auto little_endian = byte_order != "network";
-
-                // Extract the contentType/pairOrder from the peaks tag and
-                // exit if it is not `m/z-int`. In older versions of
-                // ProteoWizard, the conversion was not validated and the
-                // tag was incorrect. Here we are supporting both versions
-                // for compatibility but we are not trying to be exhaustive.
-                auto content_type_found = peak_attributes.find("contentType") !=
-                                          peak_attributes.end();
-                auto pair_order_found =
-                    peak_attributes.find("pairOrder") != peak_attributes.end();
-                if (!content_type_found && !pair_order_found) {
-                    return {};
-                }
-                std::string pair_order;
-                if (content_type_found) {
-                    pair_order = peak_attributes["contentType"];
-                } else {
-                    pair_order = peak_attributes["pairOrder"];
-                }
-
-                // Find whether or not the data is compressed.
-                bool compressed = peak_attributes["compressionType"] == "zlib";
+        // NOTE(alex): On the spec, the retention time attribute is
+        // optional, however, we do require it.
+        auto retention_time = mzxml_retention_time(tag);
+        if (!retention_time) {
+            level_index = ms_levels.size();
+        } else {
+            scan.retention_time = retention_time.value();
+        }
 
-                // Extract the peaks from the data.
-                auto data = XmlReader::read_data(stream);
-                if (!data) {
-                    return {};
-                }
+        // Check if we are on the desired region. The caller stops reading
+        // once a top level scan is out of bounds, assuming linearity of the
+        // retention time on the mzXML file.
+        if (scan.retention_time < min_rt || scan.retention_time > max_rt) {
+            level_index = ms_levels.size();
+        }
+    }
 
-                // Decode base64-encoded string to raw data.
-                std::vector<uint8_t> raw_data;
-                Base64::decode_base64(data.value(), raw_data);
+    // Store the scan in the corresponding RawData. Nested scans are placed
+    // after the peaks of their precursor, so this can be done as soon as
+    // either the end of the scan or a nested scan is found.
+    auto store_scan = [&]() {
+        if (level_index == ms_levels.size()) {
+            return;
+        }
+        filter_peaks(scan, min_mz, max_mz);
+        if (scan.num_points != 0) {
+            append_scan(raw_data[level_index], std::move(scan));
+        }
+        level_index = ms_levels.size();
+    };
 
-                if (compressed) {
-                    // Calculate amount of bytes in decompressed data.
-                    size_t decompressed_len = num_points * 2 * (precision / 8);
-                    std::vector<uint8_t> decompressed_data;
+    while (cursor.good()) {
+        auto next_tag = XmlReader::read_tag(cursor);
+        if (!next_tag) {
+            continue;
+        }
+        if (next_tag->name == "scan") {
+            if (next_tag->closed) {
+                break;
+            }
+            store_scan();
+            parse_mzxml_scan(cursor, next_tag.value(), scan.scan_number,
+                             context, min_mz, max_mz, min_rt, max_rt, polarity,
+                             ms_levels, raw_data);
+            continue;
+        }
+        // We are only interested in the contents of the scans being stored:
+        // precursorMz and peaks.
+        if (level_index == ms_levels.size()) {
+            continue;
+        }
+        if (next_tag->name == "peaks" && !next_tag->closed) {
+            const auto &peaks_tag = next_tag.value();
+
+            // Extract the precision from the peaks tag.
+            int precision = 0;
+            auto precision_attribute = peaks_tag.attribute("precision");
+            if (!precision_attribute ||
+                !parse_int(precision_attribute.value(), precision)) {
+                level_index = ms_levels.size();
+                continue;
+            }
 
-                    // Decompress data.
-                    int status = Compression::inflate(
-                        raw_data, decompressed_data, decompressed_len);
+            // Extract the byteOrder from the peaks tag. This determines the
+            // endianness in which the data was stored. `network` ==
+            // `big_endian`.
+            auto byte_order = peaks_tag.attribute("byteOrder");
+            if (!byte_order) {
+                level_index = ms_levels.size();
+                continue;
+            }
+            auto little_endian = byte_order.value() != "network";
+
+            // Extract the contentType/pairOrder from the peaks tag and exit if
+            // it is not `m/z-int`. In older versions of ProteoWizard, the
+            // conversion was not validated and the tag was incorrect. Here we
+            // are supporting both versions for compatibility but we are not
+            // trying to be exhaustive.
+            if (!peaks_tag.attribute("contentType") &&
+                !peaks_tag.attribute("pairOrder")) {
+                level_index = ms_levels.size();
+                continue;
+            }
 
-                    // Check status after decompression.
-                    if (status != Z_OK) {
-                        return {};
-                    }
+            // Find whether or not the data is compressed.
+            bool compressed = peaks_tag.attribute("compressionType") == "zlib";
 
-                    raw_data = decompressed_data;
-                }
+            // Extract the peaks from the data.
+            auto data = XmlReader::read_data(cursor);
+            if (!data) {
+                level_index = ms_levels.size();
+                continue;
+            }
 
-                // Interpret raw data.
-                double intensity_sum = 0;
-                double max_intensity = 0;
+            // Decode base64-encoded string to raw data. Calculate amount of
+            // bytes in decompressed data.
+            size_t decompressed_len = num_points * 2 * (precision / 8);
+            auto binary_data = decode_binary_data(context, data.value(),
+                                                  compressed, decompressed_len);
+            if (!binary_data) {
+                level_index = ms_levels.size();
+                continue;
+            }
 
+            // Interpret raw data. The number of points is limited to the
+            // amount of data available.
+            Base64::interpret_pairs(binary_data->data(), binary_data->size(),
+                                    precision, little_endian, scan.mz,
+                                    scan.intensity);
+            if (scan.mz.size() > num_points) {
                 scan.mz.resize(num_points);
                 scan.intensity.resize(num_points);
-                size_t scan_size = 0;
-
-                size_t offset = 0;
-                for (size_t i = 0; i < num_points; ++i) {
-                    double mz = 0;
-                    double intensity = 0;
-                    // Interpret mz and intensity values.
-                    if (precision == 32) {
-                        mz = Base64::interpret_float(raw_data, offset,
-                                                     little_endian);
-                        offset += 4;
-                        intensity = Base64::interpret_float(raw_data, offset,
-                                                            little_endian);
-                        offset += 4;
-                    } else if (precision == 64) {
-                        mz = Base64::interpret_double(raw_data, offset,
-                                                      little_endian);
-                        offset += 8;
-                        intensity = Base64::interpret_double(raw_data, offset,
-                                                             little_endian);
-                        offset += 8;
-                    }
-
-                    // We don't need to extract the peaks when we are not
-                    // inside the mz bounds or contain no value.
-                    if (mz < min_mz || mz > max_mz || intensity == 0) {
-                        continue;
-                    }
-
-                    if (intensity > max_intensity) {
-                        max_intensity = intensity;
-                    }
-                    intensity_sum += intensity;
-
-                    scan.mz[scan_size] = mz;
-                    scan.intensity[scan_size] = intensity;
-                    ++scan_size;
-                }
-                // Resize to number of elements that are actually included.
-                scan.mz.resize(scan_size);
-                scan.intensity.resize(scan_size);
+            }
+        }
+        if (next_tag->name == "precursorMz" && !next_tag->closed) {
+            const auto &precursor_tag = next_tag.value();
+            auto &precursor_information = scan.precursor_information;
+            if (auto value = precursor_tag.attribute("precursorIntensity")) {
+                parse_double(value.value(), precursor_information.intensity);
+            }
 
-                // Shrink capacity
-                scan.mz.shrink_to_fit();
-                scan.intensity.shrink_to_fit();
+            if (auto value = precursor_tag.attribute("windowWideness")) {
+                parse_double(value.value(),
+                             precursor_information.window_wideness);
+            }
 
-                scan.num_points = scan.mz.size();
-                scan.max_intensity = max_intensity;
-                scan.total_intensity = intensity_sum;
+            if (auto value = precursor_tag.attribute("precursorCharge")) {
+                int charge = 0;
+                parse_int(value.value(), charge);
+                precursor_information.charge = charge;
             }
-            if (next_tag.value().name == "precursorMz") {
-                auto precursor_attributes = next_tag.value().attributes;
-                if (precursor_attributes.find("precursorIntensity") !=
-                    precursor_attributes.end()) {
-                    scan.precursor_information.intensity =
-                        std::stod(precursor_attributes["precursorIntensity"]);
-                }
 
-                if (precursor_attributes.find("windowWideness") !=
-                    precursor_attributes.end()) {
-                    scan.precursor_information.window_wideness =
-                        std::stod(precursor_attributes["windowWideness"]);
-                }
+            auto activation_method =
+                precursor_tag.attribute("activationMethod");
+            if (activation_method == "CID") {
+                precursor_information.activation_method =
+                    ActivationMethod::CID;
+            } else if (activation_method == "HCD") {
+                precursor_information.activation_method =
+                    ActivationMethod::HCD;
+            } else {
+                precursor_information.activation_method =
+                    ActivationMethod::UNKNOWN;
+            }
 
-                if (precursor_attributes.find("precursorCharge") !=
-                    precursor_attributes.end()) {
-                    scan.precursor_information.charge =
-                        std::stoi(precursor_attributes["precursorCharge"]);
-                }
+            auto data = XmlReader::read_data(cursor);
+            if (!data ||
+                !parse_double(data.value(), precursor_information.mz)) {
+                level_index = ms_levels.size();
+                continue;
+            }
 
-                if (precursor_attributes.find("activationMethod") !=
-                    precursor_attributes.end()) {
-                    if (precursor_attributes["activationMethod"] == "CID") {
-                        scan.precursor_information.activation_method =
-                            ActivationMethod::CID;
-                    } else if (precursor_attributes["activationMethod"] ==
-                               "HCD") {
-                        scan.precursor_information.activation_method =
-                            ActivationMethod::HCD;
-                    } else {
-                        scan.precursor_information.activation_method =
-                            ActivationMethod::UNKNOWN;
-                    }
-                } else {
-                    scan.precursor_information.activation_method =
-                        ActivationMethod::UNKNOWN;
-                }
+            // The enclosing scan takes precedence over the precursorScanNum
+            // attribute.
+            auto precursor_scan_num =
+                precursor_tag.attribute("precursorScanNum");
+            if (precursor_id == 0 && precursor_scan_num) {
+                parse_int(precursor_scan_num.value(),
+                          precursor_information.scan_number);
+            }
+        }
+    }
+    store_scan();
+}
 
-                auto data = XmlReader::read_data(stream);
-                if (!data) {
-                    return {};
-                }
-                scan.precursor_information.mz = std::stod(data.value());
+// Read the scan offsets from the <index> at the end of an indexed mzXML file.
+// Returns std::nullopt if the index is missing or doesn't match the contents
+// of the buffer.
+static std::optional<std::vector<size_t>> read_mzxml_index(
+    std::string_view buffer) {
+    size_t index_offset_position = buffer.rfind("<indexOffset>");
+    if (index_offset_position == std::string_view::npos) {
+        return std::nullopt;
+    }
+    auto cursor = XmlReader::Cursor{buffer, index_offset_position};
+    XmlReader::read_tag(cursor);
+    auto data = XmlReader::read_data(cursor);
+    size_t index_offset = 0;
+    if (!data || !parse_int(data.value(), index_offset) ||
+        index_offset >= index_offset_position) {
+        return std::nullopt;
+    }
 
-                if (precursor_attributes.find("precursorScanNum") !=
-                    precursor_attributes.end()) {
-                    scan.precursor_information.scan_number =
-                        std::stoi(precursor_attributes["precursorScanNum"]);
+    // Read the offsets of the scan index.
+    std::vector<size_t> offsets;
+    bool scan_index = false;
+    cursor.position = index_offset;
+    while (cursor.good()) {
+        auto tag = XmlReader::read_tag(cursor);
+        if (!tag) {
+            continue;
+        }
+        if (tag->name == "index") {
+            if (tag->closed) {
+                if (scan_index) {
+                    break;
                 }
+                continue;
             }
-            next_tag = XmlReader::read_tag(stream);
+            scan_index = tag->attribute("name") == "scan";
+        }
+        if (scan_index && tag->name == "offset" && !tag->closed) {
+            auto data = XmlReader::read_data(cursor);
+            size_t offset = 0;
+            if (!data || !parse_int(data.value(), offset)) {
+                return std::nullopt;
+            }
+            offsets.push_back(offset);
         }
-        return scan;
     }
 
-    // If we are interested in a scan with a mz_level != 1, we need to find the
-    // precursor to which it belongs.
-    if (scan_ms_level == ms_level - 1) {
-        precursor_id = scan.scan_number;
-        auto next_tag = XmlReader::read_tag(stream);
-        while (stream.good() && next_tag) {
-            if (next_tag.value().name == "scan" && next_tag.value().closed) {
-                break;
-            }
-            if (next_tag.value().name == "scan" && !next_tag.value().closed) {
-                auto child_scan =
-                    parse_mzxml_scan(stream, next_tag, min_mz, max_mz, min_rt,
-                                     max_rt, polarity, ms_level);
-                child_scan.precursor_information.scan_number = precursor_id;
-                if (child_scan.precursor_information.scan_number !=
-                        precursor_id &&
-                    child_scan.precursor_information.scan_number == 0) {
-                    child_scan.precursor_information.scan_number = precursor_id;
-                }
-                return child_scan;
-            }
-            next_tag = XmlReader::read_tag(stream);
+    // Make sure that every offset points to the beginning of a scan tag.
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        size_t offset = offsets[i];
+        if ((i > 0 && offset <= offsets[i - 1]) ||
+            offset + 6 > buffer.size() ||
+            buffer.compare(offset, 5, "<scan") != 0 ||
+            !std::isspace(static_cast<uint8_t>(buffer[offset + 5]))) {
+            return std::nullopt;
         }
     }
+    return offsets;
+}
 
-    return {};
+// Find the position from which to start reading an indexed mzXML file to get
+// all the scans with retention time >= min_rt. The first scan in range is
+// found with a binary search over the offsets, assuming linearity of the
+// retention time. Since MSn scans can be nested inside their precursor, we
+// then move back to the closest MS1 scan, which is always at the top level.
+static size_t find_mzxml_start_offset(std::string_view buffer,
+                                      const std::vector<size_t> &offsets,
+                                      double min_rt) {
+    // Read the scan tag at the given index position.
+    auto scan_tag = [&](size_t i) {
+        auto cursor = XmlReader::Cursor{buffer, offsets[i]};
+        return XmlReader::read_tag(cursor);
+    };
+
+    size_t lo = 0;
+    size_t hi = offsets.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        auto tag = scan_tag(mid);
+        if (!tag) {
+            return 0;
+        }
+        auto retention_time = mzxml_retention_time(tag.value());
+        if (!retention_time) {
+            // Can't search without retention times, read the whole file.
+            return 0;
+        }
+        if (retention_time.value() < min_rt) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == offsets.size()) {
+        // All scans are before min_rt, the last one is as good as any.
+        return offsets.empty() ? 0 : offsets.back();
+    }
+
+    while (lo > 0) {
+        auto tag = scan_tag(lo);
+        if (!tag) {
+            return 0;
+        }
+        if (tag->attribute("msLevel") == "1") {
+            break;
+        }
+        --lo;
+    }
+    return lo == 0 ? 0 : offsets[lo];
 }
 
-std::optional<RawData::RawData> XmlReader::read_mzxml(
-    std::istream &stream, double min_mz, double max_mz, double min_rt,
+std::optional<std::vector<RawData::RawData>> XmlReader::read_mzxml_levels(
+    std::string_view buffer, double min_mz, double max_mz, double min_rt,
     double max_rt, Instrument::Type instrument_type, double resolution_ms1,
     double resolution_msn, double reference_mz, Polarity::Type polarity,
-    size_t ms_level) {
-    RawData::RawData raw_data = {};
-    raw_data.instrument_type = instrument_type;
-    raw_data.min_mz = std::numeric_limits<double>::infinity();
-    raw_data.max_mz = -std::numeric_limits<double>::infinity();
-    raw_data.min_rt = std::numeric_limits<double>::infinity();
-    raw_data.max_rt = -std::numeric_limits<double>::infinity();
-    raw_data.resolution_ms1 = resolution_ms1;
-    raw_data.resolution_msn = resolution_msn;
-    raw_data.reference_mz = reference_mz;
-    raw_data.fwhm_rt = 0;  // TODO(alex): Should this be passed as well?
-    raw_data.scans = {};
-    raw_data.retention_times = {};
-    // TODO(alex): Can we automatically detect the instrument type and set
-    // resolution from the header?
-    while (stream.good() && !stream.eof()) {
-        auto tag = XmlReader::read_tag(stream);
+    const std::vector<size_t> &ms_levels) {
+    auto raw_data = std::vector<RawData::RawData>(
+        ms_levels.size(), empty_raw_data(instrument_type, resolution_ms1,
+                                         resolution_msn, reference_mz));
+    auto cursor = Cursor{buffer, 0};
+    DecodeContext context;
+
+    // If the file is indexed we can skip the scans before min_rt.
+    if (min_rt > 0) {
+        auto offsets = read_mzxml_index(buffer);
+        if (offsets) {
+            cursor.position =
+                find_mzxml_start_offset(buffer, offsets.value(), min_rt);
+        }
+    }
+
+    while (cursor.good()) {
+        auto tag = XmlReader::read_tag(cursor);
         if (!tag) {
             continue;
         }
-        auto atts = tag.value().attributes;
 
-        if (tag.value().name == "msRun" && tag.value().closed) {
+        if (tag->name == "msRun" && tag->closed) {
             break;
         }
-        if (tag.value().name == "scan" && !tag.value().closed) {
-            auto scan = parse_mzxml_scan(stream, tag, min_mz, max_mz, min_rt,
-                                         max_rt, polarity, ms_level);
-            if (scan.num_points != 0) {
-                raw_data.scans.push_back(scan);
-                raw_data.retention_times.push_back(scan.retention_time);
-                if (scan.retention_time < raw_data.min_rt) {
-                    raw_data.min_rt = scan.retention_time;
-                }
-                if (scan.retention_time > raw_data.max_rt) {
-                    raw_data.max_rt = scan.retention_time;
-                }
-                if (scan.mz[0] < raw_data.min_mz) {
-                    raw_data.min_mz = scan.mz[0];
-                }
-                if (scan.mz[scan.mz.size() - 1] > raw_data.max_mz) {
-                    raw_data.max_mz = scan.mz[scan.mz.size() - 1];
-                }
+        if (tag->name == "scan" && !tag->closed) {
+            // Assuming linearity of the retention time, once a top level scan
+            // is past max_rt so are all the following ones (Including the
+            // nested ones).
+            auto retention_time = mzxml_retention_time(tag.value());
+            if (retention_time && retention_time.value() > max_rt) {
+                break;
             }
+            parse_mzxml_scan(cursor, tag.value(), 0, context, min_mz, max_mz,
+                             min_rt, max_rt, polarity, ms_levels, raw_data);
         }
     }
     return raw_data;
 }
 
-std::optional<RawData::RawData> XmlReader::read_mzml(
+std::optional<RawData::RawData> XmlReader::read_mzxml(
+    std::string_view buffer, double min_mz, double max_mz, double min_rt,
+    double max_rt, Instrument::Type instrument_type, double resolution_ms1,
+    double resolution_msn, double reference_mz, Polarity::Type polarity,
+    size_t ms_level) {
+    auto raw_data = read_mzxml_levels(buffer, min_mz, max_mz, min_rt, max_rt,
+                                      instrument_type, resolution_ms1,
+                                      resolution_msn, reference_mz, polarity,
+                                      {ms_level});
+    if (!raw_data) {
+        return std::nullopt;
+    }
+    return std::move(raw_data->front());
+}
+
+std::optional<RawData::RawData> XmlReader::read_mzxml(
     std::istream &stream, double min_mz, double max_mz, double min_rt,
     double max_rt, Instrument::Type instrument_type, double resolution_ms1,
     double resolution_msn, double reference_mz, Polarity::Type polarity,
     size_t ms_level) {
-    RawData::RawData raw_data = {};
-    raw_data.instrument_type = instrument_type;
-    raw_data.min_mz = std::numeric_limits<double>::infinity();
-    raw_data.max_mz = -std::numeric_limits<double>::infinity();
-    raw_data.min_rt = std::numeric_limits<double>::infinity();
-    raw_data.max_rt = -std::numeric_limits<double>::infinity();
-    raw_data.resolution_ms1 = resolution_ms1;
-    raw_data.resolution_msn = resolution_msn;
-    raw_data.reference_mz = reference_mz;
-    raw_data.fwhm_rt = 0;  // TODO(alex): Should this be passed as well?
-    raw_data.scans = {};
-    raw_data.retention_times = {};
-    // TODO(alex): Can we automatically detect the instrument type and set
-    // resolution from the header?
-    while (stream.good() && !stream.eof()) {
-        auto tag = XmlReader::read_tag(stream);
+    auto buffer = read_stream(stream);
+    return read_mzxml(buffer, min_mz, max_mz, min_rt, max_rt, instrument_type,
+                      resolution_ms1, resolution_msn, reference_mz, polarity,
+                      ms_level);
+}
+
+// Parse the contents of the spectrum tag that was just read from the cursor.
+// Scans outside the requested ranges or MS levels are returned empty. Scans
+// outside the retention time range keep their retention time, so that the
+// caller can stop reading after max_rt. Returns std::nullopt if the binary data
+// could not be decoded.
+static std::optional<RawData::Scan> parse_mzml_spectrum(
+    XmlReader::Cursor &cursor, const XmlReader::TagView &tag,
+    DecodeContext &context, double min_mz, double max_mz, double min_rt,
+    double max_rt, Polarity::Type polarity,
+    const std::vector<size_t> &ms_levels) {
+    RawData::Scan scan = {};
+    // Parse the contents and metadata of this spectrum.
+    scan.precursor_information.scan_number = 0;
+
+    // NOTE: In the mzML spec, the native scan number is described on
+    // the "id" attribute, and can contain more information than
+    // required for just an integer identifer. Moreover, it looks like,
+    // at least for Orbitrap data, the scan numbers are non-zero
+    // consecutive integers. For the sake of time, I'm just assuming
+    // here that this assumption is the same for all formats, but should
+    // probably find a more robust way of doing this.
+    auto index = tag.attribute("index");
+    if (!index || !parse_int(index.value(), scan.scan_number)) {
+        return RawData::Scan{};
+    }
+    ++scan.scan_number;
+    auto is_requested_level = [&](size_t level) {
+        return level != 0 && std::find(ms_levels.begin(), ms_levels.end(),
+                                       level) != ms_levels.end();
+    };
+    std::vector<double> mzs;
+    std::vector<double> intensities;
+    while (cursor.good()) {
+        auto tag = XmlReader::read_tag(cursor);
         if (!tag) {
-            continue;
+            break;
         }
-        if (tag.value().name == "spectrumList" && tag.value().closed) {
+        if (tag->name == "spectrum" && tag->closed) {
             break;
         }
-        RawData::Scan scan = {};
-        if (tag.value().name == "spectrum" && !tag.value().closed) {
-            // Parse the contents and metadata of this spectrum.
-            scan.precursor_information.scan_number = 0;
-            auto scan_attributes = tag.value().attributes;
-
-            // NOTE: In the mzML spec, the native scan number is described on
-            // the "id" attribute, and can contain more information than
-            // required for just an integer identifer. Moreover, it looks like,
-            // at least for Orbitrap data, the scan numbers are non-zero
-            // consecutive integers. For the sake of time, I'm just assuming
-            // here that this assumption is the same for all formats, but should
-            // probably find a more robust way of doing this.
-            scan.scan_number = std::stoi(scan_attributes["index"]) + 1;
-            std::vector<bool> filter_points;
-            std::vector<double> mzs;
-            std::vector<double> intensities;
-            while (stream.good() && !stream.eof()) {
-                auto tag = XmlReader::read_tag(stream);
+
+        if (tag->name == "cvParam") {
+            auto accession = tag->attribute("accession");
+            auto value = tag->attribute("value").value_or("");
+
+            // This scan is ms_level 1
+            if (accession == "MS:1000579") {
+                scan.ms_level = 1;
+            }
+
+            // MS level a multi-level MSn experiment.
+            if (accession == "MS:1000511") {
+                parse_int(value, scan.ms_level);
+            }
+
+            // Polarity.
+            if (accession == "MS:1000130") {
+                if (polarity != Polarity::BOTH &&
+                    Polarity::POSITIVE != polarity) {
+                    continue;
+                }
+                scan.polarity = Polarity::POSITIVE;
+            }
+            if (accession == "MS:1000129") {
+                if (polarity != Polarity::BOTH &&
+                    Polarity::NEGATIVE != polarity) {
+                    continue;
+                }
+                scan.polarity = Polarity::NEGATIVE;
+            }
+
+            // Retention time.
+            if (accession == "MS:1000016") {
+                parse_double(value, scan.retention_time);
+                // Retention time is store in seconds. Make sure it is
+                // the right unit. If the unit accession was
+                // "UO:0000010" it would be in seconds, so no action is
+                // required.
+                if (tag->attribute("unitAccession") == "UO:0000031") {
+                    scan.retention_time *= 60.0;
+                }
+                if (scan.retention_time < min_rt ||
+                    scan.retention_time > max_rt) {
+                    RawData::Scan rejected = {};
+                    rejected.retention_time = scan.retention_time;
+                    return rejected;
+                }
+            }
+        }
+
+        if (tag->name == "precursor") {
+            // Find scan number.
+            auto spectrum_ref =
+                tag->attribute("spectrumRef").value_or("");
+            size_t scan_idx = spectrum_ref.find("scan=");
+            if (scan_idx != std::string_view::npos) {
+                parse_int(spectrum_ref.substr(scan_idx + 5),
+                          scan.precursor_information.scan_number);
+            }
+
+            scan.precursor_information.charge = 0;
+            scan.precursor_information.mz = 0.0;
+            scan.precursor_information.window_wideness = 0.0;
+            scan.precursor_information.intensity = 0.0;
+            scan.precursor_information.activation_method =
+                ActivationMethod::UNKNOWN;
+            while (cursor.good()) {
+                auto tag = XmlReader::read_tag(cursor);
                 if (!tag) {
                     break;
                 }
-                if (tag.value().name == "spectrum" && tag.value().closed) {
+                if (tag->name == "precursor" && tag->closed) {
                     break;
                 }
-
-                if (tag.value().name == "cvParam") {
-                    auto cv_attributes = tag.value().attributes;
-                    auto accession = cv_attributes["accession"];
-
-                    // This scan is ms_level 1
-                    if (accession == "MS:1000579") {
-                        scan.ms_level = 1;
+                if (tag->name == "cvParam") {
+                    auto accession = tag->attribute("accession");
+                    auto value = tag->attribute("value").value_or("");
+                    double number = 0.0;
+                    // Isolation window.
+                    if (accession == "MS:1000827") {
+                        parse_double(value,
+                                     scan.precursor_information.mz);
                     }
-
-                    // MS level a multi-level MSn experiment.
-                    if (accession == "MS:1000511") {
-                        size_t scan_ms_level =
-                            std::stoi(cv_attributes["value"]);
-                        scan.ms_level = scan_ms_level;
+                    if (accession == "MS:1000828" ||
+                        accession == "MS:1000829") {
+                        parse_double(value, number);
+                        scan.precursor_information.window_wideness +=
+                            number;
                     }
-
-                    // Polarity.
-                    if (accession == "MS:1000130") {
-                        if (polarity != Polarity::BOTH &&
-                            Polarity::POSITIVE != polarity) {
-                            continue;
-                        }
-                        scan.polarity = Polarity::POSITIVE;
+                    // Charge state.
+                    if (accession == "MS:1000041") {
+                        int charge = 0;
+                        parse_int(value, charge);
+                        scan.precursor_information.charge = charge;
                     }
-                    if (accession == "MS:1000129") {
-                        if (polarity != Polarity::BOTH &&
-                            Polarity::NEGATIVE != polarity) {
-                            continue;
-                        }
-                        scan.polarity = Polarity::NEGATIVE;
+                    if (accession == "MS:1000042") {
+                        parse_double(
+                            value,
+                            scan.precursor_information.intensity);
                     }
-
-                    // Retention time.
-                    if (accession == "MS:1000016") {
-                        scan.retention_time = std::stod(cv_attributes["value"]);
-                        // Retention time is store in seconds. Make sure it is
-                        // the right unit. If the unit accession was
-                        // "UO:0000010" it would be in seconds, so no action is
-                        // required.
-                        if (cv_attributes["unitAccession"] == "UO:0000031") {
-                            scan.retention_time *= 60.0;
-                        }
-                        if (scan.retention_time < min_rt ||
-                            scan.retention_time > max_rt) {
-                            scan = {};
-                            break;
-                        }
+                    // Activation method.
+                    if (accession == "MS:1000422") {
+                        scan.precursor_information.activation_method =
+                            ActivationMethod::HCD;
                     }
                 }
+            }
+        }
 
-                if (tag.value().name == "precursor") {
-                    auto precursor_attributes = tag.value().attributes;
-                    std::string spectrumRef =
-                        precursor_attributes["spectrumRef"];
-                    // Find scan number.
-                    size_t scanIdx = spectrumRef.find("scan=") + 5;
-                    scan.precursor_information.scan_number =
-                        std::stoull(spectrumRef.substr(scanIdx));
-
-                    scan.precursor_information.charge = 0;
-                    scan.precursor_information.mz = 0.0;
-                    scan.precursor_information.window_wideness = 0.0;
-                    scan.precursor_information.intensity = 0.0;
-                    scan.precursor_information.activation_method =
-                        ActivationMethod::UNKNOWN;
-                    while (stream.good() && !stream.eof()) {
-                        auto tag = XmlReader::read_tag(stream);
-                        if (!tag) {
-                            break;
-                        }
-                        if (tag.value().name == "precursor" &&
-                            tag.value().closed) {
-                            break;
-                        }
-                        if (tag.value().name == "cvParam") {
-                            auto cv_attributes = tag.value().attributes;
-                            auto accession = cv_attributes["accession"];
-                            // Isolation window.
-                            if (accession == "MS:1000827") {
-                                scan.precursor_information.mz =
-                                    std::stod(cv_attributes["value"]);
-                            }
-                            if (accession == "MS:1000828") {
-                                scan.precursor_information.window_wideness +=
-                                    std::stod(cv_attributes["value"]);
-                            }
-                            if (accession == "MS:1000829") {
-                                scan.precursor_information.window_wideness +=
-                                    std::stod(cv_attributes["value"]);
-                            }
-                            // Charge state.
-                            if (accession == "MS:1000041") {
-                                scan.precursor_information.charge =
-                                    std::stoi(cv_attributes["value"]);
-                            }
-                            if (accession == "MS:1000042") {
-                                scan.precursor_information.intensity =
-                                    std::stod(cv_attributes["value"]);
-                            }
-                            // Activation method.
-                            if (accession == "MS:1000422") {
-                                scan.precursor_information.activation_method =
-                                    ActivationMethod::HCD;
-                            }
-                        }
-                    }
+        if (tag->name == "binaryDataArray") {
+            // precision can be: 64 or 32 (bits).
+            int precision = 0;
+            // Uncompressed: false, Zlib compression: true.
+            bool compressed = false;
+            // mz: 0, intensity: 1
+            int type = -1;
+            std::optional<std::string_view> data;
+            while (cursor.good()) {
+                auto tag = XmlReader::read_tag(cursor);
+                if (!tag) {
+                    break;
                 }
-
-                if (tag.value().name == "binaryDataArray") {
-                    // precision can be: 64 or 32 (bits).
-                    int precision = 0;
-                    // Uncompressed: false, Zlib compression: true.
-                    bool compressed = false;
-                    // mz: 0, intensity: 1
-                    int type = -1;
-                    std::optional<std::string> data;
-                    while (stream.good() && !stream.eof()) {
-                        auto tag = XmlReader::read_tag(stream);
-                        if (!tag) {
-                            break;
-                        }
-                        if (tag.value().name == "binaryDataArray" &&
-                            tag.value().closed) {
-                            break;
-                        }
-                        if (tag.value().name == "cvParam") {
-                            auto cv_attributes = tag.value().attributes;
-                            auto accession = cv_attributes["accession"];
-                            // Precision.
-                            if (accession == "MS:1000523") {
-                                precision = 64;
-                            }
-                            if (accession == "MS:1000521") {
-                                precision = 32;
-                            }
-                            // Compression.
-                            if (accession == "MS:1000574") {
-                                compressed = true;
-                            }
-                            // Type of vector.
-                            if (accession == "MS:1000514") {
-                                type = 0;
-                            }
-                            if (accession == "MS:1000515") {
-                                type = 1;
-                            }
-                        }
-                        if (tag.value().name == "binary" &&
-                            !tag.value().closed) {
-                            data = XmlReader::read_data(stream);
-                        }
+                if (tag->name == "binaryDataArray" && tag->closed) {
+                    break;
+                }
+                if (tag->name == "cvParam") {
+                    auto accession = tag->attribute("accession");
+                    // Precision.
+                    if (accession == "MS:1000523") {
+                        precision = 64;
                     }
-                    if (data) {
-                        // decode data.
-                        std::vector<uint8_t> binary_data;
-                        Base64::decode_base64(data.value(), binary_data);
-                        if (compressed) {
-                            std::vector<uint8_t> decompressed_data;
-
-                            // Decompress data, set decompressed length to 0
-                            // (unknown).
-                            int status = Compression::inflate(
-                                binary_data, decompressed_data, 0);
-
-                            // Check status after decompression.
-                            if (status != Z_OK) {
-                                return raw_data;
-                            }
-
-                            binary_data = decompressed_data;
-                        }
-
-                        size_t num_points =
-                            binary_data.size() / (precision / 8);
-
-                        if (type == 0) {  // mz
-                            mzs = std::vector<double>(num_points);
-                        }
-                        if (type == 1) {  // intensity
-                            intensities = std::vector<double>(num_points);
-                        }
-                        if (filter_points.empty()) {
-                            filter_points =
-                                std::vector<bool>(num_points, false);
-                        }
-
-                        // offset for interpretation.
-                        size_t offset = 0;
-                        for (size_t i = 0; i < num_points; ++i) {
-                            double value = 0;
-                            if (precision == 32) {
-                                value = Base64::interpret_float(binary_data,
-                                                                offset, true);
-                                offset += 4;
-                            } else if (precision == 64) {
-                                value = Base64::interpret_double(binary_data,
-                                                                 offset, true);
-                                offset += 8;
-                            }
-                            if (type == 0) {  // mz
-                                mzs[i] = value;
-                                if (value < min_mz || value > max_mz) {
-                                    filter_points[i] = true;
-                                }
-                            }
-                            if (type == 1) {  // intensity
-                                intensities[i] = value;
-                                if (value == 0.0) {
-                                    filter_points[i] = true;
-                                }
-                            }
-                        }
+                    if (accession == "MS:1000521") {
+                        precision = 32;
+                    }
+                    // Compression.
+                    if (accession == "MS:1000574") {
+                        compressed = true;
                     }
+                    // Type of vector.
+                    if (accession == "MS:1000514") {
+                        type = 0;
+                    }
+                    if (accession == "MS:1000515") {
+                        type = 1;
+                    }
+                }
+                if (tag->name == "binary" && !tag->closed) {
+                    data = XmlReader::read_data(cursor);
                 }
             }
+            // The MS level is described before the binary data, so we can
+            // avoid decoding the arrays of the scans we are not interested in.
+            if (data && scan.ms_level != 0 &&
+                !is_requested_level(scan.ms_level)) {
+                continue;
+            }
+            if (data) {
+                // Decode data, the decompressed length is unknown.
+                auto binary_data =
+                    decode_binary_data(context, data.value(), compressed, 0);
+                if (!binary_data) {
+                    return std::nullopt;
+                }
 
-            // Filter mzs not in range and intensity == 0 scans and calculate
-            // max_intensity and total_intensity.
-            double intensity_sum = 0;
-            double max_intensity = 0;
-            for (size_t i = 0; i < filter_points.size(); ++i) {
-                if (filter_points[i]) {
-                    continue;
+                // mzML binary data is always little endian.
+                if (type == 0) {  // mz
+                    Base64::interpret_values(binary_data->data(),
+                                             binary_data->size(), precision,
+                                             true, mzs);
                 }
-                scan.mz.push_back(mzs[i]);
-                scan.intensity.push_back(intensities[i]);
-                if (intensities[i] > max_intensity) {
-                    max_intensity = intensities[i];
+                if (type == 1) {  // intensity
+                    Base64::interpret_values(binary_data->data(),
+                                             binary_data->size(), precision,
+                                             true, intensities);
                 }
-                intensity_sum += intensities[i];
             }
-            scan.num_points = scan.mz.size();
-            scan.max_intensity = max_intensity;
-            scan.total_intensity = intensity_sum;
+        }
+    }
+
+    // Filter mzs not in range and intensity == 0 scans and calculate
+    // max_intensity and total_intensity.
+    scan.mz = std::move(mzs);
+    scan.intensity = std::move(intensities);
+    filter_peaks(scan, min_mz, max_mz);
+
+    // TODO: Assert that mz.size() == intenstiy.size()
+    if (!is_requested_level(scan.ms_level)) {
+        scan = {};
+    }
+    return scan;
+}
+
+std::optional<RawData::RawData> XmlReader::read_mzml(
+    std::string_view buffer, double min_mz, double max_mz, double min_rt,
+    double max_rt, Instrument::Type instrument_type, double resolution_ms1,
+    double resolution_msn, double reference_mz, Polarity::Type polarity,
+    size_t ms_level) {
+    return read_mzml(buffer, min_mz, max_mz, min_rt, max_rt, instrument_type,
+                     resolution_ms1, resolution_msn, reference_mz, polarity,
+                     ms_level, 1);
+}
+
+std::optional<RawData::RawData> XmlReader::read_mzml(
+    std::istream &stream, double min_mz, double max_mz, double min_rt,
+    double max_rt, Instrument::Type instrument_type, double resolution_ms1,
+    double resolution_msn, double reference_mz, Polarity::Type polarity,
+    size_t ms_level) {
+    auto buffer = read_stream(stream);
+    return read_mzml(buffer, min_mz, max_mz, min_rt, max_rt, instrument_type,
+                     resolution_ms1, resolution_msn, reference_mz, polarity,
+                     ms_level);
+}
 
-            // TODO: Assert that mz.size() == intenstiy.size()
-            if (scan.ms_level == 0 || scan.ms_level != ms_level) {
-                scan = {};
+// Read the spectrum offsets from the <indexList> at the end of an indexed mzML
+// file. Returns std::nullopt if the index is missing or doesn't match the
+// contents of the buffer.
+static std::optional<std::vector<size_t>> read_mzml_index(
+    std::string_view buffer) {
+    size_t index_list_offset_position = buffer.rfind("<indexListOffset>");
+    if (index_list_offset_position == std::string_view::npos) {
+        return std::nullopt;
+    }
+    auto cursor = XmlReader::Cursor{buffer, index_list_offset_position};
+    XmlReader::read_tag(cursor);
+    auto data = XmlReader::read_data(cursor);
+    size_t index_list_offset = 0;
+    if (!data || !parse_int(data.value(), index_list_offset) ||
+        index_list_offset >= index_list_offset_position) {
+        return std::nullopt;
+    }
+
+    // Read the offsets of the spectrum index.
+    std::vector<size_t> offsets;
+    bool spectrum_index = false;
+    cursor.position = index_list_offset;
+    while (cursor.good()) {
+        auto tag = XmlReader::read_tag(cursor);
+        if (!tag) {
+            continue;
+        }
+        if (tag->name == "indexList" && tag->closed) {
+            break;
+        }
+        if (tag->name == "index") {
+            if (tag->closed) {
+                if (spectrum_index) {
+                    break;
+                }
+                continue;
             }
+            spectrum_index = tag->attribute("name") == "spectrum";
         }
+        if (spectrum_index && tag->name == "offset" && !tag->closed) {
+            auto data = XmlReader::read_data(cursor);
+            size_t offset = 0;
+            if (!data || !parse_int(data.value(), offset)) {
+                return std::nullopt;
+            }
+            offsets.push_back(offset);
+        }
+    }
 
-        // Update RawData.
-        if (scan.num_points != 0) {
-            if (scan.retention_time < min_rt) {
+    // Some converters write incorrect offsets, make sure that every offset
+    // points to the beginning of a spectrum tag.
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        size_t offset = offsets[i];
+        if ((i > 0 && offset <= offsets[i - 1]) ||
+            offset + 10 > buffer.size() ||
+            buffer.compare(offset, 9, "<spectrum") != 0 ||
+            !(std::isspace(static_cast<uint8_t>(buffer[offset + 9])) ||
+              buffer[offset + 9] == '>')) {
+            return std::nullopt;
+        }
+    }
+    return offsets;
+}
+
+std::vector<size_t> XmlReader::find_mzml_spectrum_offsets(
+    std::string_view buffer) {
+    auto index = read_mzml_index(buffer);
+    if (index) {
+        return index.value();
+    }
+
+    // No valid index was found, we need to find the spectrum tags manually.
+    // The base64 encoded data can't contain a '<' character, so we can look
+    // for the beginning of the tags directly.
+    std::vector<size_t> offsets;
+    size_t position = buffer.find("<spectrumList");
+    while (position != std::string_view::npos) {
+        position = buffer.find("<spectrum", position + 1);
+        if (position == std::string_view::npos ||
+            position + 9 >= buffer.size()) {
+            break;
+        }
+        char next = buffer[position + 9];
+        if (std::isspace(static_cast<uint8_t>(next)) || next == '>') {
+            offsets.push_back(position);
+        }
+    }
+    return offsets;
+}
+
+std::optional<RawData::RawData> XmlReader::read_mzml(
+    std::string_view buffer, double min_mz, double max_mz, double min_rt,
+    double max_rt, Instrument::Type instrument_type, double resolution_ms1,
+    double resolution_msn, double reference_mz, Polarity::Type polarity,
+    size_t ms_level, size_t max_threads) {
+    auto raw_data = read_mzml_levels(buffer, min_mz, max_mz, min_rt, max_rt,
+                                     instrument_type, resolution_ms1,
+                                     resolution_msn, reference_mz, polarity,
+                                     {ms_level}, max_threads);
+    if (!raw_data) {
+        return std::nullopt;
+    }
+    return std::move(raw_data->front());
+}
+
+std::optional<std::vector<RawData::RawData>> XmlReader::read_mzml_levels(
+    std::string_view buffer, double min_mz, double max_mz, double min_rt,
+    double max_rt, Instrument::Type instrument_type, double resolution_ms1,
+    double resolution_msn, double reference_mz, Polarity::Type polarity,
+    const std::vector<size_t> &ms_levels, size_t max_threads) {
+    auto raw_data = std::vector<RawData::RawData>(
+        ms_levels.size(), empty_raw_data(instrument_type, resolution_ms1,
+                                         resolution_msn, reference_mz));
+
+    // Add a parsed scan to the RawData of its MS level. Returns false if
+    // reading should stop, once a scan past max_rt is found.
+    auto add_scan = [&](RawData::Scan &scan) {
+        if (scan.retention_time > max_rt) {
+            return false;
+        }
+        if (scan.num_points == 0 || scan.retention_time < min_rt) {
+            return true;
+        }
+        size_t level_index = std::find(ms_levels.begin(), ms_levels.end(),
+                                       scan.ms_level) -
+                             ms_levels.begin();
+        append_scan(raw_data[level_index], std::move(scan));
+        return true;
+    };
+
+    // The number of threads is limited by the size of the shared pool.
+    uint64_t num_threads = ThreadPool::shared_pool().size() + 1;
+    if (num_threads > max_threads) {
+        num_threads = max_threads;
+    }
+    if (num_threads <= 1) {
+        auto cursor = Cursor{buffer, 0};
+        DecodeContext context;
+        while (cursor.good()) {
+            auto tag = XmlReader::read_tag(cursor);
+            if (!tag) {
                 continue;
             }
-            if (scan.retention_time > max_rt) {
+            if (tag->name == "spectrumList" && tag->closed) {
                 break;
             }
-            raw_data.scans.push_back(scan);
-            raw_data.retention_times.push_back(scan.retention_time);
-            if (scan.retention_time < raw_data.min_rt) {
-                raw_data.min_rt = scan.retention_time;
-            }
-            if (scan.retention_time > raw_data.max_rt) {
-                raw_data.max_rt = scan.retention_time;
-            }
-            if (scan.mz[0] < raw_data.min_mz) {
-                raw_data.min_mz = scan.mz[0];
-            }
-            if (scan.mz[scan.mz.size() - 1] > raw_data.max_mz) {
-                raw_data.max_mz = scan.mz[scan.mz.size() - 1];
+            if (tag->name == "spectrum" && !tag->closed) {
+                auto scan = parse_mzml_spectrum(
+                    cursor, tag.value(), context, min_mz, max_mz, min_rt,
+                    max_rt, polarity, ms_levels);
+                if (!scan) {
+                    return raw_data;
+                }
+                if (!add_scan(scan.value())) {
+                    break;
+                }
             }
         }
+        return raw_data;
     }
 
+    // Each spectrum is decoded independently into its own slot, keeping the
+    // order of the file. The spectra are decoded in chunks on the shared pool,
+    // with one decoding context per chunk. The spectra after the first one
+    // found past max_rt are not needed, so they are skipped.
+    auto offsets = find_mzml_spectrum_offsets(buffer);
+    std::vector<std::optional<RawData::Scan>> scans(offsets.size());
+    std::atomic<size_t> stop_index = offsets.size();
+    ThreadPool::parallel_for(
+        offsets.size(), num_threads, [&](size_t begin, size_t end) {
+            DecodeContext context;
+            for (size_t k = begin; k < end && k < stop_index; ++k) {
+                auto cursor = Cursor{buffer, offsets[k]};
+                auto tag = XmlReader::read_tag(cursor);
+                if (!tag || tag->name != "spectrum" || tag->closed) {
+                    scans[k] = RawData::Scan{};
+                    continue;
+                }
+                scans[k] = parse_mzml_spectrum(cursor, tag.value(), context,
+                                               min_mz, max_mz, min_rt, max_rt,
+                                               polarity, ms_levels);
+                if (scans[k] && scans[k]->retention_time > max_rt) {
+                    size_t index = stop_index;
+                    while (k < index &&
+                           !stop_index.compare_exchange_weak(index, k)) {
+                    }
+                }
+            }
+        });
+
+    // Merge the scans in file order, as in the serial version. The skipped
+    // spectra come after the first scan past max_rt, so they are never
+    // reached.
+    for (auto &scan : scans) {
+        if (!scan) {
+            return raw_data;
+        }
+        if (!add_scan(scan.value())) {
+            break;
+        }
+    }
     return raw_data;
 }
 
+static bool is_space(char c) { return std::isspace(static_cast<uint8_t>(c)); }
+
+// Reads the attribute of the tag contents starting at position i, advancing it
+// past the attribute. The name is left empty if there are no more attributes.
+// Returns false if the attribute is malformed.
+static bool read_attribute(std::string_view contents, size_t &i,
+                           XmlReader::TagView::Attribute &attribute) {
+    attribute = {};
+    while (i < contents.size() && is_space(contents[i])) {
+        ++i;
+    }
+    size_t equals = contents.find('=', i);
+    // No more attributes, or malformed xml.
+    if (i == contents.size() || equals == std::string_view::npos) {
+        i = contents.size();
+        return true;
+    }
+    size_t name_end = equals;
+    while (name_end > i && is_space(contents[name_end - 1])) {
+        --name_end;
+    }
+    auto name = contents.substr(i, name_end - i);
+
+    // Find attribute value.
+    size_t value_begin = equals + 1;
+    while (value_begin < contents.size() && is_space(contents[value_begin])) {
+        ++value_begin;
+    }
+    if (value_begin == contents.size() ||
+        (contents[value_begin] != '"' && contents[value_begin] != '\'')) {
+        return false;
+    }
+    char quote = contents[value_begin];
+    size_t value_end = value_begin + 1;
+    while (value_end < contents.size() && contents[value_end] != quote) {
+        if (contents[value_end] == '\\') {
+            ++value_end;
+        }
+        ++value_end;
+    }
+    // Malformed xml.
+    if (value_end >= contents.size()) {
+        return false;
+    }
+    attribute.name = name;
+    attribute.value =
+        contents.substr(value_begin + 1, value_end - value_begin - 1);
+    i = value_end + 1;
+    return true;
+}
+
+std::optional<XmlReader::TagView> XmlReader::read_tag(Cursor &cursor) {
+    if (!cursor.good()) {
+        return std::nullopt;
+    }
+    auto buffer = cursor.buffer;
+
+    // Find the boundaries of the tag contents.
+    size_t begin = buffer.find('<', cursor.position);
+    if (begin == std::string_view::npos) {
+        cursor.position = buffer.size();
+        return std::nullopt;
+    }
+    size_t end = buffer.find('>', begin + 1);
+    if (end == std::string_view::npos) {
+        cursor.position = buffer.size();
+        return std::nullopt;
+    }
+    cursor.position = end + 1;
+    auto contents = buffer.substr(begin + 1, end - begin - 1);
+    if (contents.empty()) {
+        return std::nullopt;
+    }
+
+    auto tag = std::optional<TagView>(TagView{});
+    tag->num_attributes = 0;
+    tag->closed = false;
+    tag->truncated = false;
+
+    // Check if this is a closing tag for a previous one.
+    if (contents[0] == '/') {
+        tag->closed = true;
+        size_t end_name = 1;
+        while (end_name < contents.size() && !is_space(contents[end_name])) {
+            ++end_name;
+        }
+        tag->name = contents.substr(1, end_name - 1);
+        return tag;
+    }
+
+    // Check if this is a self-closing tag.
+    if (contents.back() == '/') {
+        contents.remove_suffix(1);
+        tag->closed = true;
+    }
+
+    // Read tag name
+    size_t i = 1;
+    while (i < contents.size() && !is_space(contents[i])) {
+        ++i;
+    }
+    tag->name = contents.substr(0, i);
+
+    // Read attributes
+    while (true) {
+        size_t attribute_begin = i;
+        TagView::Attribute attribute;
+        if (!read_attribute(contents, i, attribute)) {
+            return std::nullopt;
+        }
+        if (attribute.name.empty()) {
+            break;
+        }
+        if (tag->num_attributes < TagView::MAX_ATTRIBUTES) {
+            tag->attributes[tag->num_attributes++] = attribute;
+        } else if (!tag->truncated) {
+            tag->truncated = true;
+            tag->remaining_attributes = contents.substr(attribute_begin);
+        }
+    }
+
+    return tag;
+}
+
+std::optional<std::string_view> XmlReader::read_data(Cursor &cursor) {
+    if (!cursor.good()) {
+        return std::nullopt;
+    }
+    auto buffer = cursor.buffer;
+    size_t end = buffer.find('<', cursor.position);
+    if (end == std::string_view::npos) {
+        cursor.position = buffer.size();
+        return std::nullopt;
+    }
+    auto data = buffer.substr(cursor.position, end - cursor.position);
+    cursor.position = end + 1;
+    if (data.empty()) {
+        return std::nullopt;
+    }
+
+    // Trim potential whitespace at the beginning of the data string.
+    size_t i = 0;
+    while (i < data.size() && std::isspace(static_cast<uint8_t>(data[i]))) {
+        ++i;
+    }
+    return data.substr(i);
+}
+
+std::optional<std::string_view> XmlReader::TagView::attribute(
+    std::string_view name) const {
+    for (size_t i = 0; i < num_attributes; ++i) {
+        if (attributes[i].name == name) {
+            return attributes[i].value;
+        }
+    }
+    // The remaining attributes were already validated by read_tag.
+    size_t i = 0;
+    while (truncated) {
+        TagView::Attribute attribute;
+        read_attribute(remaining_attributes, i, attribute);
+        if (attribute.name.empty()) {
+            break;
+        }
+        if (attribute.name == name) {
+            return attribute.value;
+        }
+    }
+    return std::nullopt;
+}
+
 std::optional<std::string> XmlReader::read_data(std::istream &stream) {
     std::string data;
     std::getline(stream, data, '<');
@@ -827,231 +1420,269 @@ std::optional<XmlReader::Tag> XmlReader::read_tag(std::istream &stream) {
     return tag;
 }
 
-IdentData::IdentData XmlReader::read_mzidentml(std::istream &stream,
+// Read the attributes shared by the Modification and SubstitutionModification
+// tags of a mzIdentML Peptide.
+static IdentData::PeptideModification parse_modification(
+    const XmlReader::TagView &tag) {
+    auto modification = IdentData::PeptideModification{};
+    if (auto value = tag.attribute("monoisotopicMassDelta")) {
+        parse_double(value.value(), modification.monoisotopic_mass_delta);
+    }
+    if (auto value = tag.attribute("avgMassDelta")) {
+        parse_double(value.value(), modification.average_mass_delta);
+    }
+    if (auto value = tag.attribute("residues")) {
+        modification.residues = value.value();
+    }
+    modification.location = -1;
+    if (auto value = tag.attribute("location")) {
+        parse_int(value.value(), modification.location);
+    }
+    return modification;
+}
+
+IdentData::IdentData XmlReader::read_mzidentml(std::string_view buffer,
                                                bool ignore_decoy,
                                                bool require_threshold,
                                                bool max_rank_only,
                                                double min_mz, double max_mz,
                                                double min_rt, double max_rt) {
     IdentData::IdentData ident_data = {};
+    auto cursor = Cursor{buffer, 0};
+
+    // All ids are interned into the pool of ident_data. The references between
+    // elements are resolved while parsing, using the index of the DBSequence
+    // and Peptide with each id of the pool. The SequenceCollection lists the
+    // DBSequences and Peptides before the PeptideEvidence, and it comes before
+    // the AnalysisData with the SpectrumIdentificationItems, so the referenced
+    // elements are always known when a reference is read.
+    IdentData::IdInterner interner(ident_data.ids);
+    std::vector<uint64_t> db_sequence_indices;
+    std::vector<uint64_t> peptide_indices;
+    auto add_index = [](std::vector<uint64_t> &indices, uint64_t id,
+                        uint64_t index) {
+        if (id >= indices.size()) {
+            indices.resize(id + 1, IdentData::NO_INDEX);
+        }
+        if (indices[id] == IdentData::NO_INDEX) {
+            indices[id] = index;
+        }
+    };
+    auto find_index = [](const std::vector<uint64_t> &indices, uint64_t id) {
+        return id < indices.size() ? indices[id] : IdentData::NO_INDEX;
+    };
 
     // Find the DBSequences, Peptides and PeptideEvidence in the
     // SequenceCollection tag.
-    while (stream.good() && !stream.eof()) {
-        auto tag = XmlReader::read_tag(stream);
+    while (cursor.good()) {
+        auto tag = XmlReader::read_tag(cursor);
         if (!tag) {
             continue;
         }
-        if (tag.value().name == "SequenceCollection" && tag.value().closed) {
+        if (tag->name == "SequenceCollection" && tag->closed) {
             break;
         }
-        if (tag.value().name == "DBSequence") {
-            auto attributes = tag.value().attributes;
-            if (attributes.empty()) {
+        if (tag->name == "DBSequence") {
+            if (tag->num_attributes == 0) {
                 continue;
             }
             IdentData::DBSequence db_sequence = {};
-            db_sequence.id = attributes["id"];
-            db_sequence.accession = attributes["accession"];
-            db_sequence.db_reference = attributes["searchDatabase_ref"];
-            if (!tag.value().closed) {
+            db_sequence.id = interner.intern(tag->attribute("id").value_or(""));
+            db_sequence.accession = tag->attribute("accession").value_or("");
+            db_sequence.db_reference =
+                tag->attribute("searchDatabase_ref").value_or("");
+            if (!tag->closed) {
                 // Check if the DBSequence contains the protein description as a
                 // cvParam tag.
-                while (stream.good() && !stream.eof()) {
-                    auto tag = XmlReader::read_tag(stream);
+                while (cursor.good()) {
+                    auto tag = XmlReader::read_tag(cursor);
                     if (!tag) {
                         continue;
                     }
-                    if (tag.value().name == "DBSequence" &&
-                        tag.value().closed) {
+                    if (tag->name == "DBSequence" && tag->closed) {
                         break;
                     }
-                    auto attributes = tag.value().attributes;
-                    if (tag.value().name == "cvParam" &&
-                        attributes["accession"] == "MS:1001088") {
-                        db_sequence.description = attributes["value"];
+                    if (tag->name == "cvParam" &&
+                        tag->attribute("accession") == "MS:1001088") {
+                        db_sequence.description =
+                            tag->attribute("value").value_or("");
                     }
                 }
             }
-            ident_data.db_sequences.push_back(db_sequence);
-        } else if (tag.value().name == "Peptide") {
+            add_index(db_sequence_indices, db_sequence.id,
+                      ident_data.db_sequences.size());
+            ident_data.db_sequences.push_back(std::move(db_sequence));
+        } else if (tag->name == "Peptide") {
             IdentData::Peptide peptide = {};
-            auto attributes = tag.value().attributes;
-            peptide.id = attributes["id"];
+            peptide.id = interner.intern(tag->attribute("id").value_or(""));
             // Find peptide sequence and modifications.
-            while (stream.good() && !stream.eof()) {
-                auto tag = XmlReader::read_tag(stream);
+            while (cursor.good()) {
+                auto tag = XmlReader::read_tag(cursor);
                 if (!tag) {
                     continue;
                 }
-                if (tag.value().name == "Peptide" && tag.value().closed) {
+                if (tag->name == "Peptide" && tag->closed) {
                     break;
                 }
-                if (tag.value().name == "PeptideSequence" &&
-                    !tag.value().closed) {
-                    auto data = XmlReader::read_data(stream);
+                if (tag->name == "PeptideSequence" && !tag->closed) {
+                    auto data = XmlReader::read_data(cursor);
                     if (!data) {
                         return {};
-                        break;
                     }
                     peptide.sequence = data.value();
                 }
                 // Search peptide modifications.
-                if (tag.value().name == "Modification" && !tag.value().closed) {
+                if (tag->name == "Modification" && !tag->closed) {
                     // Save modification info.
-                    auto attributes = tag.value().attributes;
-                    auto modification = IdentData::PeptideModification{};
-                    if (attributes.find("monoisotopicMassDelta") !=
-                        attributes.end()) {
-                        modification.monoisotopic_mass_delta =
-                            std::stod(attributes["monoisotopicMassDelta"]);
-                    }
-                    if (attributes.find("avgMassDelta") != attributes.end()) {
-                        modification.average_mass_delta =
-                            std::stod(attributes["avgMassDelta"]);
-                    }
-                    if (attributes.find("residues") != attributes.end()) {
-                        modification.residues = attributes["residues"];
-                    }
-                    if (attributes.find("location") != attributes.end()) {
-                        modification.location =
-                            std::stoi(attributes["location"]);
-                    } else {
-                        modification.location = -1;
-                    }
+                    auto modification = parse_modification(tag.value());
                     // Find identification information for this modification.
-                    while (stream.good() && !stream.eof()) {
-                        auto tag = XmlReader::read_tag(stream);
+                    while (cursor.good()) {
+                        auto tag = XmlReader::read_tag(cursor);
                         if (!tag) {
                             continue;
                         }
-                        if (tag.value().name == "Modification" &&
-                            tag.value().closed) {
-                            peptide.modifications.push_back(modification);
+                        if (tag->name == "Modification" && tag->closed) {
                             break;
                         }
-                        if (tag.value().name == "cvParam") {
-                            auto attributes = tag.value().attributes;
-                            modification.id.push_back(attributes["accession"] +
-                                                      "|" + attributes["name"]);
+                        if (tag->name == "cvParam") {
+                            auto accession =
+                                tag->attribute("accession").value_or("");
+                            auto name = tag->attribute("name").value_or("");
+                            std::string modification_id;
+                            modification_id.reserve(accession.size() + 1 +
+                                                    name.size());
+                            modification_id.append(accession);
+                            modification_id += '|';
+                            modification_id.append(name);
+                            modification.id.push_back(
+                                std::move(modification_id));
                         }
                     }
-                    peptide.modifications.push_back(modification);
-                } else if (tag.value().name == "SubstitutionModification") {
+                    peptide.modifications.push_back(std::move(modification));
+                } else if (tag->name == "SubstitutionModification") {
                     // Save modification info.
-                    auto attributes = tag.value().attributes;
-                    auto modification = IdentData::PeptideModification{};
-                    if (attributes.find("monoisotopicMassDelta") !=
-                        attributes.end()) {
-                        modification.monoisotopic_mass_delta =
-                            std::stod(attributes["monoisotopicMassDelta"]);
-                    }
-                    if (attributes.find("avgMassDelta") != attributes.end()) {
-                        modification.average_mass_delta =
-                            std::stod(attributes["avgMassDelta"]);
-                    }
-                    if (attributes.find("residues") != attributes.end()) {
-                        modification.residues = attributes["residues"];
-                    }
-                    if (attributes.find("location") != attributes.end()) {
-                        modification.location =
-                            std::stoi(attributes["location"]);
-                    } else {
-                        modification.location = -1;
-                    }
-                    modification.id.push_back(
-                        "SUBSTITUTION|" + attributes["originalResidue"] + "->" +
-                        attributes["replacementResidue"]);
-                    peptide.modifications.push_back(modification);
+                    auto modification = parse_modification(tag.value());
+                    std::string modification_id = "SUBSTITUTION|";
+                    modification_id.append(
+                        tag->attribute("originalResidue").value_or(""));
+                    modification_id += "->";
+                    modification_id.append(
+                        tag->attribute("replacementResidue").value_or(""));
+                    modification.id.push_back(std::move(modification_id));
+                    peptide.modifications.push_back(std::move(modification));
                 }
             }
-            ident_data.peptides.push_back(peptide);
-        } else if (tag.value().name == "PeptideEvidence") {
-            IdentData::PeptideEvidence peptide_evidence;
-            auto attributes = tag.value().attributes;
-            peptide_evidence.id = attributes["id"];
-            peptide_evidence.db_sequence_id = attributes["dBSequence_ref"];
-            peptide_evidence.peptide_id = attributes["peptide_ref"];
-            peptide_evidence.decoy = false;
-            if (attributes.find("isDecoy") != attributes.end()) {
-                peptide_evidence.decoy = attributes["isDecoy"] == "true";
+            add_index(peptide_indices, peptide.id, ident_data.peptides.size());
+            ident_data.peptides.push_back(std::move(peptide));
+        } else if (tag->name == "PeptideEvidence") {
+            // Skip the closing tag of non self-closing PeptideEvidence tags.
+            if (tag->num_attributes == 0) {
+                continue;
             }
+            IdentData::PeptideEvidence peptide_evidence = {};
+            peptide_evidence.decoy = tag->attribute("isDecoy") == "true";
             if (ignore_decoy && peptide_evidence.decoy) {
                 continue;
             }
-            ident_data.peptide_evidence.push_back(peptide_evidence);
+            peptide_evidence.id =
+                interner.intern(tag->attribute("id").value_or(""));
+            peptide_evidence.db_sequence_id =
+                interner.intern(tag->attribute("dBSequence_ref").value_or(""));
+            peptide_evidence.peptide_id =
+                interner.intern(tag->attribute("peptide_ref").value_or(""));
+            peptide_evidence.db_sequence_index = find_index(
+                db_sequence_indices, peptide_evidence.db_sequence_id);
+            peptide_evidence.peptide_index =
+                find_index(peptide_indices, peptide_evidence.peptide_id);
+            ident_data.peptide_evidence.push_back(std::move(peptide_evidence));
         }
     }
 
-    // Find the PSMs for this data (SpectrumIdentificationResult).
-    while (stream.good() && !stream.eof()) {
-        auto tag = XmlReader::read_tag(stream);
+    // Find the PSMs for this data (SpectrumIdentificationResult). The ids of
+    // the provisional spectrum_matches are only interned if they are kept.
+    std::vector<IdentData::SpectrumMatch> spectrum_matches;
+    std::vector<std::pair<std::string_view, std::string_view>>
+        spectrum_match_ids;
+    auto add_spectrum_match = [&](size_t i) {
+        auto &spectrum_match = spectrum_matches[i];
+        spectrum_match.id = interner.intern(spectrum_match_ids[i].first);
+        spectrum_match.match_id = interner.intern(spectrum_match_ids[i].second);
+        spectrum_match.match_index =
+            find_index(peptide_indices, spectrum_match.match_id);
+        ident_data.spectrum_matches.push_back(std::move(spectrum_match));
+    };
+    while (cursor.good()) {
+        auto tag = XmlReader::read_tag(cursor);
         if (!tag) {
             continue;
         }
-        if (tag.value().name == "SpectrumIdentificationList" &&
-            tag.value().closed) {
+        if (tag->name == "SpectrumIdentificationList" && tag->closed) {
             break;
         }
         // Find the next SpectrumIdentificationResult.
-        if (tag.value().name != "SpectrumIdentificationResult") {
+        if (tag->name != "SpectrumIdentificationResult") {
             continue;
         }
 
         // Record all SpectrumIdentificationItems for this result.
-        std::vector<IdentData::SpectrumMatch> spectrum_matches;
+        spectrum_matches.clear();
+        spectrum_match_ids.clear();
         double retention_time = 0.0;
-        while (stream.good() && !stream.eof()) {
-            tag = XmlReader::read_tag(stream);
+        while (cursor.good()) {
+            tag = XmlReader::read_tag(cursor);
             if (!tag) {
                 continue;
             }
-            if (tag.value().name == "SpectrumIdentificationResult" &&
-                tag.value().closed) {
+            if (tag->name == "SpectrumIdentificationResult" && tag->closed) {
                 break;
             }
-            auto attributes = tag.value().attributes;
 
-            if (tag.value().name == "cvParam") {
+            if (tag->name == "cvParam") {
                 // Retention time or scan start time.
-                if (attributes["accession"] == "MS:1000894" ||
-                    attributes["accession"] == "MS:1000016") {
-                    retention_time = std::stod(attributes["value"]);
+                auto accession = tag->attribute("accession");
+                if (accession == "MS:1000894" || accession == "MS:1000016") {
+                    parse_double(tag->attribute("value").value_or(""),
+                                 retention_time);
                     // If the retention time is in minutes, we convert it back
                     // to seconds.
-                    if (attributes["unitAccession"] == "UO:0000031") {
+                    if (tag->attribute("unitAccession") == "UO:0000031") {
                         retention_time *= 60.0;
                     }
                 }
             }
 
             // Identification item.
-            if (tag.value().name == "SpectrumIdentificationItem" &&
-                !tag.value().closed) {
+            if (tag->name == "SpectrumIdentificationItem" && !tag->closed) {
                 IdentData::SpectrumMatch spectrum_match = {};
-                spectrum_match.id = attributes["id"];
                 spectrum_match.pass_threshold =
-                    attributes["passThreshold"] == "true";
+                    tag->attribute("passThreshold") == "true";
                 if (require_threshold && !spectrum_match.pass_threshold) {
                     continue;
                 }
-                spectrum_match.match_id = attributes["peptide_ref"];
-                spectrum_match.charge_state =
-                    std::stoi(attributes["chargeState"]);
-                spectrum_match.experimental_mz =
-                    std::stod(attributes["experimentalMassToCharge"]);
+                // The charge state, experimental m/z and rank are required.
+                int charge_state = 0;
+                if (!parse_int(tag->attribute("chargeState").value_or(""),
+                               charge_state) ||
+                    !parse_double(
+                        tag->attribute("experimentalMassToCharge")
+                            .value_or(""),
+                        spectrum_match.experimental_mz) ||
+                    !parse_int(tag->attribute("rank").value_or(""),
+                               spectrum_match.rank)) {
+                    continue;
+                }
+                spectrum_match.charge_state = charge_state;
                 spectrum_match.retention_time = 0;
-                spectrum_match.rank = std::stoi(attributes["rank"]);
                 // Might be optional according to the mzIdentML v1.2.0 spec.
-                if (attributes.find("calculatedMassToCharge") !=
-                    attributes.end()) {
-                    spectrum_match.theoretical_mz =
-                        std::stod(attributes["calculatedMassToCharge"]);
-                } else {
-                    spectrum_match.theoretical_mz = 0.0;
+                spectrum_match.theoretical_mz = 0.0;
+                if (auto value = tag->attribute("calculatedMassToCharge")) {
+                    parse_double(value.value(), spectrum_match.theoretical_mz);
                 }
 
-                spectrum_matches.push_back(spectrum_match);
+                spectrum_matches.push_back(std::move(spectrum_match));
+                spectrum_match_ids.emplace_back(
+                    tag->attribute("id").value_or(""),
+                    tag->attribute("peptide_ref").value_or(""));
             }
         }
 
@@ -1059,37 +1690,50 @@ IdentData::IdentData XmlReader::read_mzidentml(std::istream &stream,
             if (spectrum_matches.empty()) {
                 continue;
             }
-            IdentData::SpectrumMatch selected_spectrum = {};
             // Update retention time on the provisional spectrum_matches list
             // and find the maximum rank spectrum. The rank is in descending
             // order of importance, thus rank 1 is the maximum, and bigger
             // numbers are worse.
+            size_t selected = 0;
             for (size_t i = 0; i < spectrum_matches.size(); ++i) {
                 auto &spectrum_match = spectrum_matches[i];
                 spectrum_match.retention_time = retention_time;
-                if (i == 0 || spectrum_match.rank < selected_spectrum.rank) {
-                    selected_spectrum = spectrum_match;
+                if (spectrum_match.rank < spectrum_matches[selected].rank) {
+                    selected = i;
                 }
             }
+            const auto &selected_spectrum = spectrum_matches[selected];
             if (selected_spectrum.experimental_mz >= min_mz &&
                 selected_spectrum.experimental_mz <= max_mz &&
                 selected_spectrum.retention_time >= min_rt &&
                 selected_spectrum.retention_time <= max_rt) {
-                ident_data.spectrum_matches.push_back(selected_spectrum);
+                add_spectrum_match(selected);
             }
         } else {
             // Update retention time on the provisional spectrum_matches list
             // and push each element to the list of PSM.
-            for (auto &spectrum_match : spectrum_matches) {
+            for (size_t i = 0; i < spectrum_matches.size(); ++i) {
+                auto &spectrum_match = spectrum_matches[i];
                 spectrum_match.retention_time = retention_time;
                 if (spectrum_match.experimental_mz >= min_mz &&
                     spectrum_match.experimental_mz <= max_mz &&
                     spectrum_match.retention_time >= min_rt &&
                     spectrum_match.retention_time <= max_rt) {
-                    ident_data.spectrum_matches.push_back(spectrum_match);
+                    add_spectrum_match(i);
                 }
             }
         }
     }
     return ident_data;
 }
+
+IdentData::IdentData XmlReader::read_mzidentml(std::istream &stream,
+                                               bool ignore_decoy,
+                                               bool require_threshold,
+                                               bool max_rank_only,
+                                               double min_mz, double max_mz,
+                                               double min_rt, double max_rt) {
+    auto buffer = read_stream(stream);
+    return read_mzidentml(buffer, ignore_decoy, require_threshold,
+                          max_rank_only, min_mz, max_mz, min_rt, max_rt);
+}
@@ -3,6 +3,7 @@
 
 #include <map>
 #include <optional>
+#include <string_view>
 
 #include "raw_data/raw_data.hpp"
 
@@ -25,25 +26,129 @@ std::optional<Tag> read_tag(std::istream &stream);
 // necessary.
 std::optional<std::string> read_data(std::istream &stream);
 
+// A non-owning view of an xml tag. The name and attribute views point into the
+// buffer the tag was read from and are only valid while that buffer is alive.
+// Attributes are stored in a small flat array instead of a map to avoid
+// allocations. Tags with more than MAX_ATTRIBUTES attributes are marked as
+// truncated, and the remaining attributes are parsed again from the buffer
+// when looked up.
+struct TagView {
+    static constexpr size_t MAX_ATTRIBUTES = 32;
+    struct Attribute {
+        std::string_view name;
+        std::string_view value;
+    };
+    std::string_view name;
+    Attribute attributes[MAX_ATTRIBUTES];
+    size_t num_attributes;
+    bool closed;
+
+    // Set if the attribute array is full. The attributes that didn't fit start
+    // at remaining_attributes.
+    bool truncated;
+    std::string_view remaining_attributes;
+
+    // Returns the value of the given attribute if present on this tag.
+    std::optional<std::string_view> attribute(std::string_view name) const;
+};
+
+// A read position on an in-memory xml document, for example a memory mapped
+// file (See MappedFile::File).
+struct Cursor {
+    std::string_view buffer;
+    size_t position;
+
+    bool good() const { return position < buffer.size(); }
+};
+
+// Reads the contents of the next tag in the buffer, advancing the cursor.
+std::optional<TagView> read_tag(Cursor &cursor);
+
+// Read data until the next tag is found and trim whitespace at the beginning
+// if necessary. As with the stream version, the opening '<' of the next tag is
+// consumed.
+std::optional<std::string_view> read_data(Cursor &cursor);
+
+// Parse an xs:duration value (For example "PT1H2M3.5S") into seconds. Only the
+// day and time components are supported, as years and months don't have a
+// fixed length. Returns std::nullopt if the value is malformed.
+std::optional<double> parse_duration(std::string_view duration);
+
 // Read an entire mzxml file into the RawData::RawData data structure filtering
 // based on min/max mz/rt and polarity.
+std::optional<RawData::RawData> read_mzxml(
+    std::string_view buffer, double min_mz, double max_mz, double min_rt,
+    double max_rt, Instrument::Type instrument_type, double resolution_ms1,
+    double resolution_msn, double reference_mz, Polarity::Type polarity,
+    size_t ms_level);
+
+// Same as above, but the remainder of the stream is first read into memory.
+// Prefer the buffer version with a MappedFile::File for large files.
 std::optional<RawData::RawData> read_mzxml(
     std::istream &stream, double min_mz, double max_mz, double min_rt,
     double max_rt, Instrument::Type instrument_type, double resolution_ms1,
     double resolution_msn, double reference_mz, Polarity::Type polarity,
     size_t ms_level);
 
+// Read the scans of several MS levels from an mzXML file in a single pass. The
+// result contains one RawData::RawData per requested level, in the same order
+// as ms_levels, each equal to the one read for that level on its own.
+std::optional<std::vector<RawData::RawData>> read_mzxml_levels(
+    std::string_view buffer, double min_mz, double max_mz, double min_rt,
+    double max_rt, Instrument::Type instrument_type, double resolution_ms1,
+    double resolution_msn, double reference_mz, Polarity::Type polarity,
+    const std::vector<size_t> &ms_levels);
+
 // Read an entire mzML file into the RawData::RawData data structure filtering
 // based on min/max mz/rt and polarity.
+std::optional<RawData::RawData> read_mzml(
+    std::string_view buffer, double min_mz, double max_mz, double min_rt,
+    double max_rt, Instrument::Type instrument_type, double resolution_ms1,
+    double resolution_msn, double reference_mz, Polarity::Type polarity,
+    size_t ms_level);
+
+// Same as above, but the spectra are decoded in parallel using up to
+// max_threads threads. The spectrum offsets are taken from the mzML index if
+// present, otherwise they are found with a scan of the buffer. The result is
+// the same as the serial version.
+std::optional<RawData::RawData> read_mzml(
+    std::string_view buffer, double min_mz, double max_mz, double min_rt,
+    double max_rt, Instrument::Type instrument_type, double resolution_ms1,
+    double resolution_msn, double reference_mz, Polarity::Type polarity,
+    size_t ms_level, size_t max_threads);
+
+// Same as above, but the remainder of the stream is first read into memory.
+// Prefer the buffer version with a MappedFile::File for large files.
 std::optional<RawData::RawData> read_mzml(
     std::istream &stream, double min_mz, double max_mz, double min_rt,
     double max_rt, Instrument::Type instrument_type, double resolution_ms1,
     double resolution_msn, double reference_mz, Polarity::Type polarity,
     size_t ms_level);
 
+// Read the scans of several MS levels from an mzML file in a single pass. The
+// result contains one RawData::RawData per requested level, in the same order
+// as ms_levels, each equal to the one read for that level on its own. As with
+// read_mzml, the spectra are decoded in parallel if max_threads > 1.
+std::optional<std::vector<RawData::RawData>> read_mzml_levels(
+    std::string_view buffer, double min_mz, double max_mz, double min_rt,
+    double max_rt, Instrument::Type instrument_type, double resolution_ms1,
+    double resolution_msn, double reference_mz, Polarity::Type polarity,
+    const std::vector<size_t> &ms_levels, size_t max_threads);
+
+// Find the byte offsets of all the spectrum tags in an mzML buffer.
+std::vector<size_t> find_mzml_spectrum_offsets(std::string_view buffer);
+
 // Read an entire mzIdentML file into a IdentData::IdentData data structure.
+// The references between the identification elements are resolved into
+// indices while parsing (See IdentData::NO_INDEX).
+IdentData::IdentData read_mzidentml(std::string_view buffer, bool ignore_decoy,
+    bool require_threshold, bool max_rank_only, double min_mz, double max_mz,
+    double min_rt, double max_rt);
+
+// Same as above, but the remainder of the stream is first read into memory.
+// Prefer the buffer version with a MappedFile::File for large files.
 IdentData::IdentData read_mzidentml(std::istream &stream, bool ignore_decoy,
-    bool require_threshold, bool max_rank_only, double min_mz, double max_mz, 
+    bool require_threshold, bool max_rank_only, double min_mz, double max_mz,
     double min_rt, double max_rt);
 }  // namespace XmlReader
 
@@ -1,35 +1,38 @@
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <string>
 #include <vector>
 
 #include "utils/base64.hpp"
 
-void Base64::decode_base64(const std::string &input, std::vector<uint8_t> &output) {
-    size_t in_len = input.size();
-
-    size_t out_len = in_len / 4 * 3;
-    if (input[in_len - 1] == '=') {
-        --out_len;
-    }
-    if (input[in_len - 2] == '=') {
-        --out_len;
-    }
-
-    output.resize(out_len);
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BASE64_X86_SIMD
+#include <immintrin.h>
+#endif
 
-    for (size_t i = 0, j = 0; i < in_len; i += 4, j += 3) {
+// Decode full quads (4 characters into 3 bytes) with the translation table.
+// Padding characters are decoded as zero, the caller must take care of not
+// writing the padding bytes into the output.
+static void decode_quads_scalar(const char *input, size_t in_len,
+                                uint8_t *output, size_t out_len) {
+    for (size_t i = 0, j = 0; i + 3 < in_len; i += 4, j += 3) {
         uint8_t a = input[i] == '='
                         ? 0
-                        : translation_table[static_cast<int>(input[i])];
+                        : Base64::translation_table[static_cast<uint8_t>(
+                              input[i])];
         uint8_t b = input[i + 1] == '='
                         ? 0
-                        : translation_table[static_cast<int>(input[i + 1])];
+                        : Base64::translation_table[static_cast<uint8_t>(
+                              input[i + 1])];
         uint8_t c = input[i + 2] == '='
                         ? 0
-                        : translation_table[static_cast<int>(input[i + 2])];
+                        : Base64::translation_table[static_cast<uint8_t>(
+                              input[i + 2])];
         uint8_t d = input[i + 3] == '='
                         ? 0
-                        : translation_table[static_cast<int>(input[i + 3])];
+                        : Base64::translation_table[static_cast<uint8_t>(
+                              input[i + 3])];
 
         if (j < out_len) {
             output[j] = (a << 2) + (b >> 4);
@@ -43,6 +46,187 @@ void Base64::decode_base64(const std::string &input, std::vector<uint8_t> &outpu
     }
 }
 
+#ifdef BASE64_X86_SIMD
+// Vectorized decoding based on the algorithm described by W. Muła and D.
+// Lemire in "Faster Base64 Encoding and Decoding using AVX2 Instructions"
+// (2018). Characters are classified by their high and low nibbles, so that
+// invalid input (including padding or whitespace) can be detected for a whole
+// block at once. When an invalid block is found we stop and let the scalar
+// code handle the rest of the input. Returns the number of input characters
+// consumed, which is always a multiple of 4.
+__attribute__((target("sse4.1"))) static size_t decode_sse41(
+    const char *input, size_t in_len, uint8_t *output, size_t out_len) {
+    const __m128i lut_lo =
+        _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                      0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi =
+        _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10,
+                      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll =
+        _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_nibble = _mm_set1_epi8(0x0F);
+    const __m128i mask_slash = _mm_set1_epi8(0x2F);
+    const __m128i merge_ab_bc = _mm_set1_epi32(0x01400140);
+    const __m128i merge_abcd = _mm_set1_epi32(0x00011000);
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13,
+                                          12, -1, -1, -1, -1);
+
+    size_t i = 0;
+    size_t j = 0;
+    // Each block writes 16 bytes of which only 12 are valid.
+    while (i + 16 <= in_len && j + 16 <= out_len) {
+        __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i));
+        __m128i hi_nibbles =
+            _mm_and_si128(_mm_srli_epi32(in, 4), mask_nibble);
+        __m128i lo_nibbles = _mm_and_si128(in, mask_nibble);
+        __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+        __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+        if (!_mm_testz_si128(lo, hi)) {
+            break;
+        }
+        __m128i eq_slash = _mm_cmpeq_epi8(in, mask_slash);
+        __m128i roll =
+            _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_slash, hi_nibbles));
+        __m128i values = _mm_add_epi8(in, roll);
+        __m128i merged = _mm_maddubs_epi16(values, merge_ab_bc);
+        __m128i packed = _mm_madd_epi16(merged, merge_abcd);
+        packed = _mm_shuffle_epi8(packed, shuffle);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(output + j), packed);
+        i += 16;
+        j += 12;
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) static size_t decode_avx2(const char *input,
+                                                          size_t in_len,
+                                                          uint8_t *output,
+                                                          size_t out_len) {
+    const __m256i lut_lo = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A,
+        0x1B, 0x1B, 0x1B, 0x1A, 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lut_hi = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 19, 4,
+        -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask_nibble = _mm256_set1_epi8(0x0F);
+    const __m256i mask_slash = _mm256_set1_epi8(0x2F);
+    const __m256i merge_ab_bc = _mm256_set1_epi32(0x01400140);
+    const __m256i merge_abcd = _mm256_set1_epi32(0x00011000);
+    const __m256i shuffle = _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1, 2, 1, 0, 6, 5,
+        4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i permute = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1);
+
+    size_t i = 0;
+    size_t j = 0;
+    // Each block writes 32 bytes of which only 24 are valid.
+    while (i + 32 <= in_len && j + 32 <= out_len) {
+        __m256i in =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input + i));
+        __m256i hi_nibbles =
+            _mm256_and_si256(_mm256_srli_epi32(in, 4), mask_nibble);
+        __m256i lo_nibbles = _mm256_and_si256(in, mask_nibble);
+        __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+        __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+        if (!_mm256_testz_si256(lo, hi)) {
+            break;
+        }
+        __m256i eq_slash = _mm256_cmpeq_epi8(in, mask_slash);
+        __m256i roll = _mm256_shuffle_epi8(
+            lut_roll, _mm256_add_epi8(eq_slash, hi_nibbles));
+        __m256i values = _mm256_add_epi8(in, roll);
+        __m256i merged = _mm256_maddubs_epi16(values, merge_ab_bc);
+        __m256i packed = _mm256_madd_epi16(merged, merge_abcd);
+        packed = _mm256_shuffle_epi8(packed, shuffle);
+        packed = _mm256_permutevar8x32_epi32(packed, permute);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(output + j), packed);
+        i += 32;
+        j += 24;
+    }
+    return i;
+}
+#endif
+
+// Highest instruction set supported by the CPU, detected once at runtime.
+static Base64::SimdLevel supported_simd_level() {
+#ifdef BASE64_X86_SIMD
+    static const Base64::SimdLevel level = []() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return Base64::SimdLevel::AVX2;
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+            return Base64::SimdLevel::SSE41;
+        }
+        return Base64::SimdLevel::SCALAR;
+    }();
+    return level;
+#else
+    return Base64::SimdLevel::SCALAR;
+#endif
+}
+
+static std::atomic<Base64::SimdLevel> &current_simd_level() {
+    static std::atomic<Base64::SimdLevel> level(supported_simd_level());
+    return level;
+}
+
+Base64::SimdLevel Base64::simd_level() { return current_simd_level().load(); }
+
+Base64::SimdLevel Base64::set_simd_level(SimdLevel level) {
+    level = std::min(level, supported_simd_level());
+    current_simd_level().store(level);
+    return level;
+}
+
+size_t Base64::decoded_length(std::string_view input) {
+    size_t in_len = input.size();
+    if (in_len < 2) {
+        return 0;
+    }
+    size_t out_len = in_len / 4 * 3;
+    if (input[in_len - 1] == '=') {
+        --out_len;
+    }
+    if (input[in_len - 2] == '=') {
+        --out_len;
+    }
+    return out_len;
+}
+
+size_t Base64::decode_base64(std::string_view input, uint8_t *output) {
+    size_t in_len = input.size();
+    size_t out_len = decoded_length(input);
+    size_t consumed = 0;
+#ifdef BASE64_X86_SIMD
+    switch (simd_level()) {
+        case SimdLevel::AVX2:
+            consumed = decode_avx2(input.data(), in_len, output, out_len);
+            break;
+        case SimdLevel::SSE41:
+            consumed = decode_sse41(input.data(), in_len, output, out_len);
+            break;
+        default:
+            break;
+    }
+#endif
+    size_t written = consumed / 4 * 3;
+    decode_quads_scalar(input.data() + consumed, in_len - consumed,
+                        output + written, out_len - written);
+    return out_len;
+}
+
+void Base64::decode_base64(std::string_view input,
+                           std::vector<uint8_t> &output) {
+    output.resize(decoded_length(input));
+    decode_base64(input, output.data());
+}
+
 // Interpreting functions.
 
 // Read four bytes from the stream from the start index, order bytes
@@ -118,3 +302,112 @@ double Base64::interpret_double(std::vector<uint8_t> &data, size_t offset,
     std::memcpy(&ret, &bytes, sizeof(bytes));
     return ret;
 }
+
+// Bulk interpreting functions.
+
+static bool host_is_little_endian() {
+    uint16_t value = 1;
+    uint8_t first_byte;
+    std::memcpy(&first_byte, &value, 1);
+    return first_byte == 1;
+}
+
+static inline uint32_t byte_swap(uint32_t x) {
+    return ((x & 0x000000FFu) << 24) | ((x & 0x0000FF00u) << 8) |
+           ((x & 0x00FF0000u) >> 8) | ((x & 0xFF000000u) >> 24);
+}
+
+static inline uint64_t byte_swap(uint64_t x) {
+    return (static_cast<uint64_t>(byte_swap(static_cast<uint32_t>(x))) << 32) |
+           byte_swap(static_cast<uint32_t>(x >> 32));
+}
+
+// Read the value at the given index of the data block, where T is the floating
+// point type and U the unsigned integer type of the same size.
+template <typename T, typename U>
+static inline double read_value(const uint8_t *data, size_t index, bool swap) {
+    U bytes;
+    std::memcpy(&bytes, data + index * sizeof(U), sizeof(U));
+    if (swap) {
+        bytes = byte_swap(bytes);
+    }
+    T value;
+    std::memcpy(&value, &bytes, sizeof(T));
+    return value;
+}
+
+template <typename T, typename U>
+static void interpret_values_impl(const uint8_t *data, size_t num_values,
+                                  bool swap, double *output) {
+    if (num_values == 0) {
+        return;
+    }
+    // Doubles in the native byte order can be copied directly.
+    if (sizeof(T) == sizeof(double) && !swap) {
+        std::memcpy(output, data, num_values * sizeof(double));
+        return;
+    }
+    // The branch on `swap` is hoisted out of the loops to allow the compiler
+    // to vectorize them.
+    if (swap) {
+        for (size_t i = 0; i < num_values; ++i) {
+            output[i] = read_value<T, U>(data, i, true);
+        }
+    } else {
+        for (size_t i = 0; i < num_values; ++i) {
+            output[i] = read_value<T, U>(data, i, false);
+        }
+    }
+}
+
+template <typename T, typename U>
+static void interpret_pairs_impl(const uint8_t *data, size_t num_pairs,
+                                 bool swap, double *first, double *second) {
+    if (swap) {
+        for (size_t i = 0; i < num_pairs; ++i) {
+            first[i] = read_value<T, U>(data, 2 * i, true);
+            second[i] = read_value<T, U>(data, 2 * i + 1, true);
+        }
+    } else {
+        for (size_t i = 0; i < num_pairs; ++i) {
+            first[i] = read_value<T, U>(data, 2 * i, false);
+            second[i] = read_value<T, U>(data, 2 * i + 1, false);
+        }
+    }
+}
+
+void Base64::interpret_values(const uint8_t *data, size_t size, int precision,
+                              bool little_endian,
+                              std::vector<double> &output) {
+    bool swap = little_endian != host_is_little_endian();
+    if (precision == 32) {
+        output.resize(size / 4);
+        interpret_values_impl<float, uint32_t>(data, output.size(), swap,
+                                               output.data());
+    } else if (precision == 64) {
+        output.resize(size / 8);
+        interpret_values_impl<double, uint64_t>(data, output.size(), swap,
+                                                output.data());
+    } else {
+        output.clear();
+    }
+}
+
+void Base64::interpret_pairs(const uint8_t *data, size_t size, int precision,
+                             bool little_endian, std::vector<double> &first,
+                             std::vector<double> &second) {
+    bool swap = little_endian != host_is_little_endian();
+    size_t num_pairs = 0;
+    if (precision == 32 || precision == 64) {
+        num_pairs = size / (2 * (precision / 8));
+    }
+    first.resize(num_pairs);
+    second.resize(num_pairs);
+    if (precision == 32) {
+        interpret_pairs_impl<float, uint32_t>(data, num_pairs, swap,
+                                              first.data(), second.data());
+    } else if (precision == 64) {
+        interpret_pairs_impl<double, uint64_t>(data, num_pairs, swap,
+                                               first.data(), second.data());
+    }
+}
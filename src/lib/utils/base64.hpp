@@ -1,6 +1,8 @@
 #ifndef UTILS_BASE64_HPP
 #define UTILS_BASE64_HPP
 
+#include <cstdint>
+#include <string_view>
 #include <vector>
 
 // This namespace contains functions to decode base64-encoded data into raw
@@ -24,10 +26,29 @@ static constexpr unsigned char translation_table[] = {
     64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
     64, 64, 64, 64, 64, 64, 64, 64, 64};
 
+// Instruction set used for decoding. The highest level supported by the CPU
+// is detected at runtime and used by default.
+enum class SimdLevel { SCALAR, SSE41, AVX2 };
+SimdLevel simd_level();
+
+// Force decode_base64 to use the given instruction set, for example to test
+// the SSE4.1 and scalar paths on an AVX2 machine. Levels not supported by the
+// CPU are lowered to the highest supported one. Returns the level in use.
+SimdLevel set_simd_level(SimdLevel level);
+
+// Number of bytes resulting from decoding the given base64-encoded string.
+size_t decoded_length(std::string_view input);
+
+// Decode input string containing base64-encoded data into the given output
+// buffer, which must hold at least decoded_length(input) bytes. Uses AVX2 or
+// SSE4.1 instructions depending on simd_level(). Returns the number of bytes
+// written.
+size_t decode_base64(std::string_view input, uint8_t *output);
+
 // Decode input string containing base64-encoded data into bytes, result is
 // returned in the output vector. This function allocates the appropriate amount
 // of memory for the output vector.
-void decode_base64(std::string const &input, std::vector<uint8_t> &output);
+void decode_base64(std::string_view input, std::vector<uint8_t> &output);
 
 // Interpreting raw data into floating-point values.
 uint32_t interpret_uint32(std::vector<uint8_t> &data, size_t offset,
@@ -39,6 +60,20 @@ float interpret_float(std::vector<uint8_t> &data, size_t offset,
 double interpret_double(std::vector<uint8_t> &data, size_t offset,
                         bool little_endian);
 
+// Interpret a block of raw data as an array of 32 or 64 bit floating-point
+// values in the given byte order. The output vector is resized to the number
+// of complete values in the data, or to zero if the precision is not
+// supported.
+void interpret_values(const uint8_t *data, size_t size, int precision,
+                      bool little_endian, std::vector<double> &output);
+
+// Same as above, but the values are stored as interleaved pairs (For example
+// m/z-intensity pairs in mzXML files), which are split into the first and
+// second vectors.
+void interpret_pairs(const uint8_t *data, size_t size, int precision,
+                     bool little_endian, std::vector<double> &first,
+                     std::vector<double> &second);
+
 }  // namespace Base64
 
 #endif /* UTILS_BASE64_HPP */
@@ -1,100 +1,121 @@
 #include <zlib.h>
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <cstring>
+#include <limits>
 #include <vector>
 
 #include "compression.hpp"
 
-// Decompress in chunks of 256 KB, this number can be increase or decreased
-// based on available memory.
-#define CHUNK 262144
-
 // Decompress raw memory from the in_data vector into the out_data vector.
 // Function allocates memory for the output vector. Function takes the length of
 // the data after decompression.
 int Compression::inflate(std::vector<uint8_t> &in_data,
                          std::vector<uint8_t> &out_data,
                          size_t decompressed_len) {
-    int ret;
-    z_stream strm;
-    out_data.resize(decompressed_len);
+    Inflator inflator;
+    return inflator.inflate(in_data.data(), in_data.size(), out_data,
+                            decompressed_len);
+}
+
+int Compression::deflate(const uint8_t *in_data, size_t in_len,
+                         std::vector<uint8_t> &out_data, int level) {
+    uLong bound = compressBound(static_cast<uLong>(in_len));
+    out_data.resize(bound);
+    uLongf out_len = bound;
+    int ret = compress2(out_data.data(), &out_len, in_data,
+                        static_cast<uLong>(in_len), level);
+    if (ret != Z_OK) {
+        out_data.clear();
+        return ret;
+    }
+    out_data.resize(out_len);
+    return Z_OK;
+}
 
-    // Allocate inflate state.
+// Allocate the inflate state once, it will be reset for every decompression.
+Compression::Inflator::Inflator() {
     strm.zalloc = Z_NULL;
     strm.zfree = Z_NULL;
     strm.opaque = Z_NULL;
     strm.avail_in = 0;
     strm.next_in = Z_NULL;
-    ret = inflateInit(&strm);
+    init_status = inflateInit(&strm);
+}
+
+Compression::Inflator::~Inflator() {
+    if (init_status == Z_OK) {
+        (void)inflateEnd(&strm);
+    }
+}
+
+int Compression::Inflator::inflate(const uint8_t *in_data, size_t in_len,
+                                   std::vector<uint8_t> &out_data,
+                                   size_t decompressed_len) {
+    if (init_status != Z_OK) {
+        return init_status;
+    }
+    int ret = inflateReset(&strm);
     if (ret != Z_OK) {
         return ret;
     }
 
-    unsigned char *in = reinterpret_cast<unsigned char *>(&in_data[0]);
+    // If the decompressed length is unknown, start with an estimate based on
+    // the input size and grow the output geometrically. The capacity of the
+    // output vector is reused between calls.
+    size_t out_len = decompressed_len;
+    if (out_len == 0) {
+        out_len = std::max({out_data.capacity(), in_len * 4, size_t(1024)});
+    }
+    out_data.resize(out_len);
+
+    // The zlib stream counters are 32 bits wide, larger buffers are processed
+    // in chunks.
+    const size_t max_chunk = std::numeric_limits<uInt>::max();
+    size_t bytes_read = 0;
     size_t bytes_decompressed = 0;
-    // Decompress until deflate stream ends or end of file.
+    strm.avail_in = 0;
     do {
-        // Read the amount of CHUNK or until the end of the data.
-        if (strm.total_in + CHUNK > in_data.size()) {
-            strm.avail_in = in_data.size() - strm.total_in;
-        } else {
-            strm.avail_in = CHUNK;
-        }
-        if (strm.avail_in == 0) {  // End of data.
-            break;
+        if (strm.avail_in == 0 && bytes_read < in_len) {
+            size_t chunk = std::min(in_len - bytes_read, max_chunk);
+            strm.next_in = const_cast<Bytef *>(in_data + bytes_read);
+            strm.avail_in = static_cast<uInt>(chunk);
+            bytes_read += chunk;
         }
-        // Use the total bytes read as an offset for the input data.
-        strm.next_in = in + strm.total_in;
-
-        // Run inflate() on input until output buffer not full.
-        do {
-            if (decompressed_len == 0) {
-                // Decompressed length unknown, alocate a new chunk.
-                strm.avail_out = CHUNK;
-                out_data.resize(out_data.size() + CHUNK);
-            } else {
-                // Calculate amount of free bytes in output buffer.
-                if (bytes_decompressed + CHUNK > decompressed_len) {
-                    strm.avail_out = decompressed_len - bytes_decompressed;
-                } else {
-                    strm.avail_out = CHUNK;
-                }
+        if (bytes_decompressed == out_data.size()) {
+            if (decompressed_len != 0) {
+                // The data is bigger than expected.
+                return Z_BUF_ERROR;
             }
+            out_data.resize(out_data.size() * 2);
+        }
+        size_t available = out_data.size() - bytes_decompressed;
+        strm.next_out = out_data.data() + bytes_decompressed;
+        strm.avail_out = static_cast<uInt>(std::min(available, max_chunk));
+        uInt avail_out = strm.avail_out;
 
-            // Use next section of output buffer as output buffer.
-            strm.next_out = reinterpret_cast<unsigned char *>(
-                &out_data[bytes_decompressed]);
-
-            ret = inflate(&strm, Z_NO_FLUSH);
-            assert(ret != Z_STREAM_ERROR);
-
-            bytes_decompressed = strm.total_out;
-
-            switch (ret) {
-                case Z_NEED_DICT:
-                    ret = Z_DATA_ERROR;
-                    (void)inflateEnd(&strm);
-                    return ret;
-                case Z_DATA_ERROR:
-                    (void)inflateEnd(&strm);
-                    return ret;
-                case Z_MEM_ERROR:
-                    (void)inflateEnd(&strm);
-                    return ret;
-            }
-        } while (strm.avail_in != 0 && strm.avail_out != 0);
-
-        // Done when inflate() says it's done.
+        ret = ::inflate(&strm, Z_NO_FLUSH);
+        bytes_decompressed += avail_out - strm.avail_out;
+        switch (ret) {
+            case Z_NEED_DICT:
+                return Z_DATA_ERROR;
+            case Z_STREAM_ERROR:
+            case Z_DATA_ERROR:
+            case Z_MEM_ERROR:
+                return ret;
+        }
+        if (ret != Z_STREAM_END && strm.avail_in == 0 && bytes_read == in_len &&
+            strm.avail_out != 0) {
+            // End of data before the end of the deflate stream.
+            return Z_DATA_ERROR;
+        }
     } while (ret != Z_STREAM_END);
 
     // Output vector might be bigger than needed if the size was unknown, resize
     // to fit data.
     out_data.resize(bytes_decompressed);
-
-    // Clean up and return.
-    (void)inflateEnd(&strm);
-    return ret == Z_STREAM_END ? Z_OK : Z_DATA_ERROR;
+    return Z_OK;
 }
 
 // Initialize buffer.
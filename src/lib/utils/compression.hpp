@@ -11,10 +11,37 @@ namespace Compression {
 
 enum state { OK, ERROR };
 
-// Decompress raw data.
+// Decompress raw data. If the decompressed length is not known it should be
+// set to 0.
 int inflate(std::vector<uint8_t> &in_data, std::vector<uint8_t> &out_data,
             size_t decompressed_len);
 
+// Compress in_len bytes from in_data into out_data as a single zlib stream,
+// which can be decompressed with inflate. Returns Z_OK on success.
+int deflate(const uint8_t *in_data, size_t in_len,
+            std::vector<uint8_t> &out_data, int level = Z_DEFAULT_COMPRESSION);
+
+// Inflator keeps a Zlib decompression state that is reused for every call to
+// inflate, avoiding the setup cost when decompressing many small buffers. An
+// Inflator is not thread safe, each thread should use its own.
+class Inflator {
+    // Zlib stream used in decompression.
+    z_stream strm;
+    int init_status;
+
+   public:
+    Inflator();
+    ~Inflator();
+    Inflator(Inflator const &) = delete;
+    Inflator &operator=(Inflator const &) = delete;
+
+    // Decompress in_len bytes from in_data into out_data, which is resized to
+    // the length of the decompressed data. The capacity of out_data is reused
+    // when possible. Returns Z_OK on success.
+    int inflate(const uint8_t *in_data, size_t in_len,
+                std::vector<uint8_t> &out_data, size_t decompressed_len);
+};
+
 // Streambuf class allows a stream to write compressed data to a file by use of
 // an intermediate buffer.
 class DeflateStreambuf : public std::streambuf {
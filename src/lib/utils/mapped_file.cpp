@@ -0,0 +1,134 @@
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.hpp"
+
+MappedFile::File::~File() { close(); }
+
+MappedFile::File::File(File &&other) noexcept { *this = std::move(other); }
+
+MappedFile::File &MappedFile::File::operator=(File &&other) noexcept {
+    if (this != &other) {
+        close();
+        std::swap(data_ptr, other.data_ptr);
+        std::swap(data_size, other.data_size);
+        std::swap(opened, other.opened);
+#ifdef _WIN32
+        std::swap(file_handle, other.file_handle);
+        std::swap(mapping_handle, other.mapping_handle);
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::File::open(std::string const &filename) {
+    close();
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return false;
+    }
+    file_handle = file;
+    opened = true;
+
+    // Empty files can't be mapped, but are valid (empty) inputs.
+    if (size.QuadPart == 0) {
+        return true;
+    }
+    HANDLE mapping =
+        CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        close();
+        return false;
+    }
+    mapping_handle = mapping;
+    void *ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (ptr == nullptr) {
+        close();
+        return false;
+    }
+    data_ptr = static_cast<const char *>(ptr);
+    data_size = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void MappedFile::File::close() {
+    if (data_ptr != nullptr) {
+        UnmapViewOfFile(data_ptr);
+    }
+    if (mapping_handle != nullptr) {
+        CloseHandle(mapping_handle);
+    }
+    if (file_handle != nullptr) {
+        CloseHandle(file_handle);
+    }
+    data_ptr = nullptr;
+    data_size = 0;
+    mapping_handle = nullptr;
+    file_handle = nullptr;
+    opened = false;
+}
+
+#else
+
+bool MappedFile::File::open(std::string const &filename) {
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1 || !S_ISREG(file_stat.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+    opened = true;
+
+    // Empty files can't be mapped, but are valid (empty) inputs.
+    size_t size = static_cast<size_t>(file_stat.st_size);
+    if (size == 0) {
+        ::close(fd);
+        return true;
+    }
+    void *ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file.
+    ::close(fd);
+    if (ptr == MAP_FAILED) {
+        opened = false;
+        return false;
+    }
+    // The parsers read the file from front to back.
+    madvise(ptr, size, MADV_SEQUENTIAL);
+    data_ptr = static_cast<const char *>(ptr);
+    data_size = size;
+    return true;
+}
+
+void MappedFile::File::close() {
+    if (data_ptr != nullptr) {
+        munmap(const_cast<char *>(data_ptr), data_size);
+    }
+    data_ptr = nullptr;
+    data_size = 0;
+    opened = false;
+}
+
+#endif
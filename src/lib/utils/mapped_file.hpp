@@ -0,0 +1,46 @@
+#ifndef UTILS_MAPPEDFILE_HPP
+#define UTILS_MAPPEDFILE_HPP
+
+#include <string>
+#include <string_view>
+
+// This namespace contains a read-only memory mapping of a file, used to parse
+// large input files without copying them through an intermediate stream.
+namespace MappedFile {
+
+// A read-only view of an entire file. The contents are available through
+// `view()` for as long as the object is alive and open.
+class File {
+    // Mapped region.
+    const char *data_ptr = nullptr;
+    size_t data_size = 0;
+    bool opened = false;
+
+#ifdef _WIN32
+    void *file_handle = nullptr;
+    void *mapping_handle = nullptr;
+#endif
+
+   public:
+    File() = default;
+    File(std::string const &filename) { open(filename); }
+    // Destructor unmaps the file.
+    ~File();
+
+    File(File const &) = delete;
+    File &operator=(File const &) = delete;
+    File(File &&other) noexcept;
+    File &operator=(File &&other) noexcept;
+
+    // Map the given file in memory. Returns false if the file could not be
+    // opened or mapped.
+    bool open(std::string const &filename);
+    void close();
+
+    bool is_open() const { return opened; }
+    std::string_view view() const { return {data_ptr, data_size}; }
+};
+
+}  // namespace MappedFile
+
+#endif /* UTILS_MAPPEDFILE_HPP */
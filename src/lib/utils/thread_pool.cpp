@@ -0,0 +1,196 @@
+#include <algorithm>
+
+#include "thread_pool.hpp"
+
+// Number of chunks per thread when the chunk size is not given. Having more
+// chunks than threads is what allows stealing work from slower threads.
+static constexpr size_t CHUNKS_PER_THREAD = 8;
+
+struct ThreadPool::Pool::Job {
+    // Chunks [head, tail) assigned to a thread. The owner takes chunks from
+    // the head and other threads steal them from the tail.
+    struct Block {
+        std::mutex mutex;
+        size_t head = 0;
+        size_t tail = 0;
+    };
+
+    const std::function<void(size_t, size_t)> *func = nullptr;
+    size_t num_items = 0;
+    size_t chunk_size = 0;
+    std::vector<Block> blocks;
+    // Next block to be given to a worker. The first one belongs to the
+    // thread that called parallel_for. Protected by the mutex of the pool.
+    size_t next_block = 1;
+    // Chunks not finished yet.
+    std::atomic<size_t> remaining{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    explicit Job(size_t num_blocks) : blocks(num_blocks) {}
+};
+
+ThreadPool::Pool::Pool(size_t num_workers) {
+    for (size_t i = 0; i < num_workers; ++i) {
+        workers.emplace_back([this]() { worker_loop(); });
+    }
+}
+
+ThreadPool::Pool::~Pool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    job_available.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::Pool::worker_loop() {
+    while (true) {
+        std::shared_ptr<Job> job;
+        size_t block = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            job_available.wait(
+                lock, [this]() { return stopping || !open_jobs.empty(); });
+            if (open_jobs.empty()) {
+                return;
+            }
+            job = open_jobs.front();
+            block = job->next_block++;
+            if (job->next_block == job->blocks.size()) {
+                open_jobs.pop_front();
+            }
+        }
+        run(*job, block);
+    }
+}
+
+void ThreadPool::Pool::run(Job &job, size_t block) {
+    size_t num_blocks = job.blocks.size();
+    while (true) {
+        size_t chunk = 0;
+        bool found = false;
+        bool stolen = false;
+        {
+            auto &own = job.blocks[block];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (own.head < own.tail) {
+                chunk = own.head++;
+                found = true;
+            }
+        }
+        for (size_t i = 1; i < num_blocks && !found; ++i) {
+            auto &victim = job.blocks[(block + i) % num_blocks];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.head < victim.tail) {
+                chunk = --victim.tail;
+                found = true;
+                stolen = true;
+            }
+        }
+        if (!found) {
+            return;
+        }
+
+        size_t begin = chunk * job.chunk_size;
+        size_t end = std::min(begin + job.chunk_size, job.num_items);
+        (*job.func)(begin, end);
+        num_tasks.fetch_add(1, std::memory_order_relaxed);
+        if (stolen) {
+            num_steals.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (--job.remaining == 0) {
+            std::lock_guard<std::mutex> lock(job.mutex);
+            job.finished.notify_all();
+        }
+    }
+}
+
+void ThreadPool::Pool::parallel_for(
+    size_t num_items, size_t max_threads,
+    const std::function<void(size_t, size_t)> &func, size_t chunk_size) {
+    if (num_items == 0) {
+        return;
+    }
+    size_t num_threads = workers.size() + 1;
+    if (num_threads > max_threads) {
+        num_threads = max_threads;
+    }
+    if (chunk_size == 0) {
+        chunk_size = std::max<size_t>(
+            1, num_items / (std::max<size_t>(num_threads, 1) *
+                            CHUNKS_PER_THREAD));
+    }
+    size_t num_chunks = (num_items + chunk_size - 1) / chunk_size;
+    if (num_threads > num_chunks) {
+        num_threads = num_chunks;
+    }
+    if (num_threads <= 1) {
+        func(0, num_items);
+        return;
+    }
+
+    auto job = std::make_shared<Job>(num_threads);
+    job->func = &func;
+    job->num_items = num_items;
+    job->chunk_size = chunk_size;
+    job->remaining = num_chunks;
+    for (size_t i = 0; i < num_threads; ++i) {
+        job->blocks[i].head = num_chunks * i / num_threads;
+        job->blocks[i].tail = num_chunks * (i + 1) / num_threads;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        open_jobs.push_back(job);
+    }
+    job_available.notify_all();
+    num_jobs.fetch_add(1, std::memory_order_relaxed);
+
+    // The calling thread works on the first block, and then waits for the
+    // chunks still being processed by other threads.
+    run(*job, 0);
+    {
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->finished.wait(lock, [&job]() { return job->remaining == 0; });
+    }
+
+    // If not all blocks were taken by the workers the job is still open.
+    // Workers that take it from now on won't find any chunks left.
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = std::find(open_jobs.begin(), open_jobs.end(), job);
+    if (it != open_jobs.end()) {
+        open_jobs.erase(it);
+    }
+}
+
+ThreadPool::Stats ThreadPool::Pool::stats() const {
+    Stats stats = {};
+    stats.num_workers = workers.size();
+    stats.jobs = num_jobs.load(std::memory_order_relaxed);
+    stats.tasks = num_tasks.load(std::memory_order_relaxed);
+    stats.steals = num_steals.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void ThreadPool::Pool::reset_stats() {
+    num_jobs = 0;
+    num_tasks = 0;
+    num_steals = 0;
+}
+
+ThreadPool::Pool &ThreadPool::shared_pool() {
+    static Pool pool([]() -> size_t {
+        size_t num_threads = std::thread::hardware_concurrency();
+        return num_threads > 1 ? num_threads - 1 : 0;
+    }());
+    return pool;
+}
+
+void ThreadPool::parallel_for(size_t num_items, size_t max_threads,
+                              const std::function<void(size_t, size_t)> &func,
+                              size_t chunk_size) {
+    shared_pool().parallel_for(num_items, max_threads, func, chunk_size);
+}
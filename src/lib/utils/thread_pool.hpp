@@ -0,0 +1,91 @@
+#ifndef UTILS_THREADPOOL_HPP
+#define UTILS_THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// This namespace contains a pool of worker threads shared by the parallel
+// algorithms of the library, so that threads are not created on every call.
+// The work is split into chunks that are handed out to the participating
+// threads in contiguous blocks. When a thread runs out of chunks it steals
+// them from the end of the other blocks, which keeps all threads busy when
+// some chunks are much more expensive than others.
+namespace ThreadPool {
+
+// Counters of the work done by a pool, useful for tuning the number of threads
+// and the chunk sizes.
+struct Stats {
+    // Number of worker threads owned by the pool. The thread that calls
+    // parallel_for also takes part in the work.
+    uint64_t num_workers;
+    // Number of parallel_for calls that ran on more than one thread.
+    uint64_t jobs;
+    // Number of chunks executed by these calls.
+    uint64_t tasks;
+    // Number of chunks executed by a thread other than the one they were
+    // initially assigned to.
+    uint64_t steals;
+};
+
+class Pool {
+    struct Job;
+
+    std::vector<std::thread> workers;
+    // Jobs that still accept new threads.
+    std::deque<std::shared_ptr<Job>> open_jobs;
+    std::mutex mutex;
+    std::condition_variable job_available;
+    bool stopping = false;
+
+    std::atomic<uint64_t> num_jobs{0};
+    std::atomic<uint64_t> num_tasks{0};
+    std::atomic<uint64_t> num_steals{0};
+
+    void worker_loop();
+    // Execute the chunks of the given block and then steal from the others
+    // until the job has no chunks left.
+    void run(Job &job, size_t block);
+
+   public:
+    explicit Pool(size_t num_workers);
+    // Waits for the workers to finish.
+    ~Pool();
+
+    Pool(const Pool &) = delete;
+    Pool &operator=(const Pool &) = delete;
+
+    // Call func(begin, end) for consecutive chunks of [0, num_items) of up to
+    // chunk_size items, using at most max_threads threads, including the
+    // calling thread. The call returns once all chunks have been processed.
+    // If chunk_size is zero, it is chosen to give each thread several chunks.
+    // When running on a single thread func is called once for the whole
+    // range. Calls can be nested, and can be made from several threads at the
+    // same time.
+    void parallel_for(size_t num_items, size_t max_threads,
+                      const std::function<void(size_t, size_t)> &func,
+                      size_t chunk_size = 0);
+
+    size_t size() const { return workers.size(); }
+    Stats stats() const;
+    void reset_stats();
+};
+
+// The pool used by the library, with one thread per available core. It is
+// created on first use.
+Pool &shared_pool();
+
+// Same as Pool::parallel_for on the shared pool.
+void parallel_for(size_t num_items, size_t max_threads,
+                  const std::function<void(size_t, size_t)> &func,
+                  size_t chunk_size = 0);
+
+}  // namespace ThreadPool
+
+#endif /* UTILS_THREADPOOL_HPP */
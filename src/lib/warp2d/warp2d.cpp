@@ -3,9 +3,9 @@
 #include <cmath>
 #include <iostream>
 #include <limits>
-#include <thread>
 
 #include "utils/interpolation.hpp"
+#include "utils/thread_pool.hpp"
 #include "warp2d/warp2d.hpp"
 
 std::vector<Centroid::Peak> Warp2D::peaks_in_rt_range(
@@ -255,33 +255,13 @@ Warp2D::TimeMap Warp2D::calculate_time_map(
     // Initialize nodes.
     auto levels = Warp2D::initialize_levels(N, m, t, nP);
 
-    // Prepare maximum concurrency.
-    uint64_t num_threads = std::thread::hardware_concurrency();
-    if (num_threads > max_threads) {
-        num_threads = max_threads;
-    }
-
-    // Prepare which group of levels we are going to send to every core. We
-    // store the index of the levels into a groups array.
-    auto groups = std::vector<std::vector<int>>(num_threads);
-    size_t i = 0;
-    size_t k = 0;
-    while ((int)k < N) {
-        groups[i].push_back(k);
-        ++k;
-        if (i == num_threads - 1) {
-            i = 0;
-        } else {
-            ++i;
-        }
-    }
-
-    std::vector<std::thread> threads(groups.size());
-    for (size_t i = 0; i < groups.size(); ++i) {
-        threads[i] = std::thread([i, &groups, &levels, rt_min, delta_rt,
-                                  segment_rt_width, &ref_peaks_filtered,
-                                  &source_peaks_filtered]() {
-            for (const auto& k : groups[i]) {
+    // Compute the similarities of every level on the shared thread pool. The
+    // number of peaks differs between segments, so each level is a separate
+    // chunk that can be stolen by idle threads.
+    ThreadPool::parallel_for(
+        std::max(N, 0), max_threads,
+        [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
                 auto& current_level = levels[k];
                 double rt_start = rt_min + k * segment_rt_width;
                 double rt_end = rt_start + segment_rt_width;
@@ -289,11 +269,8 @@ Warp2D::TimeMap Warp2D::calculate_time_map(
                     current_level, rt_start, rt_end, rt_min, delta_rt,
                     ref_peaks_filtered, source_peaks_filtered);
             }
-        });
-    }
-    for (auto& thread : threads) {
-        thread.join();
-    }
+        },
+        1);
 
     auto warp_by = Warp2D::find_optimal_warping(levels);
 
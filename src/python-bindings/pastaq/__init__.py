@@ -483,6 +483,7 @@ def default_parameters(instrument, avg_fwhm_rt):
             # Other.
             #
             'max_peaks': 1000000,
+            'refine_peak_fit': False,
             'polarity': 'both',
             'min_mz': 0,
             'max_mz': 100000,
@@ -586,98 +587,36 @@ def parse_raw_files(params, output_dir, logger=None, force_override=False):
         stem = file['stem']
 
         # Check if file has already been processed.
-        out_path = os.path.join(output_dir, 'raw', "{}.ms1".format(stem))
-        if os.path.exists(out_path) and not force_override:
+        out_path_ms1 = os.path.join(output_dir, 'raw', "{}.ms1".format(stem))
+        out_path_ms2 = os.path.join(output_dir, 'raw', "{}.ms2".format(stem))
+        if (os.path.exists(out_path_ms1) and os.path.exists(out_path_ms2)
+                and not force_override):
             continue
 
-        # File extension.
-        file_extension = os.path.splitext(raw_path)[1]
-
-        # Read raw files (MS1).
-        _custom_log('Reading MS1: {}'.format(raw_path), logger)
-        if file_extension.lower() == '.mzxml':
-            raw_data = pastaq.read_mzxml(
-                raw_path,
-                min_mz=params['min_mz'],
-                max_mz=params['max_mz'],
-                min_rt=params['min_rt'],
-                max_rt=params['max_rt'],
-                instrument_type=params['instrument_type'],
-                resolution_ms1=params['resolution_ms1'],
-                resolution_msn=params['resolution_msn'],
-                reference_mz=params['reference_mz'],
-                fwhm_rt=params['avg_fwhm_rt'],
-                polarity=params['polarity'],
-                ms_level=1,
-            )
-        elif file_extension.lower() == '.mzml':
-            raw_data = pastaq.read_mzml(
-                raw_path,
-                min_mz=params['min_mz'],
-                max_mz=params['max_mz'],
-                min_rt=params['min_rt'],
-                max_rt=params['max_rt'],
-                instrument_type=params['instrument_type'],
-                resolution_ms1=params['resolution_ms1'],
-                resolution_msn=params['resolution_msn'],
-                reference_mz=params['reference_mz'],
-                fwhm_rt=params['avg_fwhm_rt'],
-                polarity=params['polarity'],
-                ms_level=1,
-            )
+        # Read raw files (MS1 and MS2) in a single pass.
+        _custom_log('Reading MS1 and MS2: {}'.format(raw_path), logger)
+        raw_data_ms1, raw_data_ms2 = pastaq.read_raw_levels(
+            raw_path,
+            min_mz=params['min_mz'],
+            max_mz=params['max_mz'],
+            min_rt=params['min_rt'],
+            max_rt=params['max_rt'],
+            instrument_type=params['instrument_type'],
+            resolution_ms1=params['resolution_ms1'],
+            resolution_msn=params['resolution_msn'],
+            reference_mz=params['reference_mz'],
+            fwhm_rt=params['avg_fwhm_rt'],
+            polarity=params['polarity'],
+            ms_levels=[1, 2],
+        )
 
         # Write raw_data to disk (MS1).
-        _custom_log('Writing MS1: {}'.format(out_path), logger)
-        raw_data.dump(out_path)
-
-    for file in params['input_files']:
-        raw_path = file['raw_path']
-        stem = file['stem']
-
-        # Check if file has already been processed.
-        out_path = os.path.join(output_dir, 'raw', "{}.ms2".format(stem))
-        if os.path.exists(out_path) and not force_override:
-            continue
-
-        # File extension.
-        file_extension = os.path.splitext(raw_path)[1]
-
-        # Read raw files (MS2).
-        _custom_log('Reading MS2: {}'.format(raw_path), logger)
-        if file_extension.lower() == '.mzxml':
-            raw_data = pastaq.read_mzxml(
-                raw_path,
-                min_mz=params['min_mz'],
-                max_mz=params['max_mz'],
-                min_rt=params['min_rt'],
-                max_rt=params['max_rt'],
-                instrument_type=params['instrument_type'],
-                resolution_ms1=params['resolution_ms1'],
-                resolution_msn=params['resolution_msn'],
-                reference_mz=params['reference_mz'],
-                fwhm_rt=params['avg_fwhm_rt'],
-                polarity=params['polarity'],
-                ms_level=2,
-            )
-        elif file_extension.lower() == '.mzml':
-            raw_data = pastaq.read_mzml(
-                raw_path,
-                min_mz=params['min_mz'],
-                max_mz=params['max_mz'],
-                min_rt=params['min_rt'],
-                max_rt=params['max_rt'],
-                instrument_type=params['instrument_type'],
-                resolution_ms1=params['resolution_ms1'],
-                resolution_msn=params['resolution_msn'],
-                reference_mz=params['reference_mz'],
-                fwhm_rt=params['avg_fwhm_rt'],
-                polarity=params['polarity'],
-                ms_level=2,
-            )
+        _custom_log('Writing MS1: {}'.format(out_path_ms1), logger)
+        raw_data_ms1.dump(out_path_ms1)
 
         # Write raw_data to disk (MS2).
-        _custom_log('Writing MS2: {}'.format(out_path), logger)
-        raw_data.dump(out_path)
+        _custom_log('Writing MS2: {}'.format(out_path_ms2), logger)
+        raw_data_ms2.dump(out_path_ms2)
 
     elapsed_time = datetime.timedelta(seconds=time.time()-time_start)
     _custom_log('Finished raw data parsing in {}'.format(elapsed_time), logger)
@@ -700,7 +639,7 @@ def detect_peaks(params, output_dir, save_grid=False, logger=None, force_overrid
         raw_data = pastaq.read_raw_data(in_path)
 
         _custom_log("Resampling: {}".format(stem), logger)
-        grid = pastaq.resample(
+        grid = pastaq.resample_tiled(
             raw_data,
             params['num_samples_mz'],
             params['num_samples_rt'],
@@ -711,10 +650,12 @@ def detect_peaks(params, output_dir, save_grid=False, logger=None, force_overrid
         if save_grid:
             mesh_path = os.path.join(output_dir, 'grid', "{}.grid".format(stem))
             _custom_log('Writing grid: {}'.format(mesh_path), logger)
-            grid.dump(mesh_path)
+            grid.to_dense().dump(mesh_path)
 
         _custom_log("Finding peaks: {}".format(stem), logger)
-        peaks = pastaq.find_peaks(raw_data, grid, params['max_peaks'])
+        peaks = pastaq.find_peaks(
+            raw_data, grid, params['max_peaks'],
+            refine_fit=params.get('refine_peak_fit', False))
         _custom_log('Writing peaks:'.format(out_path), logger)
         pastaq.write_peaks(peaks, out_path)
 
@@ -1064,43 +1005,45 @@ def create_quantitative_tables(params, output_dir, logger=None, force_override=F
         peaks = pastaq.read_peaks(in_path_peaks)
 
         _custom_log("Generating peaks quantitative table", logger)
+        peaks = pastaq.peaks_to_columns(peaks)
         peaks_df = pd.DataFrame({
-            'peak_id': [peak.id for peak in peaks],
-            'mz': [peak.fitted_mz for peak in peaks],
-            'rt': [peak.fitted_rt for peak in peaks],
-            'rt_delta': [peak.rt_delta for peak in peaks],
-            'height': [peak.fitted_height for peak in peaks],
-            'sigma_mz': [peak.fitted_sigma_mz for peak in peaks],
-            'sigma_rt': [peak.fitted_sigma_rt for peak in peaks],
-            'volume': [peak.fitted_volume for peak in peaks],
-            'smooth_height': [peak.local_max_height for peak in peaks],
-            'smooth_mz': [peak.local_max_mz for peak in peaks],
-            'smooth_rt': [peak.local_max_rt for peak in peaks],
-            'roi_min_mz': [peak.roi_min_mz for peak in peaks],
-            'roi_max_mz': [peak.roi_max_mz for peak in peaks],
-            'roi_min_rt': [peak.roi_min_rt for peak in peaks],
-            'roi_max_rt': [peak.roi_max_rt for peak in peaks],
-            'raw_mean_mz': [peak.raw_roi_mean_mz for peak in peaks],
-            'raw_mean_rt': [peak.raw_roi_mean_rt for peak in peaks],
-            'raw_std_mz': [peak.raw_roi_sigma_mz for peak in peaks],
-            'raw_std_rt': [peak.raw_roi_sigma_rt for peak in peaks],
-            'raw_skewness_mz': [peak.raw_roi_skewness_mz for peak in peaks],
-            'raw_skewness_rt': [peak.raw_roi_skewness_rt for peak in peaks],
-            'raw_kurtosis_mz': [peak.raw_roi_kurtosis_mz for peak in peaks],
-            'raw_kurtosis_rt': [peak.raw_roi_kurtosis_rt for peak in peaks],
-            'raw_total_intensity': [peak.raw_roi_total_intensity for peak in peaks],
-            'num_points': [peak.raw_roi_num_points for peak in peaks],
-            'num_scans': [peak.raw_roi_num_scans for peak in peaks],
+            'peak_id': peaks['id'],
+            'mz': peaks['fitted_mz'],
+            'rt': peaks['fitted_rt'],
+            'rt_delta': peaks['rt_delta'],
+            'height': peaks['fitted_height'],
+            'sigma_mz': peaks['fitted_sigma_mz'],
+            'sigma_rt': peaks['fitted_sigma_rt'],
+            'volume': peaks['fitted_volume'],
+            'smooth_height': peaks['local_max_height'],
+            'smooth_mz': peaks['local_max_mz'],
+            'smooth_rt': peaks['local_max_rt'],
+            'roi_min_mz': peaks['roi_min_mz'],
+            'roi_max_mz': peaks['roi_max_mz'],
+            'roi_min_rt': peaks['roi_min_rt'],
+            'roi_max_rt': peaks['roi_max_rt'],
+            'raw_mean_mz': peaks['raw_roi_mean_mz'],
+            'raw_mean_rt': peaks['raw_roi_mean_rt'],
+            'raw_std_mz': peaks['raw_roi_sigma_mz'],
+            'raw_std_rt': peaks['raw_roi_sigma_rt'],
+            'raw_skewness_mz': peaks['raw_roi_skewness_mz'],
+            'raw_skewness_rt': peaks['raw_roi_skewness_rt'],
+            'raw_kurtosis_mz': peaks['raw_roi_kurtosis_mz'],
+            'raw_kurtosis_rt': peaks['raw_roi_kurtosis_rt'],
+            'raw_total_intensity': peaks['raw_roi_total_intensity'],
+            'num_points': peaks['raw_roi_num_points'],
+            'num_scans': peaks['raw_roi_num_scans'],
         })
 
         # Peak Annotations.
         # =================
         _custom_log("Reading linked peaks from disk: {}".format(stem), logger)
         peak_annotations = peaks_df[["peak_id"]]
-        linked_peaks = pastaq.read_linked_msms(in_path_peaks_link)
+        linked_peaks = pastaq.linked_msms_to_columns(
+            pastaq.read_linked_msms(in_path_peaks_link))
         linked_peaks = pd.DataFrame({
-            'peak_id': [linked_peak.entity_id for linked_peak in linked_peaks],
-            'msms_id': [linked_peak.msms_id for linked_peak in linked_peaks],
+            'peak_id': linked_peaks['entity_id'],
+            'msms_id': linked_peaks['msms_id'],
         })
         peak_annotations = pd.merge(
             peak_annotations, linked_peaks, on="peak_id", how="left")
@@ -1123,12 +1066,12 @@ def create_quantitative_tables(params, output_dir, logger=None, force_override=F
                 if params["quant_ident_linkage"] == 'theoretical_mz':
                     _custom_log(
                         "Reading linked ident_peak from disk: {}".format(stem), logger)
-                    linked_idents = pastaq.read_linked_psm(
-                        in_path_ident_link_theomz)
+                    linked_idents = pastaq.linked_psm_to_columns(
+                        pastaq.read_linked_psm(in_path_ident_link_theomz))
                     linked_idents = pd.DataFrame({
-                        'peak_id': [linked_ident.peak_id for linked_ident in linked_idents],
-                        'psm_index': [linked_ident.psm_index for linked_ident in linked_idents],
-                        'psm_link_distance': [linked_ident.distance for linked_ident in linked_idents],
+                        'peak_id': linked_idents['peak_id'],
+                        'psm_index': linked_idents['psm_index'],
+                        'psm_link_distance': linked_idents['distance'],
                     })
                     linked_idents = pd.merge(
                         linked_idents, psms, on="psm_index")
@@ -1137,12 +1080,12 @@ def create_quantitative_tables(params, output_dir, logger=None, force_override=F
                 elif params["quant_ident_linkage"] == 'msms_event':
                     _custom_log(
                         "Reading linked ident_peak from disk: {}".format(stem), logger)
-                    linked_idents = pastaq.read_linked_msms(
-                        in_path_ident_link_msms)
+                    linked_idents = pastaq.linked_msms_to_columns(
+                        pastaq.read_linked_msms(in_path_ident_link_msms))
                     linked_idents = pd.DataFrame({
-                        'msms_id': [linked_ident.msms_id for linked_ident in linked_idents],
-                        'psm_index': [linked_ident.entity_id for linked_ident in linked_idents],
-                        'psm_link_distance': [linked_ident.distance for linked_ident in linked_idents],
+                        'msms_id': linked_idents['msms_id'],
+                        'psm_index': linked_idents['entity_id'],
+                        'psm_link_distance': linked_idents['distance'],
                     })
                     linked_idents = pd.merge(
                         linked_idents, psms, on="psm_index")
@@ -1216,21 +1159,22 @@ def create_quantitative_tables(params, output_dir, logger=None, force_override=F
                                                         "{}_feature_annotations.csv".format(stem))
 
             _custom_log("Reading features from disk: {}".format(stem), logger)
-            features = pastaq.read_features(in_path_features)
+            features = pastaq.features_to_columns(
+                pastaq.read_features(in_path_features))
 
             _custom_log("Generating features quantitative table", logger)
             features_df = pd.DataFrame({
-                'feature_id': [feature.id for feature in features],
-                'average_mz': [feature.average_mz for feature in features],
-                'average_mz_sigma': [feature.average_mz_sigma for feature in features],
-                'average_rt': [feature.average_rt for feature in features],
-                'average_rt_sigma': [feature.average_rt_sigma for feature in features],
-                'average_rt_delta': [feature.average_rt_delta for feature in features],
-                'total_height': [feature.total_height for feature in features],
-                'monoisotopic_mz': [feature.monoisotopic_mz for feature in features],
-                'monoisotopic_height': [feature.monoisotopic_height for feature in features],
-                'charge_state': [feature.charge_state for feature in features],
-                'peak_id': [feature.peak_ids for feature in features],
+                'feature_id': features['id'],
+                'average_mz': features['average_mz'],
+                'average_mz_sigma': features['average_mz_sigma'],
+                'average_rt': features['average_rt'],
+                'average_rt_sigma': features['average_rt_sigma'],
+                'average_rt_delta': features['average_rt_delta'],
+                'total_height': features['total_height'],
+                'monoisotopic_mz': features['monoisotopic_mz'],
+                'monoisotopic_height': features['monoisotopic_height'],
+                'charge_state': features['charge_state'],
+                'peak_id': features['peak_ids'],
             })
             # Find the peak annotations that belong to each feature.
             feature_annotations = features_df[[
@@ -1296,33 +1240,32 @@ def create_quantitative_tables(params, output_dir, logger=None, force_override=F
         return pd.Series(ret)
 
     if (not os.path.exists(out_path_peak_clusters_metadata) or force_override):
-        peak_clusters = pastaq.read_peak_clusters(in_path_peak_clusters)
+        peak_clusters = pastaq.peak_clusters_to_columns(
+            pastaq.read_peak_clusters(in_path_peak_clusters), len(input_files))
         _custom_log("Generating peak clusters quantitative table", logger)
         peak_clusters_metadata_df = pd.DataFrame({
-            'cluster_id': [cluster.id for cluster in peak_clusters],
-            'mz': [cluster.mz for cluster in peak_clusters],
-            'rt': [cluster.rt for cluster in peak_clusters],
-            'avg_height': [cluster.avg_height for cluster in peak_clusters],
+            'cluster_id': peak_clusters['id'],
+            'mz': peak_clusters['mz'],
+            'rt': peak_clusters['rt'],
+            'avg_height': peak_clusters['avg_height'],
         })
 
         _custom_log("Generating peak clusters quantitative table", logger)
         peak_clusters_df = pd.DataFrame({
-            'cluster_id': [cluster.id for cluster in peak_clusters],
+            'cluster_id': peak_clusters['id'],
         })
         if params['quant_isotopes'] == 'volume':
             out_path_peak_clusters = os.path.join(output_dir, 'quant',
                                                   "peak_clusters_volume.csv")
             for i, input_file in enumerate(input_files):
                 stem = input_file['stem']
-                peak_clusters_df[stem] = [cluster.file_volumes[i]
-                                          for cluster in peak_clusters]
+                peak_clusters_df[stem] = peak_clusters['volumes'][:, i]
         elif params['quant_isotopes'] == 'height':
             out_path_peak_clusters = os.path.join(output_dir, 'quant',
                                                   "peak_clusters_height.csv")
             for i, input_file in enumerate(input_files):
                 stem = input_file['stem']
-                peak_clusters_df[stem] = [cluster.heights[i]
-                                          for cluster in peak_clusters]
+                peak_clusters_df[stem] = peak_clusters['heights'][:, i]
         else:
             raise ValueError("unknown quant_isotopes parameter")
         _custom_log("Writing peaks quantitative table to disk", logger)
@@ -1330,15 +1273,9 @@ def create_quantitative_tables(params, output_dir, logger=None, force_override=F
 
         # Peak associations.
         _custom_log("Generating peak clusters peak associations table", logger)
-        cluster_peaks = [(cluster.id, cluster.peak_ids)
-                         for cluster in peak_clusters]
-        cluster_peaks = pd.DataFrame(cluster_peaks, columns=[
-                                     "cluster_id", "peak_ids"]).explode("peak_ids")
-        cluster_peaks["file_id"] = cluster_peaks["peak_ids"].map(
-            lambda x: input_files[x.file_id]['stem'])
-        cluster_peaks["peak_id"] = cluster_peaks["peak_ids"].map(
-            lambda x: x.peak_id)
-        cluster_peaks = cluster_peaks.drop(["peak_ids"], axis=1)
+        stems = np.array([input_file['stem'] for input_file in input_files])
+        cluster_peaks = pd.DataFrame(peak_clusters['peak_ids'])
+        cluster_peaks["file_id"] = stems[cluster_peaks["file_id"]]
         _custom_log("Writing cluster to peak table to disk", logger)
         cluster_peaks.to_csv(out_path_peak_clusters_peaks, index=False)
 
@@ -1429,62 +1366,57 @@ def create_quantitative_tables(params, output_dir, logger=None, force_override=F
     out_path_feature_clusters_annotations = os.path.join(output_dir, 'quant',
                                                          "feature_clusters_annotations.csv")
     if (not os.path.exists(out_path_feature_clusters_metadata) or force_override):
-        feature_clusters = pastaq.read_feature_clusters(
-            in_path_feature_clusters)
+        feature_clusters = pastaq.feature_clusters_to_columns(
+            pastaq.read_feature_clusters(in_path_feature_clusters),
+            len(input_files))
 
         _custom_log("Generating feature clusters quantitative table", logger)
         metadata = pd.DataFrame({
-            'cluster_id': [cluster.id for cluster in feature_clusters],
-            'mz': [cluster.mz for cluster in feature_clusters],
-            'rt': [cluster.rt for cluster in feature_clusters],
-            'avg_height': [cluster.avg_total_height for cluster in feature_clusters],
-            'charge_state': [cluster.charge_state for cluster in feature_clusters],
+            'cluster_id': feature_clusters['id'],
+            'mz': feature_clusters['mz'],
+            'rt': feature_clusters['rt'],
+            'avg_height': feature_clusters['avg_total_height'],
+            'charge_state': feature_clusters['charge_state'],
         })
         data = pd.DataFrame({
-            'cluster_id': [cluster.id for cluster in feature_clusters],
+            'cluster_id': feature_clusters['id'],
         })
         if params['quant_features'] == 'monoisotopic_height':
             out_path_feature_clusters = os.path.join(output_dir, 'quant',
                                                      "feature_clusters_monoisotopic_height.csv")
             for i, input_file in enumerate(input_files):
                 stem = input_file['stem']
-                data[stem] = [cluster.monoisotopic_heights[i]
-                                             for cluster in feature_clusters]
+                data[stem] = feature_clusters['monoisotopic_heights'][:, i]
         elif params['quant_features'] == 'monoisotopic_volume':
             out_path_feature_clusters = os.path.join(output_dir, 'quant',
                                                      "feature_clusters_monoisotopic_volume.csv")
             for i, input_file in enumerate(input_files):
                 stem = input_file['stem']
-                data[stem] = [cluster.monoisotopic_volumes[i]
-                                             for cluster in feature_clusters]
+                data[stem] = feature_clusters['monoisotopic_volumes'][:, i]
         elif params['quant_features'] == 'total_height':
             out_path_feature_clusters = os.path.join(output_dir, 'quant',
                                                      "feature_clusters_total_height.csv")
             for i, input_file in enumerate(input_files):
                 stem = input_file['stem']
-                data[stem] = [cluster.total_heights[i]
-                                             for cluster in feature_clusters]
+                data[stem] = feature_clusters['total_heights'][:, i]
         elif params['quant_features'] == 'total_volume':
             out_path_feature_clusters = os.path.join(output_dir, 'quant',
                                                      "feature_clusters_total_volume.csv")
             for i, input_file in enumerate(input_files):
                 stem = input_file['stem']
-                data[stem] = [cluster.total_volumes[i]
-                                             for cluster in feature_clusters]
+                data[stem] = feature_clusters['total_volumes'][:, i]
         elif params['quant_features'] == 'max_height':
             out_path_feature_clusters = os.path.join(output_dir, 'quant',
                                                      "feature_clusters_max_height.csv")
             for i, input_file in enumerate(input_files):
                 stem = input_file['stem']
-                data[stem] = [cluster.max_heights[i]
-                                             for cluster in feature_clusters]
+                data[stem] = feature_clusters['max_heights'][:, i]
         elif params['quant_features'] == 'max_volume':
             out_path_feature_clusters = os.path.join(output_dir, 'quant',
                                                      "feature_clusters_max_volume.csv")
             for i, input_file in enumerate(input_files):
                 stem = input_file['stem']
-                data[stem] = [cluster.max_volumes[i]
-                                             for cluster in feature_clusters]
+                data[stem] = feature_clusters['max_volumes'][:, i]
         else:
             raise ValueError("unknown quant_features parameter")
         _custom_log("Writing feature clusters quantitative table to disk", logger)
@@ -1492,15 +1424,9 @@ def create_quantitative_tables(params, output_dir, logger=None, force_override=F
 
         # Feature associations.
         _custom_log("Generating feature clusters feature associations table", logger)
-        cluster_features = [(cluster.id, cluster.feature_ids)
-                            for cluster in feature_clusters]
-        cluster_features = pd.DataFrame(cluster_features, columns=[
-                                        "cluster_id", "feature_ids"]).explode("feature_ids")
-        cluster_features["file_id"] = cluster_features["feature_ids"].map(
-            lambda x: input_files[x.file_id]['stem'])
-        cluster_features["feature_id"] = cluster_features["feature_ids"].map(
-            lambda x: x.feature_id)
-        cluster_features = cluster_features.drop(["feature_ids"], axis=1)
+        stems = np.array([input_file['stem'] for input_file in input_files])
+        cluster_features = pd.DataFrame(feature_clusters['feature_ids'])
+        cluster_features["file_id"] = stems[cluster_features["file_id"]]
         _custom_log("Writing cluster to feature table to disk", logger)
         cluster_features.to_csv(
             out_path_feature_clusters_features, index=False)
@@ -1515,11 +1441,13 @@ def create_quantitative_tables(params, output_dir, logger=None, force_override=F
                                                  "{}.features".format(stem))
             in_path_peak_annotations = os.path.join(output_dir, 'quant',
                                                     "{}_peak_annotations.csv".format(stem))
-            features = pastaq.read_features(in_path_peak_features)
-            features = [(feature.id, feature.peak_ids, feature.charge_state)
-                        for feature in features]
-            features = pd.DataFrame(
-                features, columns=["feature_id", "peak_id", "charge_state"]).explode("peak_id")
+            features = pastaq.features_to_columns(
+                pastaq.read_features(in_path_peak_features))
+            features = pd.DataFrame({
+                'feature_id': features['id'],
+                'peak_id': features['peak_ids'],
+                'charge_state': features['charge_state'],
+            }).explode("peak_id")
             peak_annotations = pd.read_csv(
                 in_path_peak_annotations, low_memory=False)
             cluster_annotations = cluster_features[cluster_features["file_id"] == stem][[
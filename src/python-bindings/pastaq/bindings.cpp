@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <cassert>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <thread>
 #include <tuple>
 
@@ -21,11 +23,14 @@
 #include "protein_inference/protein_inference.hpp"
 #include "protein_inference/protein_inference_serialize.hpp"
 #include "raw_data/raw_data.hpp"
+#include "raw_data/raw_data_columnar.hpp"
 #include "raw_data/raw_data_serialize.hpp"
 #include "raw_data/xml_reader.hpp"
 #include "utils/compression.hpp"
+#include "utils/mapped_file.hpp"
 #include "utils/search.hpp"
 #include "utils/serialization.hpp"
+#include "utils/thread_pool.hpp"
 #include "warp2d/warp2d.hpp"
 #include "warp2d/warp2d_serialize.hpp"
 
@@ -102,10 +107,9 @@ RawData::RawData read_mzxml(std::string &input_file, double min_mz,
         throw std::invalid_argument(error_stream.str());
     }
 
-    // Open file stream.
-    std::ifstream stream;
-    stream.open(input_file);
-    if (!stream) {
+    // Map the input file in memory.
+    MappedFile::File file;
+    if (!file.open(input_file)) {
         pybind11::gil_scoped_acquire acquire;
         std::ostringstream error_stream;
         error_stream << "error: couldn't open input file" << input_file;
@@ -113,7 +117,7 @@ RawData::RawData read_mzxml(std::string &input_file, double min_mz,
     }
 
     auto raw_data = XmlReader::read_mzxml(
-        stream, min_mz, max_mz, min_rt, max_rt, instrument_type, resolution_ms1,
+        file.view(), min_mz, max_mz, min_rt, max_rt, instrument_type, resolution_ms1,
         resolution_msn, reference_mz, polarity, ms_level);
     if (!raw_data) {
         pybind11::gil_scoped_acquire acquire;
@@ -133,7 +137,8 @@ RawData::RawData read_mzml(std::string &input_file, double min_mz,
                            std::string instrument_type_str,
                            double resolution_ms1, double resolution_msn,
                            double reference_mz, double fwhm_rt,
-                           std::string polarity_str, size_t ms_level) {
+                           std::string polarity_str, size_t ms_level,
+                           size_t max_threads) {
     pybind11::gil_scoped_release release;
     // Setup infinite range if no point was specified.
     min_rt = min_rt < 0 ? 0 : min_rt;
@@ -198,10 +203,9 @@ RawData::RawData read_mzml(std::string &input_file, double min_mz,
         throw std::invalid_argument(error_stream.str());
     }
 
-    // Open file stream.
-    std::ifstream stream;
-    stream.open(input_file);
-    if (!stream) {
+    // Map the input file in memory.
+    MappedFile::File file;
+    if (!file.open(input_file)) {
         pybind11::gil_scoped_acquire acquire;
         std::ostringstream error_stream;
         error_stream << "error: couldn't open input file" << input_file;
@@ -209,8 +213,8 @@ RawData::RawData read_mzml(std::string &input_file, double min_mz,
     }
 
     auto raw_data = XmlReader::read_mzml(
-        stream, min_mz, max_mz, min_rt, max_rt, instrument_type, resolution_ms1,
-        resolution_msn, reference_mz, polarity, ms_level);
+        file.view(), min_mz, max_mz, min_rt, max_rt, instrument_type, resolution_ms1,
+        resolution_msn, reference_mz, polarity, ms_level, max_threads);
     if (!raw_data) {
         pybind11::gil_scoped_acquire acquire;
         std::ostringstream error_stream;
@@ -224,6 +228,129 @@ RawData::RawData read_mzml(std::string &input_file, double min_mz,
     return raw_data.value();
 }
 
+std::vector<RawData::RawData> read_raw_levels(
+    std::string &input_file, double min_mz, double max_mz, double min_rt,
+    double max_rt, std::string instrument_type_str, double resolution_ms1,
+    double resolution_msn, double reference_mz, double fwhm_rt,
+    std::string polarity_str, std::vector<size_t> ms_levels,
+    size_t max_threads) {
+    pybind11::gil_scoped_release release;
+    // Setup infinite range if no point was specified.
+    min_rt = min_rt < 0 ? 0 : min_rt;
+    max_rt = max_rt < 0 ? std::numeric_limits<double>::infinity() : max_rt;
+    min_mz = min_mz < 0 ? 0 : min_mz;
+    max_mz = max_mz < 0 ? std::numeric_limits<double>::infinity() : max_mz;
+
+    // Find the file format from the extension.
+    std::string extension = "";
+    size_t dot = input_file.rfind('.');
+    if (dot != std::string::npos) {
+        extension = input_file.substr(dot);
+    }
+    for (auto &ch : extension) {
+        ch = std::tolower(ch);
+    }
+    if (extension != ".mzxml" && extension != ".mzml") {
+        pybind11::gil_scoped_acquire acquire;
+        std::ostringstream error_stream;
+        error_stream << "error: unknown file format for " << input_file
+                     << ", expected an .mzXML or .mzML file";
+        throw std::invalid_argument(error_stream.str());
+    }
+
+    // Parse the instrument type.
+    auto instrument_type = Instrument::UNKNOWN;
+    for (auto &ch : instrument_type_str) {
+        ch = std::tolower(ch);
+    }
+    if (instrument_type_str == "orbitrap") {
+        instrument_type = Instrument::ORBITRAP;
+    } else if (instrument_type_str == "tof") {
+        instrument_type = Instrument::TOF;
+    } else if (instrument_type_str == "quad" || instrument_type_str == "quadrupole") {
+        instrument_type = Instrument::QUAD;
+    } else if (instrument_type_str == "fticr" || instrument_type_str == "ft-icr" ) {
+        instrument_type = Instrument::FTICR;
+    } else {
+        pybind11::gil_scoped_acquire acquire;
+        std::ostringstream error_stream;
+        error_stream << "the given instrument is not supported";
+        throw std::invalid_argument(error_stream.str());
+    }
+    // Parse the polarity.
+    auto polarity = Polarity::BOTH;
+    for (auto &ch : polarity_str) {
+        ch = std::tolower(ch);
+    }
+    if (polarity_str == "" || polarity_str == "both" || polarity_str == "+-" ||
+        polarity_str == "-+") {
+        polarity = Polarity::BOTH;
+    } else if (polarity_str == "+" || polarity_str == "pos" ||
+               polarity_str == "positive") {
+        polarity = Polarity::POSITIVE;
+    } else if (polarity_str == "-" || polarity_str == "neg" ||
+               polarity_str == "negative") {
+        polarity = Polarity::NEGATIVE;
+    } else {
+        pybind11::gil_scoped_acquire acquire;
+        std::ostringstream error_stream;
+        error_stream << "the given polarity is not supported. choose "
+                        "between '+', '-', 'both' (default)";
+        throw std::invalid_argument(error_stream.str());
+    }
+
+    // Sanity check the min/max rt/mz.
+    if (min_rt >= max_rt) {
+        pybind11::gil_scoped_acquire acquire;
+        std::ostringstream error_stream;
+        error_stream << "error: min_rt >= max_rt (min_rt: " << min_rt
+                     << ", max_rt: " << max_rt << ")";
+        throw std::invalid_argument(error_stream.str());
+    }
+    if (min_mz >= max_mz) {
+        pybind11::gil_scoped_acquire acquire;
+        std::ostringstream error_stream;
+        error_stream << "error: min_mz >= max_mz (min_mz: " << min_mz
+                     << ", max_mz: " << max_mz << ")";
+        throw std::invalid_argument(error_stream.str());
+    }
+
+    // Map the input file in memory.
+    MappedFile::File file;
+    if (!file.open(input_file)) {
+        pybind11::gil_scoped_acquire acquire;
+        std::ostringstream error_stream;
+        error_stream << "error: couldn't open input file" << input_file;
+        throw std::invalid_argument(error_stream.str());
+    }
+
+    std::optional<std::vector<RawData::RawData>> raw_data;
+    if (extension == ".mzxml") {
+        raw_data = XmlReader::read_mzxml_levels(
+            file.view(), min_mz, max_mz, min_rt, max_rt, instrument_type,
+            resolution_ms1, resolution_msn, reference_mz, polarity,
+            ms_levels);
+    } else {
+        raw_data = XmlReader::read_mzml_levels(
+            file.view(), min_mz, max_mz, min_rt, max_rt, instrument_type,
+            resolution_ms1, resolution_msn, reference_mz, polarity,
+            ms_levels, max_threads);
+    }
+    if (!raw_data) {
+        pybind11::gil_scoped_acquire acquire;
+        std::ostringstream error_stream;
+        error_stream << "error: an error occurred when reading the file"
+                     << input_file;
+        throw std::invalid_argument(error_stream.str());
+    }
+    for (auto &level : raw_data.value()) {
+        level.fwhm_rt = fwhm_rt;
+    }
+
+    pybind11::gil_scoped_acquire acquire;
+    return std::move(raw_data.value());
+}
+
 Xic::Xic xic(const RawData::RawData &raw_data, double min_mz, double max_mz,
              double min_rt, double max_rt, std::string method_str) {
     pybind11::gil_scoped_release release;
@@ -246,20 +373,91 @@ Xic::Xic xic(const RawData::RawData &raw_data, double min_mz, double max_mz,
     return RawData::xic(raw_data, min_mz, max_mz, min_rt, max_rt, method);
 }
 
-Grid::Grid resample(const RawData::RawData &raw_data, uint64_t num_samples_mz,
-                    uint64_t num_samples_rt, double smoothing_coef_mz,
-                    double smoothing_coef_rt) {
+Xic::Batch xic_batch(const RawData::RawData &raw_data,
+                     const std::vector<double> &min_mz,
+                     const std::vector<double> &max_mz,
+                     const std::vector<double> &min_rt,
+                     const std::vector<double> &max_rt, std::string method_str,
+                     size_t max_threads) {
+    pybind11::gil_scoped_release release;
+    auto method = Xic::UNKNOWN;
+    for (auto &ch : method_str) {
+        ch = std::tolower(ch);
+    }
+    if (method_str == "max") {
+        method = Xic::MAX;
+    } else if (method_str == "sum") {
+        method = Xic::SUM;
+    } else {
+        pybind11::gil_scoped_acquire acquire;
+        std::ostringstream error_stream;
+        error_stream << "the given xic method is not supported";
+        throw std::invalid_argument(error_stream.str());
+    }
+    if (min_mz.size() != max_mz.size() || min_mz.size() != min_rt.size() ||
+        min_mz.size() != max_rt.size()) {
+        pybind11::gil_scoped_acquire acquire;
+        std::ostringstream error_stream;
+        error_stream << "error: the length of min/max_mz/rt don't match";
+        throw std::invalid_argument(error_stream.str());
+    }
+    std::vector<Xic::Window> windows(min_mz.size());
+    for (size_t i = 0; i < windows.size(); ++i) {
+        windows[i] = {min_mz[i], max_mz[i], min_rt[i], max_rt[i]};
+    }
+    auto batch = RawData::xic_batch(raw_data, windows, method, max_threads);
+    pybind11::gil_scoped_acquire acquire;
+    return batch;
+}
+
+template <typename T>
+Grid::BasicGrid<T> resample(const RawData::RawData &raw_data,
+                            uint64_t num_samples_mz, uint64_t num_samples_rt,
+                            double smoothing_coef_mz, double smoothing_coef_rt,
+                            size_t max_threads) {
     pybind11::gil_scoped_release release;
     auto params = Grid::ResampleParams{};
     params.num_samples_mz = num_samples_mz;
     params.num_samples_rt = num_samples_rt;
     params.smoothing_coef_mz = smoothing_coef_mz;
     params.smoothing_coef_rt = smoothing_coef_rt;
-    auto grid =  Grid::resample(raw_data, params);
+    auto grid = Grid::resample<T>(raw_data, params, max_threads);
     pybind11::gil_scoped_acquire acquire;
     return grid;
 }
 
+Grid::TiledGrid resample_tiled(const RawData::RawData &raw_data,
+                               uint64_t num_samples_mz,
+                               uint64_t num_samples_rt,
+                               double smoothing_coef_mz,
+                               double smoothing_coef_rt, size_t max_threads) {
+    pybind11::gil_scoped_release release;
+    auto params = Grid::ResampleParams{};
+    params.num_samples_mz = num_samples_mz;
+    params.num_samples_rt = num_samples_rt;
+    params.smoothing_coef_mz = smoothing_coef_mz;
+    params.smoothing_coef_rt = smoothing_coef_rt;
+    auto grid = Grid::resample_tiled(raw_data, params, max_threads);
+    pybind11::gil_scoped_acquire acquire;
+    return grid;
+}
+
+std::vector<Centroid::Peak> find_peaks_streaming(
+    const RawData::RawData &raw_data, uint64_t num_samples_mz,
+    uint64_t num_samples_rt, double smoothing_coef_mz,
+    double smoothing_coef_rt, size_t max_peaks, bool refine_fit) {
+    pybind11::gil_scoped_release release;
+    auto params = Grid::ResampleParams{};
+    params.num_samples_mz = num_samples_mz;
+    params.num_samples_rt = num_samples_rt;
+    params.smoothing_coef_mz = smoothing_coef_mz;
+    params.smoothing_coef_rt = smoothing_coef_rt;
+    auto peaks = Centroid::find_peaks_streaming(raw_data, params, max_peaks,
+                                                refine_fit);
+    pybind11::gil_scoped_acquire acquire;
+    return peaks;
+}
+
 std::string to_string(const Instrument::Type &instrument_type) {
     switch (instrument_type) {
         case Instrument::QUAD:
@@ -359,12 +557,35 @@ SimilarityResults find_similarity(std::vector<Centroid::Peak> &peak_list_a,
     return results;
 }
 
-void write_raw_data(const RawData::RawData &raw_data,
-                    std::string &output_file) {
+void write_raw_data(const RawData::RawData &raw_data, std::string &output_file,
+                    bool legacy_format) {
     pybind11::gil_scoped_release release;
+    // Files in the legacy format are compressed as a whole, and can be read
+    // by older versions.
+    if (legacy_format) {
+        Compression::DeflateStream stream;
+        stream.open(output_file);
+        if (!stream) {
+            pybind11::gil_scoped_acquire acquire;
+            std::ostringstream error_stream;
+            error_stream << "error: couldn't open output file" << output_file;
+            throw std::invalid_argument(error_stream.str());
+        }
+        if (!RawData::Serialize::write_raw_data(stream, raw_data)) {
+            pybind11::gil_scoped_acquire acquire;
+            std::ostringstream error_stream;
+            error_stream
+                << "error: couldn't write the raw_data into the output file"
+                << output_file;
+            throw std::invalid_argument(error_stream.str());
+        }
+        pybind11::gil_scoped_acquire acquire;
+        return;
+    }
+
     // Open file stream.
-    Compression::DeflateStream stream;
-    stream.open(output_file);
+    std::ofstream stream;
+    stream.open(output_file, std::ios::out | std::ios::binary);
     if (!stream) {
         pybind11::gil_scoped_acquire acquire;
         std::ostringstream error_stream;
@@ -372,7 +593,7 @@ void write_raw_data(const RawData::RawData &raw_data,
         throw std::invalid_argument(error_stream.str());
     }
 
-    if (!RawData::Serialize::write_raw_data(stream, raw_data)) {
+    if (!RawData::Columnar::write_raw_data(stream, raw_data)) {
         pybind11::gil_scoped_acquire acquire;
         std::ostringstream error_stream;
         error_stream
@@ -383,28 +604,56 @@ void write_raw_data(const RawData::RawData &raw_data,
     pybind11::gil_scoped_acquire acquire;
 }
 
-RawData::RawData read_raw_data(std::string &input_file) {
+RawData::RawData read_raw_data(std::string &input_file, double min_rt,
+                               double max_rt) {
     pybind11::gil_scoped_release release;
-    // Open file stream.
-    Compression::InflateStream stream;
-    stream.open(input_file);
-    if (!stream) {
+    // Map the input file in memory.
+    MappedFile::File file;
+    if (!file.open(input_file)) {
         pybind11::gil_scoped_acquire acquire;
         std::ostringstream error_stream;
         error_stream << "error: couldn't open input file" << input_file;
         throw std::invalid_argument(error_stream.str());
     }
 
-    RawData::RawData raw_data;
-    if (!RawData::Serialize::read_raw_data(stream, &raw_data)) {
+    if (min_rt < 0) {
+        min_rt = -std::numeric_limits<double>::infinity();
+    }
+    if (max_rt < 0) {
+        max_rt = std::numeric_limits<double>::infinity();
+    }
+
+    // Files written by older versions use the compressed serialization format
+    // and have to be read entirely before dropping the scans out of range.
+    if (!RawData::Columnar::is_columnar(file.view())) {
+        file.close();
+        Compression::InflateStream stream;
+        stream.open(input_file);
+        RawData::RawData raw_data;
+        if (!stream || !RawData::Serialize::read_raw_data(stream, &raw_data)) {
+            pybind11::gil_scoped_acquire acquire;
+            std::ostringstream error_stream;
+            error_stream << "error: couldn't read the raw_data from the input "
+                            "file"
+                         << input_file;
+            throw std::invalid_argument(error_stream.str());
+        }
+        RawData::filter_retention_time(raw_data, min_rt, max_rt);
+        pybind11::gil_scoped_acquire acquire;
+        return raw_data;
+    }
+
+    auto raw_data = RawData::Columnar::read_raw_data(file.view(), min_rt,
+                                                     max_rt);
+    if (!raw_data) {
         pybind11::gil_scoped_acquire acquire;
         std::ostringstream error_stream;
-        error_stream << "error: couldn't write the raw_data into the input file"
+        error_stream << "error: couldn't read the raw_data from the input file"
                      << input_file;
         throw std::invalid_argument(error_stream.str());
     }
     pybind11::gil_scoped_acquire acquire;
-    return raw_data;
+    return std::move(raw_data.value());
 }
 
 void write_grid(const Grid::Grid &grid, std::string &output_file) {
@@ -913,16 +1162,15 @@ IdentData::IdentData read_mzidentml(std::string &input_file, bool ignore_decoy,
     min_mz = min_mz < 0 ? 0 : min_mz;
     max_mz = max_mz < 0 ? std::numeric_limits<double>::infinity() : max_mz;
 
-    // Open file stream.
-    std::ifstream stream;
-    stream.open(input_file);
-    if (!stream) {
+    // Map the input file in memory.
+    MappedFile::File file;
+    if (!file.open(input_file)) {
         pybind11::gil_scoped_acquire acquire;
         std::ostringstream error_stream;
         error_stream << "error: couldn't open input file" << input_file;
         throw std::invalid_argument(error_stream.str());
     }
-    auto ident_data = XmlReader::read_mzidentml(stream, ignore_decoy, require_threshold,
+    auto ident_data = XmlReader::read_mzidentml(file.view(), ignore_decoy, require_threshold,
                                      max_rank_only, min_mz, max_mz, min_rt, max_rt);
     pybind11::gil_scoped_acquire acquire;
     return ident_data;
@@ -966,12 +1214,314 @@ std::vector<MetaMatch::PeakCluster> find_peak_clusters(
     return clusters;
 }
 
+// Create a read only NumPy array that shares the memory of the given vector,
+// instead of copying it into a Python list. The array keeps the owner object
+// alive, so the vector must belong to it.
+template <typename T>
+py::array_t<T> numpy_view(const std::vector<T> &values, py::handle owner) {
+    py::array_t<T> array(values.size(), values.data(), owner);
+    py::detail::array_proxy(array.ptr())->flags &=
+        ~py::detail::npy_api::NPY_ARRAY_WRITEABLE_;
+    return array;
+}
+
+// Getter for a vector member of a bound class, returned as a NumPy view.
+template <typename Class, typename Base, typename T>
+auto numpy_member(std::vector<T> Base::*member) {
+    return [member](py::object self) {
+        return numpy_view(self.cast<const Class &>().*member, self);
+    };
+}
+
+// Record type used to export RawPoints as a NumPy structured array.
+struct RawPoint {
+    double rt;
+    double mz;
+    double intensity;
+};
+
+py::array_t<RawPoint> raw_points_to_numpy(const RawData::RawPoints &points) {
+    py::array_t<RawPoint> array(points.rt.size());
+    auto records = array.mutable_unchecked<1>();
+    for (size_t i = 0; i < points.rt.size(); ++i) {
+        records(i) = {points.rt[i], points.mz[i], points.intensity[i]};
+    }
+    return array;
+}
+
+py::array_t<Centroid::Peak> peaks_to_numpy(
+    const std::vector<Centroid::Peak> &peaks) {
+    return py::array_t<Centroid::Peak>(peaks.size(), peaks.data());
+}
+
+// The following functions export a list of structs as a dict of contiguous
+// NumPy columns, so that tables can be built without accessing the
+// attributes of each element from Python.
+template <typename Row, typename Value>
+void add_column(py::dict &columns, const char *name,
+                const std::vector<Row> &rows, Value Row::*member) {
+    py::array_t<Value> column(rows.size());
+    auto values = column.mutable_unchecked<1>();
+    for (size_t i = 0; i < rows.size(); ++i) {
+        values(i) = rows[i].*member;
+    }
+    columns[name] = column;
+}
+
+// Per file values are stored as a matrix with one row per element and one
+// column per file. Missing values are set to NaN.
+template <typename Row>
+void add_file_columns(py::dict &columns, const char *name,
+                      const std::vector<Row> &rows,
+                      std::vector<double> Row::*member, size_t num_files) {
+    auto matrix = MetaMatch::file_values_matrix(rows, member, num_files);
+    columns[name] =
+        py::array_t<double>({rows.size(), num_files}, matrix.data());
+}
+
+py::dict peaks_to_columns(const std::vector<Centroid::Peak> &peaks) {
+    py::dict columns;
+    add_column(columns, "id", peaks, &Centroid::Peak::id);
+    add_column(columns, "local_max_mz", peaks, &Centroid::Peak::local_max_mz);
+    add_column(columns, "local_max_rt", peaks, &Centroid::Peak::local_max_rt);
+    add_column(columns, "local_max_height", peaks,
+               &Centroid::Peak::local_max_height);
+    add_column(columns, "rt_delta", peaks, &Centroid::Peak::rt_delta);
+    add_column(columns, "roi_min_mz", peaks, &Centroid::Peak::roi_min_mz);
+    add_column(columns, "roi_max_mz", peaks, &Centroid::Peak::roi_max_mz);
+    add_column(columns, "roi_min_rt", peaks, &Centroid::Peak::roi_min_rt);
+    add_column(columns, "roi_max_rt", peaks, &Centroid::Peak::roi_max_rt);
+    add_column(columns, "raw_roi_mean_mz", peaks,
+               &Centroid::Peak::raw_roi_mean_mz);
+    add_column(columns, "raw_roi_mean_rt", peaks,
+               &Centroid::Peak::raw_roi_mean_rt);
+    add_column(columns, "raw_roi_sigma_mz", peaks,
+               &Centroid::Peak::raw_roi_sigma_mz);
+    add_column(columns, "raw_roi_sigma_rt", peaks,
+               &Centroid::Peak::raw_roi_sigma_rt);
+    add_column(columns, "raw_roi_skewness_mz", peaks,
+               &Centroid::Peak::raw_roi_skewness_mz);
+    add_column(columns, "raw_roi_skewness_rt", peaks,
+               &Centroid::Peak::raw_roi_skewness_rt);
+    add_column(columns, "raw_roi_kurtosis_mz", peaks,
+               &Centroid::Peak::raw_roi_kurtosis_mz);
+    add_column(columns, "raw_roi_kurtosis_rt", peaks,
+               &Centroid::Peak::raw_roi_kurtosis_rt);
+    add_column(columns, "raw_roi_max_height", peaks,
+               &Centroid::Peak::raw_roi_max_height);
+    add_column(columns, "raw_roi_total_intensity", peaks,
+               &Centroid::Peak::raw_roi_total_intensity);
+    add_column(columns, "raw_roi_num_points", peaks,
+               &Centroid::Peak::raw_roi_num_points);
+    add_column(columns, "raw_roi_num_scans", peaks,
+               &Centroid::Peak::raw_roi_num_scans);
+    add_column(columns, "fitted_height", peaks, &Centroid::Peak::fitted_height);
+    add_column(columns, "fitted_mz", peaks, &Centroid::Peak::fitted_mz);
+    add_column(columns, "fitted_rt", peaks, &Centroid::Peak::fitted_rt);
+    add_column(columns, "fitted_sigma_mz", peaks,
+               &Centroid::Peak::fitted_sigma_mz);
+    add_column(columns, "fitted_sigma_rt", peaks,
+               &Centroid::Peak::fitted_sigma_rt);
+    add_column(columns, "fitted_volume", peaks, &Centroid::Peak::fitted_volume);
+    return columns;
+}
+
+// The peak ids of each feature are stored as a list of lists, matching the
+// peak_ids attribute of Feature.
+py::dict features_to_columns(
+    const std::vector<FeatureDetection::Feature> &features) {
+    using FeatureDetection::Feature;
+    py::dict columns;
+    add_column(columns, "id", features, &Feature::id);
+    add_column(columns, "score", features, &Feature::score);
+    add_column(columns, "average_rt", features, &Feature::average_rt);
+    add_column(columns, "average_rt_delta", features,
+               &Feature::average_rt_delta);
+    add_column(columns, "average_rt_sigma", features,
+               &Feature::average_rt_sigma);
+    add_column(columns, "average_mz", features, &Feature::average_mz);
+    add_column(columns, "average_mz_sigma", features,
+               &Feature::average_mz_sigma);
+    add_column(columns, "total_height", features, &Feature::total_height);
+    add_column(columns, "total_volume", features, &Feature::total_volume);
+    add_column(columns, "max_height", features, &Feature::max_height);
+    add_column(columns, "max_volume", features, &Feature::max_volume);
+    add_column(columns, "monoisotopic_mz", features, &Feature::monoisotopic_mz);
+    add_column(columns, "monoisotopic_rt", features, &Feature::monoisotopic_rt);
+    add_column(columns, "monoisotopic_height", features,
+               &Feature::monoisotopic_height);
+    add_column(columns, "monoisotopic_volume", features,
+               &Feature::monoisotopic_volume);
+    add_column(columns, "charge_state", features, &Feature::charge_state);
+    py::list peak_ids(features.size());
+    for (size_t i = 0; i < features.size(); ++i) {
+        peak_ids[i] = py::cast(features[i].peak_ids);
+    }
+    columns["peak_ids"] = peak_ids;
+    return columns;
+}
+
+// The peak ids of the clusters are returned as a separate table under the
+// peak_ids key, with one row per associated peak and the cluster_id, file_id
+// and peak_id columns.
+py::dict peak_clusters_to_columns(
+    const std::vector<MetaMatch::PeakCluster> &clusters, size_t num_files) {
+    using MetaMatch::PeakCluster;
+    py::dict columns;
+    add_column(columns, "id", clusters, &PeakCluster::id);
+    add_column(columns, "mz", clusters, &PeakCluster::mz);
+    add_column(columns, "rt", clusters, &PeakCluster::rt);
+    add_column(columns, "avg_height", clusters, &PeakCluster::avg_height);
+    add_column(columns, "avg_volume", clusters, &PeakCluster::avg_volume);
+    add_file_columns(columns, "heights", clusters, &PeakCluster::heights,
+                     num_files);
+    add_file_columns(columns, "volumes", clusters, &PeakCluster::volumes,
+                     num_files);
+    std::vector<uint64_t> cluster_ids;
+    std::vector<MetaMatch::PeakId> peak_ids;
+    for (const auto &cluster : clusters) {
+        for (const auto &peak_id : cluster.peak_ids) {
+            cluster_ids.push_back(cluster.id);
+            peak_ids.push_back(peak_id);
+        }
+    }
+    py::dict peak_ids_columns;
+    peak_ids_columns["cluster_id"] =
+        py::array_t<uint64_t>(cluster_ids.size(), cluster_ids.data());
+    add_column(peak_ids_columns, "file_id", peak_ids,
+               &MetaMatch::PeakId::file_id);
+    add_column(peak_ids_columns, "peak_id", peak_ids,
+               &MetaMatch::PeakId::peak_id);
+    columns["peak_ids"] = peak_ids_columns;
+    return columns;
+}
+
+// Same as above, with the feature_ids table containing the cluster_id,
+// file_id and feature_id columns.
+py::dict feature_clusters_to_columns(
+    const std::vector<MetaMatch::FeatureCluster> &clusters, size_t num_files) {
+    using MetaMatch::FeatureCluster;
+    py::dict columns;
+    add_column(columns, "id", clusters, &FeatureCluster::id);
+    add_column(columns, "mz", clusters, &FeatureCluster::mz);
+    add_column(columns, "rt", clusters, &FeatureCluster::rt);
+    add_column(columns, "charge_state", clusters,
+               &FeatureCluster::charge_state);
+    add_column(columns, "avg_total_height", clusters,
+               &FeatureCluster::avg_total_height);
+    add_column(columns, "avg_monoisotopic_height", clusters,
+               &FeatureCluster::avg_monoisotopic_height);
+    add_column(columns, "avg_max_height", clusters,
+               &FeatureCluster::avg_max_height);
+    add_column(columns, "avg_total_volume", clusters,
+               &FeatureCluster::avg_total_volume);
+    add_column(columns, "avg_monoisotopic_volume", clusters,
+               &FeatureCluster::avg_monoisotopic_volume);
+    add_column(columns, "avg_max_volume", clusters,
+               &FeatureCluster::avg_max_volume);
+    add_file_columns(columns, "total_heights", clusters,
+                     &FeatureCluster::total_heights, num_files);
+    add_file_columns(columns, "monoisotopic_heights", clusters,
+                     &FeatureCluster::monoisotopic_heights, num_files);
+    add_file_columns(columns, "max_heights", clusters,
+                     &FeatureCluster::max_heights, num_files);
+    add_file_columns(columns, "total_volumes", clusters,
+                     &FeatureCluster::total_volumes, num_files);
+    add_file_columns(columns, "monoisotopic_volumes", clusters,
+                     &FeatureCluster::monoisotopic_volumes, num_files);
+    add_file_columns(columns, "max_volumes", clusters,
+                     &FeatureCluster::max_volumes, num_files);
+    std::vector<uint64_t> cluster_ids;
+    std::vector<MetaMatch::FeatureId> feature_ids;
+    for (const auto &cluster : clusters) {
+        for (const auto &feature_id : cluster.feature_ids) {
+            cluster_ids.push_back(cluster.id);
+            feature_ids.push_back(feature_id);
+        }
+    }
+    py::dict feature_ids_columns;
+    feature_ids_columns["cluster_id"] =
+        py::array_t<uint64_t>(cluster_ids.size(), cluster_ids.data());
+    add_column(feature_ids_columns, "file_id", feature_ids,
+               &MetaMatch::FeatureId::file_id);
+    add_column(feature_ids_columns, "feature_id", feature_ids,
+               &MetaMatch::FeatureId::feature_id);
+    columns["feature_ids"] = feature_ids_columns;
+    return columns;
+}
+
+py::dict linked_msms_to_columns(const std::vector<Link::LinkedMsms> &links) {
+    py::dict columns;
+    add_column(columns, "entity_id", links, &Link::LinkedMsms::entity_id);
+    add_column(columns, "msms_id", links, &Link::LinkedMsms::msms_id);
+    add_column(columns, "scan_index", links, &Link::LinkedMsms::scan_index);
+    add_column(columns, "distance", links, &Link::LinkedMsms::distance);
+    return columns;
+}
+
+py::dict linked_psm_to_columns(const std::vector<Link::LinkedPsm> &links) {
+    py::dict columns;
+    add_column(columns, "peak_id", links, &Link::LinkedPsm::peak_id);
+    add_column(columns, "psm_index", links, &Link::LinkedPsm::psm_index);
+    add_column(columns, "distance", links, &Link::LinkedPsm::distance);
+    return columns;
+}
+
+// View of an identification element for Python. The id attributes of the
+// elements are indices into IdentData::ids, which are resolved into strings
+// through the IdentData the element belongs to. The view keeps the Python
+// object of the IdentData alive.
+template <typename T>
+struct IdentElement {
+    py::object owner;
+    const IdentData::IdentData *ident_data;
+    const T *element;
+};
+
+template <typename T>
+std::vector<IdentElement<T>> ident_elements(
+    py::object owner, const std::vector<T> IdentData::IdentData::*member) {
+    const auto *ident_data = owner.cast<const IdentData::IdentData *>();
+    const auto &elements = ident_data->*member;
+    std::vector<IdentElement<T>> views;
+    views.reserve(elements.size());
+    for (const auto &element : elements) {
+        views.push_back({owner, ident_data, &element});
+    }
+    return views;
+}
+
+// Getters of an element field and of the string of an id field.
+template <typename T, typename Member>
+auto ident_member(Member T::*member) {
+    return [member](const IdentElement<T> &view) -> const Member & {
+        return view.element->*member;
+    };
+}
+template <typename T>
+auto ident_id(uint64_t T::*member) {
+    return [member](const IdentElement<T> &view) -> const std::string & {
+        return view.ident_data->ids[view.element->*member];
+    };
+}
+
 }  // namespace PythonAPI
 
 PYBIND11_MODULE(pastaq, m) {
     // Documentation.
     m.doc() = "pastaq documentation";
 
+    // NumPy record types.
+    PYBIND11_NUMPY_DTYPE(PythonAPI::RawPoint, rt, mz, intensity);
+    PYBIND11_NUMPY_DTYPE(
+        Centroid::Peak, id, local_max_mz, local_max_rt, local_max_height,
+        rt_delta, roi_min_mz, roi_max_mz, roi_min_rt, roi_max_rt,
+        raw_roi_mean_mz, raw_roi_mean_rt, raw_roi_sigma_mz, raw_roi_sigma_rt,
+        raw_roi_skewness_mz, raw_roi_skewness_rt, raw_roi_kurtosis_mz,
+        raw_roi_kurtosis_rt, raw_roi_max_height, raw_roi_total_intensity,
+        raw_roi_num_points, raw_roi_num_scans, fitted_height, fitted_mz,
+        fitted_rt, fitted_sigma_mz, fitted_sigma_rt, fitted_volume);
+
     // Structs.
     py::class_<RawData::PrecursorInformation>(m, "PrecursorInformation")
         .def_readonly("id", &RawData::PrecursorInformation::scan_number)
@@ -986,8 +1536,11 @@ PYBIND11_MODULE(pastaq, m) {
         .def_readonly("ms_level", &RawData::Scan::ms_level)
         .def_readonly("num_points", &RawData::Scan::num_points)
         .def_readonly("retention_time", &RawData::Scan::retention_time)
-        .def_readonly("mz", &RawData::Scan::mz)
-        .def_readonly("intensity", &RawData::Scan::intensity)
+        .def_property_readonly(
+            "mz", PythonAPI::numpy_member<RawData::Scan>(&RawData::Scan::mz))
+        .def_property_readonly(
+            "intensity",
+            PythonAPI::numpy_member<RawData::Scan>(&RawData::Scan::intensity))
         .def_readonly("polarity", &RawData::Scan::polarity)
         .def_readonly("precursor_information",
                       &RawData::Scan::precursor_information)
@@ -1034,8 +1587,15 @@ PYBIND11_MODULE(pastaq, m) {
         .def_readonly("min_rt", &RawData::RawData::min_rt)
         .def_readonly("max_rt", &RawData::RawData::max_rt)
         .def("theoretical_fwhm", &RawData::theoretical_fwhm, py::arg("mz"))
-        .def("dump", &PythonAPI::write_raw_data)
-        .def("raw_points", &RawData::raw_points,
+        .def("dump", &PythonAPI::write_raw_data,
+             "Write the raw_data to disk in the columnar format, which allows "
+             "read_raw_data to load only a retention time range. If "
+             "legacy_format is true, the compressed format of previous "
+             "versions is written instead",
+             py::arg("file_name"), py::arg("legacy_format") = false)
+        .def("raw_points",
+             py::overload_cast<const RawData::RawData &, double, double,
+                               double, double>(&RawData::raw_points),
              "Get the raw data points on the square region defined by "
              "min/max_mz/rt",
              py::arg("min_mz"), py::arg("max_mz"), py::arg("min_rt"),
@@ -1056,11 +1616,17 @@ PYBIND11_MODULE(pastaq, m) {
     py::class_<Grid::Grid>(m, "Grid")
         .def_readonly("n", &Grid::Grid::n)
         .def_readonly("m", &Grid::Grid::m)
-        .def_readonly("data", &Grid::Grid::data)
-        .def_readonly("bins_mz", &Grid::Grid::bins_mz)
-        .def_readonly("bins_rt", &Grid::Grid::bins_rt)
+        .def_property_readonly(
+            "data",
+            PythonAPI::numpy_member<Grid::Grid>(&Grid::Grid::data))
+        .def_property_readonly(
+            "bins_mz",
+            PythonAPI::numpy_member<Grid::Grid>(&Grid::Grid::bins_mz))
+        .def_property_readonly(
+            "bins_rt",
+            PythonAPI::numpy_member<Grid::Grid>(&Grid::Grid::bins_rt))
         .def("dump", &PythonAPI::write_grid)
-        .def("subset", &Grid::subset)
+        .def("subset", &Grid::subset<double>)
         .def("__repr__", [](const Grid::Grid &s) {
             return "Grid <n: " + std::to_string(s.n) +
                    ", m: " + std::to_string(s.m) +
@@ -1072,14 +1638,77 @@ PYBIND11_MODULE(pastaq, m) {
                    ", max_rt: " + std::to_string(s.max_rt) + ">";
         });
 
+    py::class_<Grid::FloatGrid>(m, "FloatGrid")
+        .def_readonly("n", &Grid::FloatGrid::n)
+        .def_readonly("m", &Grid::FloatGrid::m)
+        .def_property_readonly(
+            "data",
+            PythonAPI::numpy_member<Grid::FloatGrid>(&Grid::FloatGrid::data))
+        .def_property_readonly(
+            "bins_mz",
+            PythonAPI::numpy_member<Grid::FloatGrid>(&Grid::FloatGrid::bins_mz))
+        .def_property_readonly(
+            "bins_rt",
+            PythonAPI::numpy_member<Grid::FloatGrid>(&Grid::FloatGrid::bins_rt))
+        .def("subset", &Grid::subset<float>)
+        .def("__repr__", [](const Grid::FloatGrid &s) {
+            return "FloatGrid <n: " + std::to_string(s.n) +
+                   ", m: " + std::to_string(s.m) +
+                   ", k: " + std::to_string(s.k) +
+                   ", t: " + std::to_string(s.t) +
+                   ", min_mz: " + std::to_string(s.min_mz) +
+                   ", max_mz: " + std::to_string(s.max_mz) +
+                   ", min_rt: " + std::to_string(s.min_rt) +
+                   ", max_rt: " + std::to_string(s.max_rt) + ">";
+        });
+
+    py::class_<Grid::TiledGrid>(m, "TiledGrid")
+        .def_readonly("n", &Grid::TiledGrid::n)
+        .def_readonly("m", &Grid::TiledGrid::m)
+        .def_readonly("num_tiles_mz", &Grid::TiledGrid::num_tiles_mz)
+        .def_readonly("num_tiles_rt", &Grid::TiledGrid::num_tiles_rt)
+        .def_property_readonly(
+            "bins_mz",
+            PythonAPI::numpy_member<Grid::TiledGrid>(&Grid::TiledGrid::bins_mz))
+        .def_property_readonly(
+            "bins_rt",
+            PythonAPI::numpy_member<Grid::TiledGrid>(&Grid::TiledGrid::bins_rt))
+        .def("to_dense", &Grid::to_dense<double>)
+        .def("__repr__", [](const Grid::TiledGrid &s) {
+            return "TiledGrid <n: " + std::to_string(s.n) +
+                   ", m: " + std::to_string(s.m) +
+                   ", k: " + std::to_string(s.k) +
+                   ", t: " + std::to_string(s.t) +
+                   ", allocated tiles: " +
+                   std::to_string(s.data.size() /
+                                  (Grid::TILE_SIZE * Grid::TILE_SIZE)) +
+                   ", min_mz: " + std::to_string(s.min_mz) +
+                   ", max_mz: " + std::to_string(s.max_mz) +
+                   ", min_rt: " + std::to_string(s.min_rt) +
+                   ", max_rt: " + std::to_string(s.max_rt) + ">";
+        });
+
     py::class_<RawData::RawPoints>(m, "RawPoints")
-        .def_readonly("rt", &RawData::RawPoints::rt)
-        .def_readonly("mz", &RawData::RawPoints::mz)
-        .def_readonly("intensity", &RawData::RawPoints::intensity);
+        .def_property_readonly("rt",
+                               PythonAPI::numpy_member<RawData::RawPoints>(
+                                   &RawData::RawPoints::rt))
+        .def_property_readonly("mz",
+                               PythonAPI::numpy_member<RawData::RawPoints>(
+                                   &RawData::RawPoints::mz))
+        .def_property_readonly("intensity",
+                               PythonAPI::numpy_member<RawData::RawPoints>(
+                                   &RawData::RawPoints::intensity))
+        .def("numpy", &PythonAPI::raw_points_to_numpy,
+             "Copy the points into a NumPy structured array with the rt, mz "
+             "and intensity fields");
 
     py::class_<Xic::Xic>(m, "Xic")
-        .def_readonly("retention_time", &Xic::Xic::retention_time)
-        .def_readonly("intensity", &Xic::Xic::intensity)
+        .def_property_readonly(
+            "retention_time",
+            PythonAPI::numpy_member<Xic::Xic>(&Xic::Xic::retention_time))
+        .def_property_readonly(
+            "intensity",
+            PythonAPI::numpy_member<Xic::Xic>(&Xic::Xic::intensity))
         .def("__repr__", [](const Xic::Xic &s) {
             return "Xic <method: " + PythonAPI::to_string(s.method) +
                    ", min_mz: " + std::to_string(s.min_mz) +
@@ -1088,6 +1717,38 @@ PYBIND11_MODULE(pastaq, m) {
                    ", max_rt: " + std::to_string(s.max_rt) + ">";
         });
 
+    py::class_<Xic::Batch>(m, "XicBatch")
+        .def_property_readonly(
+            "offsets",
+            PythonAPI::numpy_member<Xic::Batch>(&Xic::Batch::offsets))
+        .def_property_readonly(
+            "retention_time",
+            PythonAPI::numpy_member<Xic::Batch>(&Xic::Batch::retention_time))
+        .def_property_readonly(
+            "intensity",
+            PythonAPI::numpy_member<Xic::Batch>(&Xic::Batch::intensity))
+        .def("__len__",
+             [](const Xic::Batch &s) { return s.offsets.size() - 1; })
+        .def("__repr__", [](const Xic::Batch &s) {
+            return "XicBatch <method: " + PythonAPI::to_string(s.method) +
+                   ", number of xic: " + std::to_string(s.offsets.size() - 1) +
+                   ", number of points: " +
+                   std::to_string(s.retention_time.size()) + ">";
+        });
+
+    py::class_<ThreadPool::Stats>(m, "ThreadPoolStats")
+        .def_readonly("num_workers", &ThreadPool::Stats::num_workers)
+        .def_readonly("jobs", &ThreadPool::Stats::jobs)
+        .def_readonly("tasks", &ThreadPool::Stats::tasks)
+        .def_readonly("steals", &ThreadPool::Stats::steals)
+        .def("__repr__", [](const ThreadPool::Stats &s) {
+            return "ThreadPoolStats <num_workers: " +
+                   std::to_string(s.num_workers) +
+                   ", jobs: " + std::to_string(s.jobs) +
+                   ", tasks: " + std::to_string(s.tasks) +
+                   ", steals: " + std::to_string(s.steals) + ">";
+        });
+
     py::class_<Centroid::Peak>(m, "Peak")
         .def_readonly("id", &Centroid::Peak::id)
         .def_readonly("local_max_mz", &Centroid::Peak::local_max_mz)
@@ -1180,23 +1841,44 @@ PYBIND11_MODULE(pastaq, m) {
                    ", mean_ratio: " + std::to_string(s.mean_ratio);
         });
 
-    py::class_<IdentData::SpectrumMatch>(m, "SpectrumMatch")
-        .def_readonly("id", &IdentData::SpectrumMatch::id)
-        .def_readonly("pass_threshold",
-                      &IdentData::SpectrumMatch::pass_threshold)
-        .def_readonly("match_id", &IdentData::SpectrumMatch::match_id)
-        .def_readonly("charge_state", &IdentData::SpectrumMatch::charge_state)
-        .def_readonly("theoretical_mz",
-                      &IdentData::SpectrumMatch::theoretical_mz)
-        .def_readonly("experimental_mz",
-                      &IdentData::SpectrumMatch::experimental_mz)
-        .def_readonly("retention_time",
-                      &IdentData::SpectrumMatch::retention_time)
-        .def_readonly("rank", &IdentData::SpectrumMatch::rank)
-        .def("__repr__", [](const IdentData::SpectrumMatch &s) {
-            return "SpectrumMatch <id: " + s.id +
+    // The id attributes of the identification elements are strings. The
+    // indices of the ids in IdentData.ids are available as *_index
+    // attributes.
+    using SpectrumMatchView = PythonAPI::IdentElement<IdentData::SpectrumMatch>;
+    using IdentData::SpectrumMatch;
+    py::class_<SpectrumMatchView>(m, "SpectrumMatch")
+        .def_property_readonly("id", PythonAPI::ident_id(&SpectrumMatch::id))
+        .def_property_readonly("id_index",
+                               PythonAPI::ident_member(&SpectrumMatch::id))
+        .def_property_readonly(
+            "pass_threshold",
+            PythonAPI::ident_member(&SpectrumMatch::pass_threshold))
+        .def_property_readonly("match_id",
+                               PythonAPI::ident_id(&SpectrumMatch::match_id))
+        .def_property_readonly(
+            "match_id_index", PythonAPI::ident_member(&SpectrumMatch::match_id))
+        .def_property_readonly(
+            "match_index", PythonAPI::ident_member(&SpectrumMatch::match_index))
+        .def_property_readonly(
+            "charge_state",
+            PythonAPI::ident_member(&SpectrumMatch::charge_state))
+        .def_property_readonly(
+            "theoretical_mz",
+            PythonAPI::ident_member(&SpectrumMatch::theoretical_mz))
+        .def_property_readonly(
+            "experimental_mz",
+            PythonAPI::ident_member(&SpectrumMatch::experimental_mz))
+        .def_property_readonly(
+            "retention_time",
+            PythonAPI::ident_member(&SpectrumMatch::retention_time))
+        .def_property_readonly("rank",
+                               PythonAPI::ident_member(&SpectrumMatch::rank))
+        .def("__repr__", [](const SpectrumMatchView &view) {
+            const auto &s = *view.element;
+            const auto &ids = view.ident_data->ids;
+            return "SpectrumMatch <id: " + ids[s.id] +
                    ", pass_threshold: " + std::to_string(s.pass_threshold) +
-                   ", match_id: " + s.match_id +
+                   ", match_id: " + ids[s.match_id] +
                    ", charge_state: " + std::to_string(s.charge_state) +
                    ", theoretical_mz: " + std::to_string(s.theoretical_mz) +
                    ", experimental_mz: " + std::to_string(s.experimental_mz) +
@@ -1204,13 +1886,22 @@ PYBIND11_MODULE(pastaq, m) {
                    ", rank: " + std::to_string(s.rank) + ">";
         });
 
-    py::class_<IdentData::DBSequence>(m, "DBSequence")
-        .def_readonly("id", &IdentData::DBSequence::id)
-        .def_readonly("accession", &IdentData::DBSequence::accession)
-        .def_readonly("description", &IdentData::DBSequence::description)
-        .def_readonly("db_reference", &IdentData::DBSequence::db_reference)
-        .def("__repr__", [](const IdentData::DBSequence &s) {
-            return "DBSequence <id: " + s.id + ", accession: " + s.accession +
+    using DBSequenceView = PythonAPI::IdentElement<IdentData::DBSequence>;
+    using IdentData::DBSequence;
+    py::class_<DBSequenceView>(m, "DBSequence")
+        .def_property_readonly("id", PythonAPI::ident_id(&DBSequence::id))
+        .def_property_readonly("id_index",
+                               PythonAPI::ident_member(&DBSequence::id))
+        .def_property_readonly("accession",
+                               PythonAPI::ident_member(&DBSequence::accession))
+        .def_property_readonly(
+            "description", PythonAPI::ident_member(&DBSequence::description))
+        .def_property_readonly(
+            "db_reference", PythonAPI::ident_member(&DBSequence::db_reference))
+        .def("__repr__", [](const DBSequenceView &view) {
+            const auto &s = *view.element;
+            return "DBSequence <id: " + view.ident_data->ids[s.id] +
+                   ", accession: " + s.accession +
                    ", description: " + s.description + ">";
         });
 
@@ -1231,36 +1922,83 @@ PYBIND11_MODULE(pastaq, m) {
                    ", location: " + std::to_string(s.location) + ">";
         });
 
-    py::class_<IdentData::Peptide>(m, "Peptide")
-        .def_readonly("id", &IdentData::Peptide::id)
-        .def_readonly("sequence", &IdentData::Peptide::sequence)
-        .def_readonly("modifications", &IdentData::Peptide::modifications)
-        .def("__repr__", [](const IdentData::Peptide &s) {
-            return "Peptide <id: " + s.id + ", sequence: " + s.sequence +
+    using PeptideView = PythonAPI::IdentElement<IdentData::Peptide>;
+    using IdentData::Peptide;
+    py::class_<PeptideView>(m, "Peptide")
+        .def_property_readonly("id", PythonAPI::ident_id(&Peptide::id))
+        .def_property_readonly("id_index",
+                               PythonAPI::ident_member(&Peptide::id))
+        .def_property_readonly("sequence",
+                               PythonAPI::ident_member(&Peptide::sequence))
+        .def_property_readonly("modifications",
+                               PythonAPI::ident_member(&Peptide::modifications))
+        .def("__repr__", [](const PeptideView &view) {
+            const auto &s = *view.element;
+            return "Peptide <id: " + view.ident_data->ids[s.id] +
+                   ", sequence: " + s.sequence +
                    ", num_modifications: " +
                    std::to_string(s.modifications.size()) + ">";
         });
 
-    py::class_<IdentData::PeptideEvidence>(m, "PeptideEvidence")
-        .def_readonly("id", &IdentData::PeptideEvidence::id)
-        .def_readonly("db_sequence_id",
-                      &IdentData::PeptideEvidence::db_sequence_id)
-        .def_readonly("peptide_id", &IdentData::PeptideEvidence::peptide_id)
-        .def_readonly("decoy", &IdentData::PeptideEvidence::decoy)
-        .def("__repr__", [](const IdentData::PeptideEvidence &s) {
-            return "PeptideEvidence <id: " + s.id +
-                   ", db_sequence_id: " + s.db_sequence_id +
-                   ", peptide_id: " + s.peptide_id +
+    using PeptideEvidenceView =
+        PythonAPI::IdentElement<IdentData::PeptideEvidence>;
+    using IdentData::PeptideEvidence;
+    py::class_<PeptideEvidenceView>(m, "PeptideEvidence")
+        .def_property_readonly("id", PythonAPI::ident_id(&PeptideEvidence::id))
+        .def_property_readonly("id_index",
+                               PythonAPI::ident_member(&PeptideEvidence::id))
+        .def_property_readonly(
+            "db_sequence_id",
+            PythonAPI::ident_id(&PeptideEvidence::db_sequence_id))
+        .def_property_readonly(
+            "db_sequence_id_index",
+            PythonAPI::ident_member(&PeptideEvidence::db_sequence_id))
+        .def_property_readonly(
+            "peptide_id", PythonAPI::ident_id(&PeptideEvidence::peptide_id))
+        .def_property_readonly(
+            "peptide_id_index",
+            PythonAPI::ident_member(&PeptideEvidence::peptide_id))
+        .def_property_readonly(
+            "db_sequence_index",
+            PythonAPI::ident_member(&PeptideEvidence::db_sequence_index))
+        .def_property_readonly(
+            "peptide_index",
+            PythonAPI::ident_member(&PeptideEvidence::peptide_index))
+        .def_property_readonly("decoy",
+                               PythonAPI::ident_member(&PeptideEvidence::decoy))
+        .def("__repr__", [](const PeptideEvidenceView &view) {
+            const auto &s = *view.element;
+            const auto &ids = view.ident_data->ids;
+            return "PeptideEvidence <id: " + ids[s.id] +
+                   ", db_sequence_id: " + ids[s.db_sequence_id] +
+                   ", peptide_id: " + ids[s.peptide_id] +
                    ", decoy: " + std::to_string(s.decoy) + ">";
         });
 
     py::class_<IdentData::IdentData>(m, "IdentData")
-        .def_readonly("db_sequences", &IdentData::IdentData::db_sequences)
-        .def_readonly("peptides", &IdentData::IdentData::peptides)
-        .def_readonly("spectrum_matches",
-                      &IdentData::IdentData::spectrum_matches)
-        .def_readonly("peptide_evidence",
-                      &IdentData::IdentData::peptide_evidence);
+        .def_readonly("ids", &IdentData::IdentData::ids)
+        .def_property_readonly("db_sequences",
+                               [](py::object self) {
+                                   return PythonAPI::ident_elements(
+                                       self,
+                                       &IdentData::IdentData::db_sequences);
+                               })
+        .def_property_readonly("peptides",
+                               [](py::object self) {
+                                   return PythonAPI::ident_elements(
+                                       self, &IdentData::IdentData::peptides);
+                               })
+        .def_property_readonly(
+            "spectrum_matches",
+            [](py::object self) {
+                return PythonAPI::ident_elements(
+                    self, &IdentData::IdentData::spectrum_matches);
+            })
+        .def_property_readonly(
+            "peptide_evidence", [](py::object self) {
+                return PythonAPI::ident_elements(
+                    self, &IdentData::IdentData::peptide_evidence);
+            });
 
     py::class_<FeatureDetection::Feature>(m, "Feature")
         .def_readonly("id", &FeatureDetection::Feature::id)
@@ -1422,20 +2160,108 @@ PYBIND11_MODULE(pastaq, m) {
              py::arg("instrument_type") = "", py::arg("resolution_ms1"),
              py::arg("resolution_msn"), py::arg("reference_mz"),
              py::arg("fwhm_rt"), py::arg("polarity") = "",
-             py::arg("ms_level") = 1)
+             py::arg("ms_level") = 1,
+             py::arg("max_threads") = std::thread::hardware_concurrency())
+        .def("read_raw_levels", &PythonAPI::read_raw_levels,
+             "Read the raw data of several MS levels from the given mzXML or "
+             "mzML file in a single pass",
+             py::arg("file_name"), py::arg("min_mz") = -1.0,
+             py::arg("max_mz") = -1.0, py::arg("min_rt") = -1.0,
+             py::arg("max_rt") = -1.0, py::arg("instrument_type") = "",
+             py::arg("resolution_ms1"), py::arg("resolution_msn"),
+             py::arg("reference_mz"), py::arg("fwhm_rt"),
+             py::arg("polarity") = "",
+             py::arg("ms_levels") = std::vector<size_t>{1, 2},
+             py::arg("max_threads") = std::thread::hardware_concurrency())
         .def("theoretical_fwhm", &RawData::theoretical_fwhm,
              "Calculate the theoretical width of the peak at the given m/z for "
              "the given raw file",
              py::arg("raw_data"), py::arg("mz"))
-        .def("resample", &PythonAPI::resample,
+        .def("resample", &PythonAPI::resample<double>,
              "Resample the raw data into a smoothed warped grid",
              py::arg("raw_data"), py::arg("num_mz") = 10,
              py::arg("num_rt") = 10, py::arg("smoothing_coef_mz") = 0.5,
-             py::arg("smoothing_coef_rt") = 0.5)
-        .def("find_peaks", &Centroid::find_peaks_parallel,
+             py::arg("smoothing_coef_rt") = 0.5,
+             py::arg("max_threads") = std::thread::hardware_concurrency())
+        .def("resample_float", &PythonAPI::resample<float>,
+             "Resample the raw data into a smoothed warped grid stored in "
+             "single precision",
+             py::arg("raw_data"), py::arg("num_mz") = 10,
+             py::arg("num_rt") = 10, py::arg("smoothing_coef_mz") = 0.5,
+             py::arg("smoothing_coef_rt") = 0.5,
+             py::arg("max_threads") = std::thread::hardware_concurrency())
+        .def("resample_tiled", &PythonAPI::resample_tiled,
+             "Resample the raw data into a smoothed warped grid, where only "
+             "the regions containing signal are stored",
+             py::arg("raw_data"), py::arg("num_mz") = 10,
+             py::arg("num_rt") = 10, py::arg("smoothing_coef_mz") = 0.5,
+             py::arg("smoothing_coef_rt") = 0.5,
+             py::arg("max_threads") = std::thread::hardware_concurrency())
+        .def("find_peaks", &Centroid::find_peaks_parallel<Grid::Grid>,
              "Find all peaks in the given grid", py::arg("raw_data"),
              py::arg("grid"), py::arg("max_peaks") = 0,
-             py::arg("max_threads") = std::thread::hardware_concurrency())
+             py::arg("max_threads") = std::thread::hardware_concurrency(),
+             py::arg("refine_fit") = false)
+        .def("find_peaks", &Centroid::find_peaks_parallel<Grid::FloatGrid>,
+             "Find all peaks in the given grid", py::arg("raw_data"),
+             py::arg("grid"), py::arg("max_peaks") = 0,
+             py::arg("max_threads") = std::thread::hardware_concurrency(),
+             py::arg("refine_fit") = false)
+        .def("find_peaks", &Centroid::find_peaks_parallel<Grid::TiledGrid>,
+             "Find all peaks in the given grid", py::arg("raw_data"),
+             py::arg("grid"), py::arg("max_peaks") = 0,
+             py::arg("max_threads") = std::thread::hardware_concurrency(),
+             py::arg("refine_fit") = false)
+        .def("find_peaks_top_k", &Centroid::find_peaks_top_k<Grid::Grid>,
+             "Find the max_peaks highest peaks in the given grid, building "
+             "only as many peaks as needed",
+             py::arg("raw_data"), py::arg("grid"), py::arg("max_peaks") = 0,
+             py::arg("max_threads") = std::thread::hardware_concurrency(),
+             py::arg("refine_fit") = false)
+        .def("find_peaks_top_k", &Centroid::find_peaks_top_k<Grid::FloatGrid>,
+             "Find the max_peaks highest peaks in the given grid, building "
+             "only as many peaks as needed",
+             py::arg("raw_data"), py::arg("grid"), py::arg("max_peaks") = 0,
+             py::arg("max_threads") = std::thread::hardware_concurrency(),
+             py::arg("refine_fit") = false)
+        .def("find_peaks_top_k", &Centroid::find_peaks_top_k<Grid::TiledGrid>,
+             "Find the max_peaks highest peaks in the given grid, building "
+             "only as many peaks as needed",
+             py::arg("raw_data"), py::arg("grid"), py::arg("max_peaks") = 0,
+             py::arg("max_threads") = std::thread::hardware_concurrency(),
+             py::arg("refine_fit") = false)
+        .def("find_peaks_streaming", &PythonAPI::find_peaks_streaming,
+             "Resample the raw data and find its peaks without storing the "
+             "full grid in memory",
+             py::arg("raw_data"), py::arg("num_mz") = 10,
+             py::arg("num_rt") = 10, py::arg("smoothing_coef_mz") = 0.5,
+             py::arg("smoothing_coef_rt") = 0.5, py::arg("max_peaks") = 0,
+             py::arg("refine_fit") = false)
+        .def("peaks_to_numpy", &PythonAPI::peaks_to_numpy,
+             "Copy the list of peaks into a NumPy structured array with one "
+             "field per peak attribute",
+             py::arg("peaks"))
+        .def("peaks_to_columns", &PythonAPI::peaks_to_columns,
+             "Export the list of peaks as a dict of NumPy columns",
+             py::arg("peaks"))
+        .def("features_to_columns", &PythonAPI::features_to_columns,
+             "Export the list of features as a dict of NumPy columns",
+             py::arg("features"))
+        .def("peak_clusters_to_columns", &PythonAPI::peak_clusters_to_columns,
+             "Export the list of peak clusters as a dict of NumPy columns, "
+             "with one column per file in the quantification matrices",
+             py::arg("peak_clusters"), py::arg("num_files"))
+        .def("feature_clusters_to_columns",
+             &PythonAPI::feature_clusters_to_columns,
+             "Export the list of feature clusters as a dict of NumPy columns, "
+             "with one column per file in the quantification matrices",
+             py::arg("feature_clusters"), py::arg("num_files"))
+        .def("linked_msms_to_columns", &PythonAPI::linked_msms_to_columns,
+             "Export the list of linked msms as a dict of NumPy columns",
+             py::arg("linked_msms"))
+        .def("linked_psm_to_columns", &PythonAPI::linked_psm_to_columns,
+             "Export the list of linked psm as a dict of NumPy columns",
+             py::arg("linked_psm"))
         .def("calculate_time_map", &PythonAPI::calculate_time_map,
              "Calculate a warping time_map to maximize the similarity of "
              "ref_peaks and source_peaks",
@@ -1460,8 +2286,12 @@ PYBIND11_MODULE(pastaq, m) {
         .def("read_peaks", &PythonAPI::read_peaks,
              "Read the peaks from the binary peaks file", py::arg("file_name"))
         .def("read_raw_data", &PythonAPI::read_raw_data,
-             "Read the raw_data from the binary raw_data file",
-             py::arg("file_name"))
+             "Read the raw_data from the binary raw_data file. If min_rt or "
+             "max_rt are given, only the scans in the retention time range "
+             "are returned. Files in the legacy format have to be read "
+             "entirely before discarding the rest of the scans",
+             py::arg("file_name"), py::arg("min_rt") = -1.0,
+             py::arg("max_rt") = -1.0)
         .def("read_grid", &PythonAPI::read_grid,
              "Read the grid from the binary grid file", py::arg("file_name"))
         .def("read_linked_psm", &PythonAPI::read_linked_psm,
@@ -1538,6 +2368,21 @@ PYBIND11_MODULE(pastaq, m) {
         .def("xic", &PythonAPI::xic, py::arg("raw_data"), py::arg("min_mz"),
              py::arg("max_mz"), py::arg("min_rt"), py::arg("max_rt"),
              py::arg("method") = "sum")
+        .def("xic_batch", &PythonAPI::xic_batch,
+             "Extract the ion chromatograms for multiple windows, where the "
+             "values for window i are in [offsets[i], offsets[i + 1])",
+             py::arg("raw_data"), py::arg("min_mz"), py::arg("max_mz"),
+             py::arg("min_rt"), py::arg("max_rt"), py::arg("method") = "sum",
+             py::arg("max_threads") = std::thread::hardware_concurrency())
+        .def(
+            "thread_pool_stats",
+            []() { return ThreadPool::shared_pool().stats(); },
+            "Get the counters of the thread pool shared by the parallel "
+            "functions")
+        .def(
+            "reset_thread_pool_stats",
+            []() { ThreadPool::shared_pool().reset_stats(); },
+            "Reset the counters of the shared thread pool")
         .def("perform_protein_inference", &ProteinInference::razor,
              py::arg("ident_data"))
         .def("detect_features", &FeatureDetection::detect_features,
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "doctest.h"
+
+#include "utils/base64.hpp"
+
+// Reference encoder used to generate the test inputs.
+std::string encode_base64(const std::vector<uint8_t> &data) {
+    const char *alphabet =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string encoded;
+    for (size_t i = 0; i < data.size(); i += 3) {
+        uint32_t n = data[i] << 16;
+        if (i + 1 < data.size()) {
+            n |= data[i + 1] << 8;
+        }
+        if (i + 2 < data.size()) {
+            n |= data[i + 2];
+        }
+        encoded += alphabet[(n >> 18) & 63];
+        encoded += alphabet[(n >> 12) & 63];
+        encoded += i + 1 < data.size() ? alphabet[(n >> 6) & 63] : '=';
+        encoded += i + 2 < data.size() ? alphabet[n & 63] : '=';
+    }
+    return encoded;
+}
+
+TEST_CASE("Decoding base64 strings") {
+    SUBCASE("Known values") {
+        std::vector<uint8_t> output;
+        Base64::decode_base64("SGVsbG8gV29ybGQh", output);
+        CHECK(std::string(output.begin(), output.end()) == "Hello World!");
+        Base64::decode_base64("SGVsbG8gV29ybGQ=", output);
+        CHECK(std::string(output.begin(), output.end()) == "Hello World");
+        Base64::decode_base64("SGVsbG8gV29ybA==", output);
+        CHECK(std::string(output.begin(), output.end()) == "Hello Worl");
+        Base64::decode_base64("", output);
+        CHECK(output.empty());
+    }
+    SUBCASE("Random data of different lengths") {
+        // The lengths cover the vectorized blocks as well as the scalar tail.
+        std::mt19937 generator(42);
+        std::uniform_int_distribution<int> distribution(0, 255);
+        bool all_equal = true;
+        for (size_t length = 0; length < 300; ++length) {
+            std::vector<uint8_t> data(length);
+            for (auto &value : data) {
+                value = distribution(generator);
+            }
+            auto encoded = encode_base64(data);
+            CHECK(Base64::decoded_length(encoded) == length);
+
+            std::vector<uint8_t> output;
+            Base64::decode_base64(encoded, output);
+            all_equal = all_equal && output == data;
+
+            // Decoding into a caller provided buffer.
+            std::vector<uint8_t> buffer(length + 1, 0xAB);
+            size_t written = Base64::decode_base64(encoded, buffer.data());
+            all_equal = all_equal && written == length &&
+                        buffer[length] == 0xAB &&
+                        std::equal(data.begin(), data.end(), buffer.begin());
+        }
+        CHECK(all_equal);
+    }
+}
+
+TEST_CASE("Decoding base64 strings with each instruction set") {
+    auto supported = Base64::simd_level();
+    std::vector<Base64::SimdLevel> levels = {Base64::SimdLevel::SCALAR};
+    if (Base64::set_simd_level(Base64::SimdLevel::SSE41) ==
+        Base64::SimdLevel::SSE41) {
+        levels.push_back(Base64::SimdLevel::SSE41);
+    }
+    if (Base64::set_simd_level(Base64::SimdLevel::AVX2) ==
+        Base64::SimdLevel::AVX2) {
+        levels.push_back(Base64::SimdLevel::AVX2);
+    }
+    auto decode = [](Base64::SimdLevel level, const std::string &input) {
+        Base64::set_simd_level(level);
+        std::vector<uint8_t> output;
+        Base64::decode_base64(input, output);
+        return output;
+    };
+
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    std::vector<uint8_t> data(150);
+    for (auto &value : data) {
+        value = distribution(generator);
+    }
+    auto encoded = encode_base64(data);
+
+    SUBCASE("Valid input") {
+        for (auto level : levels) {
+            for (size_t length = 0; length < data.size(); ++length) {
+                std::vector<uint8_t> expected(data.begin(),
+                                              data.begin() + length);
+                auto input = encode_base64(expected);
+                CHECK(decode(level, input) == expected);
+            }
+        }
+    }
+    SUBCASE("Invalid characters inside a vector block") {
+        // The vectorized paths stop at the first invalid block and the scalar
+        // code decodes the rest, so the result must match the scalar path for
+        // any position of the invalid character.
+        for (char c : {'=', ' ', '\n', '\t', '*', '-', '\x80', '\xFF'}) {
+            bool all_equal = true;
+            for (size_t position = 0; position < encoded.size() - 2;
+                 ++position) {
+                auto input = encoded;
+                input[position] = c;
+                auto expected = decode(Base64::SimdLevel::SCALAR, input);
+                for (auto level : levels) {
+                    all_equal = all_equal && decode(level, input) == expected;
+                }
+            }
+            CHECK(all_equal);
+        }
+    }
+    SUBCASE("Decoding resumes after the invalid block") {
+        // Only the bytes decoded from the quad with the padding differ.
+        auto input = encoded;
+        input[50] = '=';
+        for (auto level : levels) {
+            auto output = decode(level, input);
+            REQUIRE(output.size() == data.size());
+            CHECK(std::equal(data.begin(), data.begin() + 36, output.begin()));
+            CHECK(std::equal(data.begin() + 39, data.end(),
+                             output.begin() + 39));
+        }
+    }
+    Base64::set_simd_level(supported);
+}
+
+TEST_CASE("Interpreting arrays of values") {
+    std::vector<double> values = {1.0, -2.5, 1234.5678, 0.0, 1e-10, 42.0};
+    // Serialize the values in both byte orders with the given precision.
+    auto serialize = [&](int precision, bool little_endian) {
+        std::vector<uint8_t> data;
+        for (const auto &value : values) {
+            std::vector<uint8_t> bytes(precision / 8);
+            if (precision == 32) {
+                float x = value;
+                std::memcpy(bytes.data(), &x, sizeof(x));
+            } else {
+                std::memcpy(bytes.data(), &value, sizeof(value));
+            }
+            // The tests assume a little endian host.
+            if (!little_endian) {
+                std::reverse(bytes.begin(), bytes.end());
+            }
+            data.insert(data.end(), bytes.begin(), bytes.end());
+        }
+        return data;
+    };
+    for (int precision : {32, 64}) {
+        for (bool little_endian : {true, false}) {
+            auto data = serialize(precision, little_endian);
+            std::vector<double> output;
+            Base64::interpret_values(data.data(), data.size(), precision,
+                                     little_endian, output);
+            CHECK(output.size() == values.size());
+            for (size_t i = 0; i < output.size(); ++i) {
+                CHECK(output[i] == doctest::Approx(values[i]));
+            }
+
+            std::vector<double> first;
+            std::vector<double> second;
+            Base64::interpret_pairs(data.data(), data.size(), precision,
+                                    little_endian, first, second);
+            CHECK(first.size() == values.size() / 2);
+            CHECK(second.size() == values.size() / 2);
+            for (size_t i = 0; i < first.size(); ++i) {
+                CHECK(first[i] == doctest::Approx(values[2 * i]));
+                CHECK(second[i] == doctest::Approx(values[2 * i + 1]));
+            }
+        }
+    }
+    SUBCASE("Incomplete and unsupported data") {
+        std::vector<uint8_t> data(12, 0);
+        std::vector<double> output;
+        Base64::interpret_values(data.data(), data.size(), 64, true, output);
+        CHECK(output.size() == 1);
+        Base64::interpret_values(data.data(), data.size(), 16, true, output);
+        CHECK(output.empty());
+    }
+}
@@ -8,12 +8,226 @@ TEST_CASE("Peak overlapping") {
     CHECK(true);
 }
 
+// Create a grid with the given values in row major order. The mz and rt of
+// the bins are 100 + i and 10 * j respectively.
+static Grid::Grid make_grid(uint64_t n, uint64_t m, std::vector<double> data) {
+    Grid::Grid grid = {};
+    grid.n = n;
+    grid.m = m;
+    for (size_t i = 0; i < n; ++i) {
+        grid.bins_mz.push_back(100 + i);
+    }
+    for (size_t j = 0; j < m; ++j) {
+        grid.bins_rt.push_back(10 * j);
+    }
+    grid.data = data;
+    return grid;
+}
+
 TEST_CASE("Find local maxima") {
-    // TODO:...
-    CHECK(true);
+    auto grid = make_grid(7, 6,
+                          {
+                              0, 0, 0, 0, 0, 0, 0,  //
+                              0, 5, 0, 0, 0, 0, 0,  //
+                              0, 0, 6, 0, 2, 2, 0,  //
+                              0, 0, 0, 0, 0, 0, 0,  //
+                              0, 1, 0, 3, 3, 4, 0,  //
+                              0, 0, 0, 0, 0, 0, 0,  //
+                          });
+    auto check_points = [](const std::vector<Centroid::LocalMax> &points,
+                           const std::vector<Centroid::LocalMax> &expected) {
+        REQUIRE(points.size() == expected.size());
+        for (size_t i = 0; i < points.size(); ++i) {
+            CHECK(points[i].mz == expected[i].mz);
+            CHECK(points[i].rt == expected[i].rt);
+            CHECK(points[i].value == expected[i].value);
+        }
+    };
+    SUBCASE("Four neighbours") {
+        check_points(Centroid::find_local_maxima(grid),
+                     {{101, 10, 5}, {102, 20, 6}, {101, 40, 1}, {105, 40, 4}});
+    }
+    SUBCASE("Eight neighbours") {
+        check_points(
+            Centroid::find_local_maxima(grid, 1, Centroid::Neighbours::EIGHT),
+            {{102, 20, 6}, {101, 40, 1}, {105, 40, 4}});
+    }
+    SUBCASE("Plateaus") {
+        // The plateau at row 4 is next to a greater value.
+        check_points(Centroid::find_local_maxima(
+                         grid, 1, Centroid::Neighbours::FOUR, true),
+                     {{101, 10, 5},
+                      {102, 20, 6},
+                      {104.5, 20, 2},
+                      {101, 40, 1},
+                      {105, 40, 4}});
+    }
+    SUBCASE("Multiple threads") {
+        // Values with many ties between neighbours.
+        std::vector<double> data(50 * 40);
+        for (size_t i = 0; i < data.size(); ++i) {
+            data[i] = (i * 2654435761u >> 11) % 5;
+        }
+        auto random_grid = make_grid(50, 40, data);
+
+        // Default mode of the original serial implementation.
+        std::vector<Centroid::LocalMax> expected;
+        for (size_t j = 1; j < random_grid.m - 1; ++j) {
+            for (size_t i = 1; i < random_grid.n - 1; ++i) {
+                size_t index = i + j * random_grid.n;
+                double value = data[index];
+                if ((value != 0) && (value > data[index - 1]) &&
+                    (value > data[index + 1]) &&
+                    (value > data[index - random_grid.n]) &&
+                    (value > data[index + random_grid.n])) {
+                    expected.push_back({random_grid.bins_mz[i],
+                                        random_grid.bins_rt[j], value});
+                }
+            }
+        }
+        CHECK(expected.size() > 10);
+        check_points(Centroid::find_local_maxima(random_grid, 4), expected);
+        for (auto neighbours :
+             {Centroid::Neighbours::FOUR, Centroid::Neighbours::EIGHT}) {
+            for (bool plateaus : {false, true}) {
+                check_points(Centroid::find_local_maxima(random_grid, 4,
+                                                         neighbours, plateaus),
+                             Centroid::find_local_maxima(random_grid, 1,
+                                                         neighbours, plateaus));
+            }
+        }
+    }
 }
 
 TEST_CASE("Find peaks") {
-    // TODO:...
-    CHECK(true);
+    auto raw_data = TestUtils::mock_raw_data();
+    auto params = Grid::ResampleParams{};
+    params.num_samples_mz = 5;
+    params.num_samples_rt = 5;
+    params.smoothing_coef_mz = 0.5;
+    params.smoothing_coef_rt = 0.5;
+    auto grid = Grid::resample(raw_data, params, 1);
+    auto all_peaks = Centroid::find_peaks_serial(raw_data, grid, 0);
+    REQUIRE(all_peaks.size() == 2);
+
+    SUBCASE("A max_peaks of zero returns all the peaks") {
+        CHECK(Centroid::find_peaks_serial(raw_data, grid, 1).size() == 1);
+        CHECK(Centroid::find_peaks_parallel(raw_data, grid, 1, 4).size() == 1);
+        CHECK(Centroid::find_peaks_parallel(raw_data, grid, 0, 4).size() ==
+              all_peaks.size());
+        CHECK(Centroid::find_peaks_top_k(raw_data, grid, 0, 4).size() ==
+              all_peaks.size());
+        CHECK(Centroid::find_peaks_streaming(raw_data, params, 0).size() ==
+              all_peaks.size());
+    }
+
+    SUBCASE("Top-K peaks match the serial peaks") {
+        for (size_t max_peaks : {1, 2, 100}) {
+            auto peaks =
+                Centroid::find_peaks_serial(raw_data, grid, max_peaks);
+            for (size_t max_threads : {1, 4}) {
+                auto top_k_peaks = Centroid::find_peaks_top_k(
+                    raw_data, grid, max_peaks, max_threads);
+                REQUIRE(top_k_peaks.size() == peaks.size());
+                for (size_t i = 0; i < peaks.size(); ++i) {
+                    CHECK(top_k_peaks[i].id == peaks[i].id);
+                    CHECK(top_k_peaks[i].local_max_mz ==
+                          peaks[i].local_max_mz);
+                    CHECK(top_k_peaks[i].local_max_rt ==
+                          peaks[i].local_max_rt);
+                    CHECK(top_k_peaks[i].fitted_height ==
+                          peaks[i].fitted_height);
+                }
+            }
+        }
+    }
+}
+
+// A single Gaussian peak at mz 400.5 and rt 30 with a height of 1000. The
+// intensities are multiplied by a deterministic noise pattern of the given
+// amplitude.
+static RawData::RawData gaussian_raw_data(double noise) {
+    RawData::RawData raw_data = {};
+    raw_data.instrument_type = Instrument::ORBITRAP;
+    raw_data.min_mz = 400.0;
+    raw_data.max_mz = 401.0;
+    raw_data.min_rt = 0.0;
+    raw_data.max_rt = 60.0;
+    raw_data.resolution_ms1 = 70000;
+    raw_data.reference_mz = 200;
+    raw_data.fwhm_rt = 5;
+    size_t k = 0;
+    for (double rt = raw_data.min_rt; rt <= raw_data.max_rt; rt += 0.5) {
+        RawData::Scan scan = {};
+        scan.retention_time = rt;
+        for (double mz = raw_data.min_mz; mz < raw_data.max_mz; mz += 0.0005) {
+            double a = (mz - 400.5) / 0.003;
+            double b = (rt - 30.0) / 2.0;
+            double pattern = ((k++ * 2654435761u) >> 8) % 1000 / 1000.0 - 0.5;
+            scan.mz.push_back(mz);
+            scan.intensity.push_back(1000 * std::exp(-0.5 * (a * a + b * b)) *
+                                     (1 + noise * pattern));
+        }
+        scan.num_points = scan.mz.size();
+        raw_data.scans.push_back(scan);
+        raw_data.retention_times.push_back(rt);
+    }
+    return raw_data;
+}
+
+TEST_CASE("Build peak") {
+    // Without noise the logarithm of the intensity is a quadratic function,
+    // so the linearized fitting is exact.
+    auto raw_data = gaussian_raw_data(0);
+    Centroid::PeakContext context;
+    for (auto local_max : std::vector<Centroid::LocalMax>{
+             {400.5, 30.0, 1000}, {400.501, 29.5, 900}, {400.499, 31, 800}}) {
+        for (bool refine_fit : {false, true}) {
+            auto peak =
+                Centroid::build_peak(raw_data, local_max, context, refine_fit);
+            REQUIRE(peak);
+            CHECK(peak->fitted_height == doctest::Approx(1000).epsilon(1e-6));
+            CHECK(peak->fitted_mz == doctest::Approx(400.5).epsilon(1e-9));
+            CHECK(peak->fitted_rt == doctest::Approx(30.0).epsilon(1e-6));
+            CHECK(peak->fitted_sigma_mz ==
+                  doctest::Approx(0.003).epsilon(1e-6));
+            CHECK(peak->fitted_sigma_rt == doctest::Approx(2.0).epsilon(1e-6));
+        }
+
+        // Reusing the context gives the same results as a new one.
+        auto peak = Centroid::build_peak(raw_data, local_max, context);
+        auto new_context_peak = Centroid::build_peak(raw_data, local_max);
+        REQUIRE(peak);
+        REQUIRE(new_context_peak);
+        CHECK(new_context_peak->fitted_height == peak->fitted_height);
+        CHECK(new_context_peak->fitted_mz == peak->fitted_mz);
+        CHECK(new_context_peak->raw_roi_num_points ==
+              peak->raw_roi_num_points);
+    }
+
+    // Not enough scans in the region of interest.
+    CHECK_FALSE(Centroid::build_peak(raw_data, {400.5, 80.0, 1000}, context));
+}
+
+TEST_CASE("Refined peak fitting") {
+    // With noise, the points on the tails of the peak have a large error in
+    // log space, which biases the linearized fitting.
+    auto raw_data = gaussian_raw_data(1.5);
+    Centroid::LocalMax local_max = {400.5, 30.0, 1000};
+    Centroid::PeakContext context;
+    auto peak = Centroid::build_peak(raw_data, local_max, context, false);
+    auto refined_peak =
+        Centroid::build_peak(raw_data, local_max, context, true);
+    REQUIRE(peak);
+    REQUIRE(refined_peak);
+    auto squared_error = [](const Centroid::Peak &peak) {
+        double a = (peak.fitted_height - 1000) / 1000;
+        double b = (peak.fitted_sigma_mz - 0.003) / 0.003;
+        double c = (peak.fitted_sigma_rt - 2.0) / 2.0;
+        return a * a + b * b + c * c;
+    };
+    CHECK(squared_error(refined_peak.value()) < squared_error(peak.value()));
+    CHECK(refined_peak->fitted_height == doctest::Approx(1000).epsilon(0.02));
+    CHECK(refined_peak->fitted_mz == doctest::Approx(400.5).epsilon(1e-6));
+    CHECK(refined_peak->fitted_rt == doctest::Approx(30.0).epsilon(1e-2));
 }
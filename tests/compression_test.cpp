@@ -0,0 +1,59 @@
+#include <zlib.h>
+#include <vector>
+
+#include "doctest.h"
+
+#include "utils/compression.hpp"
+
+// Compress the given data with the default Zlib settings.
+std::vector<uint8_t> compress_data(const std::vector<uint8_t> &data) {
+    uLongf compressed_len = compressBound(data.size());
+    std::vector<uint8_t> compressed(compressed_len);
+    compress(compressed.data(), &compressed_len, data.data(), data.size());
+    compressed.resize(compressed_len);
+    return compressed;
+}
+
+TEST_CASE("Inflating data with a reusable inflator") {
+    Compression::Inflator inflator;
+    std::vector<uint8_t> output;
+    // Sizes both smaller and larger than the initial output estimate.
+    for (size_t size : {0, 1, 100, 5000, 1000000, 10}) {
+        std::vector<uint8_t> data(size);
+        for (size_t i = 0; i < size; ++i) {
+            data[i] = (i * 7 + i / 13) % 251;
+        }
+        auto compressed = compress_data(data);
+
+        // Unknown decompressed length.
+        CHECK(inflator.inflate(compressed.data(), compressed.size(), output,
+                               0) == Z_OK);
+        CHECK(output == data);
+
+        // Known decompressed length.
+        if (size != 0) {
+            CHECK(inflator.inflate(compressed.data(), compressed.size(),
+                                   output, size) == Z_OK);
+            CHECK(output == data);
+        }
+
+        // Free function.
+        std::vector<uint8_t> free_output;
+        CHECK(Compression::inflate(compressed, free_output, 0) == Z_OK);
+        CHECK(free_output == data);
+    }
+    SUBCASE("Invalid data") {
+        std::vector<uint8_t> data(1000, 42);
+        auto compressed = compress_data(data);
+        // Truncated stream.
+        CHECK(inflator.inflate(compressed.data(), compressed.size() / 2, output,
+                               0) != Z_OK);
+        // Data longer than the expected length.
+        CHECK(inflator.inflate(compressed.data(), compressed.size(), output,
+                               10) != Z_OK);
+        // The inflator can still be used after an error.
+        CHECK(inflator.inflate(compressed.data(), compressed.size(), output,
+                               0) == Z_OK);
+        CHECK(output == data);
+    }
+}
@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
 #include "doctest.h"
 #include "test_utils.hpp"
 
@@ -39,7 +43,257 @@ TEST_CASE("Test the warped grid interpolation") {
     }
 }
 
+TEST_CASE("Precalculated m/z indexes offer the same results as x_index") {
+    for (auto instrument_type : {Instrument::QUAD, Instrument::TOF,
+                                 Instrument::FTICR, Instrument::ORBITRAP}) {
+        Grid::Layout grid = {};
+        grid.k = 10;
+        grid.instrument_type = instrument_type;
+        grid.reference_mz = 200;
+        grid.fwhm_mz = 200.0 / 70000;
+        grid.min_mz = 300;
+        grid.max_mz = 2000;
+        grid.n = Grid::x_index(grid, grid.max_mz) + 1;
+        grid.bins_mz = std::vector<double>(grid.n);
+        for (size_t i = 0; i < grid.n; ++i) {
+            grid.bins_mz[i] = Grid::mz_at(grid, i);
+        }
+        Grid::MzIndex mz_index(grid);
+        bool same_index = true;
+        for (double mz = 299; mz <= 2001; mz += 0.0013) {
+            same_index &= mz_index.x_index(mz) == Grid::x_index(grid, mz);
+        }
+        for (double mz : grid.bins_mz) {
+            for (double x : {std::nextafter(mz, 0.0), mz,
+                             std::nextafter(mz, 3000.0)}) {
+                same_index &= mz_index.x_index(x) == Grid::x_index(grid, x);
+            }
+        }
+        CHECK(same_index);
+    }
+}
+
+TEST_CASE("Separable kernels match the direct 2D Gaussian resampling") {
+    auto raw_data = TestUtils::mock_raw_data(1.0);
+    auto params = Grid::ResampleParams{};
+    params.num_samples_mz = 10;
+    params.num_samples_rt = 10;
+    params.smoothing_coef_mz = 0.5;
+    params.smoothing_coef_rt = 0.5;
+    auto grid = Grid::resample(raw_data, params, 1);
+    uint64_t n = grid.n;
+    uint64_t m = grid.m;
+
+    // Smoothing parameters, calculated as in Grid::resample.
+    double sigma_rt = RawData::fwhm_to_sigma(raw_data.fwhm_rt) *
+                      params.smoothing_coef_rt / std::sqrt(2);
+    std::vector<double> sigma_mz(n);
+    for (size_t i = 0; i < n; ++i) {
+        sigma_mz[i] = RawData::fwhm_to_sigma(RawData::theoretical_fwhm(
+                          raw_data, grid.bins_mz[i])) *
+                      params.smoothing_coef_mz / std::sqrt(2);
+    }
+    double delta_rt = grid.fwhm_rt / params.num_samples_rt;
+    double delta_mz = grid.fwhm_mz / params.num_samples_mz;
+    uint64_t rt_kernel_hw = 3 * sigma_rt / delta_rt;
+    uint64_t mz_kernel_hw =
+        3 * RawData::fwhm_to_sigma(grid.fwhm_mz) / delta_mz;
+    auto kernel_range = [](uint64_t index, uint64_t hw, uint64_t size) {
+        uint64_t min_index = index >= hw ? index - hw : 0;
+        uint64_t max_index = index + hw < size ? index + hw : size - 1;
+        return std::make_pair(min_index, max_index);
+    };
+
+    // Splat every point with the full 2D Gaussian kernel.
+    std::vector<double> values(n * m);
+    std::vector<double> weights(n * m);
+    for (const auto &scan : raw_data.scans) {
+        double rt = scan.retention_time;
+        auto [j_min, j_max] =
+            kernel_range(Grid::y_index(grid, rt), rt_kernel_hw, m);
+        for (size_t k = 0; k < scan.num_points; ++k) {
+            double mz = scan.mz[k];
+            uint64_t index_mz = Grid::x_index(grid, mz);
+            auto [i_min, i_max] = kernel_range(index_mz, mz_kernel_hw, n);
+            for (size_t j = j_min; j <= j_max; ++j) {
+                for (size_t i = i_min; i <= i_max; ++i) {
+                    double a = (grid.bins_mz[i] - mz) / sigma_mz[index_mz];
+                    double b = (grid.bins_rt[j] - rt) / sigma_rt;
+                    double weight = std::exp(-0.5 * (a * a + b * b));
+                    values[i + j * n] += weight * scan.intensity[k];
+                    weights[i + j * n] += weight;
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (weights[i] != 0) {
+            values[i] /= weights[i];
+        }
+    }
+
+    // Smooth the splatted grid with the full 2D Gaussian kernel.
+    std::vector<double> expected(n * m);
+    for (size_t j = 0; j < m; ++j) {
+        auto [l_min, l_max] = kernel_range(j, rt_kernel_hw, m);
+        for (size_t i = 0; i < n; ++i) {
+            auto [k_min, k_max] = kernel_range(i, mz_kernel_hw, n);
+            double sum_weighted_values = 0;
+            double sum_weights = 0;
+            for (size_t l = l_min; l <= l_max; ++l) {
+                for (size_t k = k_min; k <= k_max; ++k) {
+                    double a =
+                        (grid.bins_mz[i] - grid.bins_mz[k]) / sigma_mz[i];
+                    double b = (grid.bins_rt[j] - grid.bins_rt[l]) / sigma_rt;
+                    double weight = std::exp(-0.5 * (a * a + b * b));
+                    sum_weighted_values += weight * values[k + l * n];
+                    sum_weights += weight;
+                }
+            }
+            expected[i + j * n] = sum_weighted_values / sum_weights;
+        }
+    }
+
+    // Only the rounding errors of the factorized weights and the different
+    // summation order are expected, so the values must agree up to 1e-9 of
+    // the maximum intensity.
+    REQUIRE(grid.data.size() == expected.size());
+    double max_value = *std::max_element(expected.begin(), expected.end());
+    double max_error = 0;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        max_error = std::max(max_error, std::abs(grid.data[i] - expected[i]));
+    }
+    CHECK(max_value > 0);
+    CHECK(max_error <= max_value * 1e-9);
+}
+
 TEST_CASE("Parallel and serial execution offer the same results") {
-    // TODO:...
-    CHECK(true);
+    auto raw_data = TestUtils::mock_raw_data();
+    auto params = Grid::ResampleParams{};
+    params.num_samples_mz = 10;
+    params.num_samples_rt = 10;
+    params.smoothing_coef_mz = 0.5;
+    params.smoothing_coef_rt = 0.5;
+    auto serial = Grid::resample(raw_data, params);
+    for (size_t max_threads : {2, 3, 8}) {
+        auto parallel = Grid::resample(raw_data, params, max_threads);
+        CHECK(parallel.n == serial.n);
+        CHECK(parallel.m == serial.m);
+        CHECK(parallel.bins_mz == serial.bins_mz);
+        CHECK(parallel.bins_rt == serial.bins_rt);
+        CHECK(parallel.data == serial.data);
+    }
+}
+
+TEST_CASE("Single and double precision grids offer the same results") {
+    auto raw_data = TestUtils::mock_raw_data();
+    auto params = Grid::ResampleParams{};
+    params.num_samples_mz = 10;
+    params.num_samples_rt = 10;
+    params.smoothing_coef_mz = 0.5;
+    params.smoothing_coef_rt = 0.5;
+    auto grid = Grid::resample<double>(raw_data, params, 1);
+    auto float_grid = Grid::resample<float>(raw_data, params, 2);
+    CHECK(float_grid.n == grid.n);
+    CHECK(float_grid.m == grid.m);
+    CHECK(float_grid.bins_mz == grid.bins_mz);
+    CHECK(float_grid.bins_rt == grid.bins_rt);
+    REQUIRE(float_grid.data.size() == grid.data.size());
+    double max_value = *std::max_element(grid.data.begin(), grid.data.end());
+    double max_error = 0;
+    for (size_t i = 0; i < grid.data.size(); ++i) {
+        max_error = std::max(max_error, std::abs(float_grid.data[i] -
+                                                 grid.data[i]));
+    }
+    CHECK(max_error <= max_value * 1e-6);
+}
+
+TEST_CASE("Tiled and dense grids offer the same results") {
+    auto raw_data = TestUtils::mock_raw_data(1.0);
+    auto params = Grid::ResampleParams{};
+    params.num_samples_mz = 10;
+    params.num_samples_rt = 10;
+    params.smoothing_coef_mz = 0.5;
+    params.smoothing_coef_rt = 0.5;
+    auto grid = Grid::resample(raw_data, params, 1);
+    for (size_t max_threads : {1, 4}) {
+        auto tiled_grid = Grid::resample_tiled(raw_data, params, max_threads);
+        CHECK(tiled_grid.n == grid.n);
+        CHECK(tiled_grid.m == grid.m);
+        CHECK(tiled_grid.bins_mz == grid.bins_mz);
+        CHECK(tiled_grid.bins_rt == grid.bins_rt);
+
+        // Only the tiles around the two peaks are allocated.
+        size_t num_tiles = tiled_grid.data.size() /
+                           (Grid::TILE_SIZE * Grid::TILE_SIZE);
+        CHECK(num_tiles > 0);
+        CHECK(num_tiles < tiled_grid.tile_index.size() / 4);
+        CHECK(Grid::to_dense(tiled_grid).data == grid.data);
+
+        // The same local maxima are found in both grids.
+        auto sort_local_max = [](std::vector<Centroid::LocalMax> points) {
+            std::sort(points.begin(), points.end(),
+                      [](const auto &a, const auto &b) {
+                          return std::tie(a.rt, a.mz) < std::tie(b.rt, b.mz);
+                      });
+            return points;
+        };
+        auto local_max = sort_local_max(Centroid::find_local_maxima(grid));
+        auto tiled_local_max =
+            sort_local_max(Centroid::find_local_maxima(tiled_grid));
+        CHECK(local_max.size() >= 2);
+        REQUIRE(tiled_local_max.size() == local_max.size());
+        for (size_t i = 0; i < local_max.size(); ++i) {
+            CHECK(tiled_local_max[i].mz == local_max[i].mz);
+            CHECK(tiled_local_max[i].rt == local_max[i].rt);
+            CHECK(tiled_local_max[i].value == local_max[i].value);
+        }
+    }
+}
+
+TEST_CASE("Streaming and dense grids offer the same results") {
+    auto raw_data = TestUtils::mock_raw_data();
+    auto params = Grid::ResampleParams{};
+    params.num_samples_mz = 5;
+    params.num_samples_rt = 5;
+    params.smoothing_coef_mz = 0.5;
+    params.smoothing_coef_rt = 0.5;
+    auto grid = Grid::resample(raw_data, params, 1);
+
+    SUBCASE("The emitted rows match the dense grid") {
+        std::vector<double> data;
+        uint64_t next_row = 0;
+        Grid::StreamingResampler resampler(
+            raw_data, params, [&](uint64_t j, const std::vector<double> &row) {
+                CHECK(j == next_row);
+                ++next_row;
+                data.insert(data.end(), row.begin(), row.end());
+            });
+        CHECK(resampler.layout().n == grid.n);
+        CHECK(resampler.layout().m == grid.m);
+        for (const auto &scan : raw_data.scans) {
+            CHECK(resampler.add_scan(scan));
+        }
+        resampler.finish();
+        CHECK(next_row == grid.m);
+        CHECK(data == grid.data);
+    }
+    SUBCASE("Scans out of retention time order are rejected") {
+        Grid::StreamingResampler resampler(
+            raw_data, params, [](uint64_t, const std::vector<double> &) {});
+        CHECK(resampler.add_scan(raw_data.scans[1]));
+        CHECK_FALSE(resampler.add_scan(raw_data.scans[0]));
+    }
+    SUBCASE("The same peaks are found") {
+        auto peaks = Centroid::find_peaks_serial(raw_data, grid, 100);
+        auto streaming_peaks =
+            Centroid::find_peaks_streaming(raw_data, params, 100);
+        CHECK(peaks.size() >= 2);
+        REQUIRE(streaming_peaks.size() == peaks.size());
+        for (size_t i = 0; i < peaks.size(); ++i) {
+            CHECK(streaming_peaks[i].local_max_mz == peaks[i].local_max_mz);
+            CHECK(streaming_peaks[i].local_max_rt == peaks[i].local_max_rt);
+            CHECK(streaming_peaks[i].fitted_height == peaks[i].fitted_height);
+        }
+    }
 }
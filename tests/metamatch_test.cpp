@@ -68,11 +68,13 @@ TEST_CASE("Clustering features lists") {
     std::vector<FeatureDetection::Feature> features_b = {
         mock_feature(0, peaks_b),
     };
-    std::vector<MetaMatch::InputSetFeatures> input_sets = {
-        {0, peaks_a, features_a},
-        {0, peaks_b, features_b},
+    std::vector<uint64_t> group_ids = {0, 0};
+    std::vector<std::vector<FeatureDetection::Feature>> features = {
+        features_a,
+        features_b,
     };
-    auto clusters = MetaMatch::find_feature_clusters(input_sets);
+    auto clusters = MetaMatch::find_feature_clusters(group_ids, features, 0.0,
+                                                     0.0, 3.0, 3.0);
     for (const auto &cluster : clusters) {
         CHECK(cluster.id == 0);
         CHECK(TestUtils::compare_double(cluster.mz, 400.678, 3));
@@ -80,3 +82,32 @@ TEST_CASE("Clustering features lists") {
         CHECK(cluster.feature_ids.size() == 2);
     }
 }
+
+TEST_CASE("Per file quantification matrices") {
+    SUBCASE("One column per file") {
+        std::vector<MetaMatch::PeakCluster> clusters(2);
+        clusters[0].heights = {1.0, 2.0, 3.0};
+        clusters[1].heights = {4.0};
+        auto matrix = MetaMatch::file_values_matrix(
+            clusters, &MetaMatch::PeakCluster::heights, 3);
+        REQUIRE(matrix.size() == 6);
+        CHECK(matrix[0] == 1.0);
+        CHECK(matrix[1] == 2.0);
+        CHECK(matrix[2] == 3.0);
+        CHECK(matrix[3] == 4.0);
+        CHECK(std::isnan(matrix[4]));
+        CHECK(std::isnan(matrix[5]));
+    }
+    SUBCASE("Empty peak cluster list") {
+        std::vector<MetaMatch::PeakCluster> clusters;
+        auto matrix = MetaMatch::file_values_matrix(
+            clusters, &MetaMatch::PeakCluster::volumes, 3);
+        CHECK(matrix.empty());
+    }
+    SUBCASE("Empty feature cluster list") {
+        std::vector<MetaMatch::FeatureCluster> clusters;
+        auto matrix = MetaMatch::file_values_matrix(
+            clusters, &MetaMatch::FeatureCluster::monoisotopic_heights, 3);
+        CHECK(matrix.empty());
+    }
+}
@@ -0,0 +1,78 @@
+#include "doctest.h"
+
+#include "protein_inference/protein_inference.hpp"
+
+TEST_CASE("Protein inference graph and razor") {
+    // Proteins A and B share peptide Pep_1, Pep_2 is only on B and Pep_3 only
+    // on C. PSM_4 references an unknown peptide.
+    IdentData::IdentData ident_data = {};
+    IdentData::IdInterner interner(ident_data.ids);
+    for (const auto &id : {"A", "B", "C"}) {
+        IdentData::DBSequence db_sequence = {};
+        db_sequence.id = interner.intern(id);
+        ident_data.db_sequences.push_back(db_sequence);
+    }
+    for (const auto &id : {"Pep_1", "Pep_2", "Pep_3"}) {
+        IdentData::Peptide peptide = {};
+        peptide.id = interner.intern(id);
+        ident_data.peptides.push_back(peptide);
+    }
+    std::vector<std::pair<std::string, std::string>> evidence = {
+        {"A", "Pep_1"}, {"B", "Pep_1"}, {"B", "Pep_2"},
+        {"B", "Pep_2"}, {"C", "Pep_3"},
+    };
+    for (const auto &[db_sequence_id, peptide_id] : evidence) {
+        IdentData::PeptideEvidence peptide_evidence = {};
+        peptide_evidence.db_sequence_id = interner.intern(db_sequence_id);
+        peptide_evidence.peptide_id = interner.intern(peptide_id);
+        ident_data.peptide_evidence.push_back(peptide_evidence);
+    }
+    std::vector<std::pair<std::string, std::string>> psms = {
+        {"PSM_1", "Pep_1"},
+        {"PSM_2", "Pep_2"},
+        {"PSM_3", "Pep_3"},
+        {"PSM_4", "Pep_4"},
+    };
+    for (const auto &[id, match_id] : psms) {
+        IdentData::SpectrumMatch spectrum_match = {};
+        spectrum_match.id = interner.intern(id);
+        spectrum_match.match_id = interner.intern(match_id);
+        ident_data.spectrum_matches.push_back(spectrum_match);
+    }
+    IdentData::resolve_references(ident_data);
+
+    SUBCASE("Graph") {
+        auto graph = ProteinInference::create_graph(ident_data);
+        CHECK(graph.protein_nodes.size() == 3);
+        CHECK(graph.psm_nodes.size() == 3);
+        if (graph.protein_nodes.size() == 3 && graph.psm_nodes.size() == 3) {
+            CHECK(graph.protein_nodes[0].id == "A");
+            CHECK(graph.protein_nodes[0].num == 1);
+            CHECK(graph.protein_nodes[1].id == "B");
+            CHECK(graph.protein_nodes[1].num == 2);
+            CHECK(graph.protein_nodes[2].id == "C");
+            CHECK(graph.protein_nodes[2].num == 1);
+            CHECK(graph.psm_nodes[0].id == "PSM_1");
+            CHECK(graph.psm_nodes[0].num == 2);
+            CHECK(graph.psm_nodes[0].nodes ==
+                  std::vector<std::optional<uint64_t>>{0, 1});
+            // Duplicated evidence doesn't create duplicated edges.
+            CHECK(graph.psm_nodes[1].num == 1);
+            CHECK(graph.psm_nodes[2].nodes ==
+                  std::vector<std::optional<uint64_t>>{2});
+        }
+    }
+
+    SUBCASE("Razor") {
+        auto inferred_proteins = ProteinInference::razor(ident_data);
+        CHECK(inferred_proteins.size() == 3);
+        if (inferred_proteins.size() == 3) {
+            CHECK(inferred_proteins[0].protein_id == "B");
+            CHECK(inferred_proteins[0].psm_id == "PSM_1");
+            CHECK(inferred_proteins[1].protein_id == "B");
+            CHECK(inferred_proteins[1].psm_id == "PSM_2");
+            CHECK(inferred_proteins[2].protein_id == "C");
+            CHECK(inferred_proteins[2].psm_id == "PSM_3");
+        }
+    }
+}
@@ -0,0 +1,211 @@
+#include <sstream>
+
+#include "doctest.h"
+
+#include "raw_data/raw_data_columnar.hpp"
+#include "raw_data/raw_data_serialize.hpp"
+
+// Generate a raw data object with the given number of scans, with a growing
+// number of points per scan.
+static RawData::RawData make_raw_data(size_t num_scans) {
+    RawData::RawData raw_data = {};
+    raw_data.instrument_type = Instrument::ORBITRAP;
+    raw_data.min_mz = 100.0;
+    raw_data.max_mz = 1000.0;
+    raw_data.min_rt = 0.0;
+    raw_data.max_rt = num_scans;
+    raw_data.resolution_ms1 = 70000;
+    raw_data.resolution_msn = 30000;
+    raw_data.reference_mz = 200;
+    raw_data.fwhm_rt = 10;
+    for (size_t i = 0; i < num_scans; ++i) {
+        RawData::Scan scan = {};
+        scan.scan_number = i + 1;
+        scan.ms_level = 1 + i % 2;
+        scan.retention_time = i;
+        scan.polarity = Polarity::POSITIVE;
+        scan.precursor_information.scan_number = i;
+        scan.precursor_information.charge = 2;
+        scan.precursor_information.mz = 500.25;
+        scan.precursor_information.intensity = 1e6;
+        scan.precursor_information.activation_method = ActivationMethod::CID;
+        scan.precursor_information.window_wideness = 2.0;
+        for (size_t j = 0; j < i * 10; ++j) {
+            scan.mz.push_back(100.0 + j * 0.1);
+            scan.intensity.push_back((i + 1) * (j % 7));
+        }
+        scan.num_points = scan.mz.size();
+        scan.max_intensity = i * 6;
+        scan.total_intensity = i * 3;
+        raw_data.scans.push_back(scan);
+        raw_data.retention_times.push_back(i);
+    }
+    return raw_data;
+}
+
+static void check_scans(const RawData::Scan &a, const RawData::Scan &b) {
+    CHECK(a.scan_number == b.scan_number);
+    CHECK(a.ms_level == b.ms_level);
+    CHECK(a.num_points == b.num_points);
+    CHECK(a.retention_time == b.retention_time);
+    CHECK(a.mz == b.mz);
+    CHECK(a.intensity == b.intensity);
+    CHECK(a.max_intensity == b.max_intensity);
+    CHECK(a.total_intensity == b.total_intensity);
+    CHECK(a.polarity == b.polarity);
+    CHECK(a.precursor_information.scan_number ==
+          b.precursor_information.scan_number);
+    CHECK(a.precursor_information.charge == b.precursor_information.charge);
+    CHECK(a.precursor_information.mz == b.precursor_information.mz);
+    CHECK(a.precursor_information.intensity ==
+          b.precursor_information.intensity);
+    CHECK(a.precursor_information.activation_method ==
+          b.precursor_information.activation_method);
+    CHECK(a.precursor_information.window_wideness ==
+          b.precursor_information.window_wideness);
+}
+
+TEST_CASE("Read/Write columnar raw data") {
+    // Enough points to span multiple blocks.
+    auto raw_data = make_raw_data(150);
+    for (bool compress : {true, false}) {
+        std::stringstream stream;
+        CHECK(RawData::Columnar::write_raw_data(stream, raw_data, compress));
+        auto file = stream.str();
+        CHECK(RawData::Columnar::is_columnar(file));
+
+        SUBCASE("Full file") {
+            auto read = RawData::Columnar::read_raw_data(file);
+            REQUIRE(read);
+            CHECK(read->instrument_type == raw_data.instrument_type);
+            CHECK(read->min_mz == raw_data.min_mz);
+            CHECK(read->max_mz == raw_data.max_mz);
+            CHECK(read->min_rt == raw_data.min_rt);
+            CHECK(read->max_rt == raw_data.max_rt);
+            CHECK(read->resolution_ms1 == raw_data.resolution_ms1);
+            CHECK(read->resolution_msn == raw_data.resolution_msn);
+            CHECK(read->reference_mz == raw_data.reference_mz);
+            CHECK(read->fwhm_rt == raw_data.fwhm_rt);
+            CHECK(read->retention_times == raw_data.retention_times);
+            REQUIRE(read->scans.size() == raw_data.scans.size());
+            for (size_t i = 0; i < raw_data.scans.size(); ++i) {
+                check_scans(read->scans[i], raw_data.scans[i]);
+            }
+        }
+        SUBCASE("Retention time window") {
+            auto read = RawData::Columnar::read_raw_data(file, 99.5, 120);
+            REQUIRE(read);
+            REQUIRE(read->scans.size() == 21);
+            for (size_t i = 0; i < read->scans.size(); ++i) {
+                check_scans(read->scans[i], raw_data.scans[100 + i]);
+                CHECK(read->retention_times[i] == 100 + i);
+            }
+            read = RawData::Columnar::read_raw_data(file, 200, 300);
+            REQUIRE(read);
+            CHECK(read->scans.empty());
+        }
+        SUBCASE("Raw points and XIC") {
+            auto points = RawData::Columnar::raw_points(file, 101, 102, 20, 30);
+            REQUIRE(points);
+            auto expected_points =
+                RawData::raw_points(raw_data, 101, 102, 20, 30);
+            CHECK(points->num_points == expected_points.num_points);
+            CHECK(points->num_scans == expected_points.num_scans);
+            CHECK(points->rt == expected_points.rt);
+            CHECK(points->mz == expected_points.mz);
+            CHECK(points->intensity == expected_points.intensity);
+
+            auto xic = RawData::Columnar::xic(file, 101, 102, 20, 30,
+                                              Xic::Method::SUM);
+            REQUIRE(xic);
+            auto expected_xic =
+                RawData::xic(raw_data, 101, 102, 20, 30, Xic::Method::SUM);
+            CHECK(xic->retention_time == expected_xic.retention_time);
+            CHECK(xic->intensity == expected_xic.intensity);
+        }
+    }
+}
+
+TEST_CASE("Retention time window on legacy raw data") {
+    // Files in the previous serialization format are read entirely and the
+    // scans outside of the window are dropped afterwards, which must give the
+    // same result as reading the window from a columnar file.
+    auto raw_data = make_raw_data(150);
+    std::stringstream legacy_stream;
+    CHECK(RawData::Serialize::write_raw_data(legacy_stream, raw_data));
+    std::stringstream columnar_stream;
+    CHECK(RawData::Columnar::write_raw_data(columnar_stream, raw_data));
+    auto columnar_file = columnar_stream.str();
+    CHECK(!RawData::Columnar::is_columnar(legacy_stream.str()));
+
+    for (auto [min_rt, max_rt] : {std::pair{99.5, 120.0}, std::pair{-1.0, 0.0},
+                                  std::pair{149.0, 300.0},
+                                  std::pair{200.0, 300.0}}) {
+        RawData::RawData legacy = {};
+        legacy_stream.seekg(0);
+        REQUIRE(RawData::Serialize::read_raw_data(legacy_stream, &legacy));
+        RawData::filter_retention_time(legacy, min_rt, max_rt);
+        auto columnar =
+            RawData::Columnar::read_raw_data(columnar_file, min_rt, max_rt);
+        REQUIRE(columnar);
+        CHECK(legacy.min_rt == raw_data.min_rt);
+        CHECK(legacy.max_rt == raw_data.max_rt);
+        CHECK(legacy.retention_times == columnar->retention_times);
+        REQUIRE(legacy.scans.size() == columnar->scans.size());
+        for (size_t i = 0; i < legacy.scans.size(); ++i) {
+            check_scans(legacy.scans[i], columnar->scans[i]);
+        }
+    }
+}
+
+TEST_CASE("Writing unsorted columnar raw data") {
+    // The scan index must be sorted by retention time for the windows to be
+    // found with a binary search.
+    auto raw_data = make_raw_data(10);
+    std::swap(raw_data.retention_times[3], raw_data.retention_times[4]);
+    std::stringstream stream;
+    CHECK(!RawData::Columnar::write_raw_data(stream, raw_data));
+    CHECK(stream.str().empty());
+
+    // Without retention_times, the retention times of the scans are used.
+    raw_data.retention_times.clear();
+    CHECK(RawData::Columnar::write_raw_data(stream, raw_data));
+    std::swap(raw_data.scans[3], raw_data.scans[4]);
+    std::stringstream unsorted_stream;
+    CHECK(!RawData::Columnar::write_raw_data(unsorted_stream, raw_data));
+}
+
+TEST_CASE("Reading invalid columnar raw data") {
+    CHECK(!RawData::Columnar::is_columnar(""));
+    CHECK(!RawData::Columnar::read_raw_data(""));
+    CHECK(!RawData::Columnar::read_raw_data("PASTAQRD"));
+    CHECK(!RawData::Columnar::read_raw_data("not a columnar raw data file"));
+
+    std::stringstream stream;
+    CHECK(RawData::Columnar::write_raw_data(stream, make_raw_data(10)));
+    auto file = stream.str();
+    CHECK(RawData::Columnar::read_raw_data(file));
+    // Truncated file.
+    CHECK(!RawData::Columnar::read_raw_data(file.substr(0, file.size() - 1)));
+    // Unknown version.
+    auto wrong_version = file;
+    wrong_version[8] = 2;
+    CHECK(!RawData::Columnar::read_raw_data(wrong_version));
+
+    // A corrupt number of points in a compressed block is rejected before
+    // allocating the decompressed columns.
+    uint64_t block_index_offset = 0;
+    for (size_t k = 0; k < 8; ++k) {
+        auto byte = static_cast<uint8_t>(file[file.size() - 8 + k]);
+        block_index_offset |= static_cast<uint64_t>(byte) << (8 * k);
+    }
+    REQUIRE(file[block_index_offset + 24] == 1);
+    for (uint64_t block_points : {uint64_t(1) << 20, uint64_t(1) << 40}) {
+        auto corrupt = file;
+        for (size_t k = 0; k < 8; ++k) {
+            corrupt[block_index_offset + 16 + k] =
+                static_cast<char>(block_points >> (8 * k));
+        }
+        CHECK(!RawData::Columnar::read_raw_data(corrupt));
+    }
+}
@@ -0,0 +1,140 @@
+#include <sstream>
+
+#include "doctest.h"
+
+#include "raw_data/raw_data.hpp"
+#include "raw_data/raw_data_serialize.hpp"
+
+// Generate a raw data object with the given number of scans. Every third scan
+// is empty, and the rest contain a growing number of points.
+static RawData::RawData make_raw_data(size_t num_scans) {
+    RawData::RawData raw_data = {};
+    raw_data.instrument_type = Instrument::ORBITRAP;
+    raw_data.min_mz = 100.0;
+    raw_data.max_mz = 1000.0;
+    raw_data.min_rt = 0.0;
+    raw_data.max_rt = num_scans;
+    for (size_t i = 0; i < num_scans; ++i) {
+        RawData::Scan scan = {};
+        scan.scan_number = i + 1;
+        scan.ms_level = 1;
+        scan.retention_time = i;
+        if (i % 3 != 0) {
+            for (size_t j = 0; j < i * 10; ++j) {
+                scan.mz.push_back(100.0 + j * 0.1);
+                scan.intensity.push_back((i + 1) * (j % 7));
+            }
+        }
+        scan.num_points = scan.mz.size();
+        raw_data.scans.push_back(scan);
+        raw_data.retention_times.push_back(i);
+    }
+    return raw_data;
+}
+
+TEST_CASE("Batch XIC extraction") {
+    auto raw_data = make_raw_data(100);
+    std::vector<Xic::Window> windows = {
+        {101, 102, 20, 30},  {100, 1000, 0, 100}, {105, 105.5, 50, 52},
+        {101, 102, 90, 200}, {101, 102, 40, 30},  {200, 300, 10, 20},
+        {101, 102, 0, 0.5},  {101, 102, 20, 30},
+    };
+    // Windows starting at many different retention times, so that the sorted
+    // order differs from the input order.
+    for (size_t i = 0; i < 50; ++i) {
+        double min_rt = (i * 37) % 100;
+        windows.push_back({100.0 + i, 101.5 + i, min_rt, min_rt + 5});
+    }
+
+    SUBCASE("The results are the same as xic") {
+        for (auto method : {Xic::SUM, Xic::MAX}) {
+            for (size_t max_threads : {1, 4}) {
+                auto batch =
+                    RawData::xic_batch(raw_data, windows, method, max_threads);
+                CHECK(batch.method == method);
+                REQUIRE(batch.offsets.size() == windows.size() + 1);
+                CHECK(batch.offsets.back() == batch.retention_time.size());
+                CHECK(batch.offsets.back() == batch.intensity.size());
+                for (size_t k = 0; k < windows.size(); ++k) {
+                    const auto &window = windows[k];
+                    auto xic =
+                        RawData::xic(raw_data, window.min_mz, window.max_mz,
+                                     window.min_rt, window.max_rt, method);
+                    std::vector<double> retention_time(
+                        batch.retention_time.begin() + batch.offsets[k],
+                        batch.retention_time.begin() + batch.offsets[k + 1]);
+                    std::vector<double> intensity(
+                        batch.intensity.begin() + batch.offsets[k],
+                        batch.intensity.begin() + batch.offsets[k + 1]);
+                    CHECK(retention_time == xic.retention_time);
+                    CHECK(intensity == xic.intensity);
+                }
+            }
+        }
+    }
+    SUBCASE("Unknown method") {
+        auto batch = RawData::xic_batch(raw_data, windows, Xic::UNKNOWN, 1);
+        CHECK(batch.method == Xic::UNKNOWN);
+        CHECK(batch.retention_time.empty());
+    }
+}
+
+TEST_CASE("Identification ids are stored once") {
+    IdentData::IdentData ident_data = {};
+    IdentData::IdInterner interner(ident_data.ids);
+    ident_data.db_sequences.push_back({interner.intern("DBSeq_1"), "P1", "db",
+                                       "Protein 1"});
+    ident_data.peptides.push_back({interner.intern("Pep_1"), "PEPTIDEK", {}});
+    ident_data.peptide_evidence.push_back({interner.intern("PE_1"),
+                                           interner.intern("DBSeq_1"),
+                                           interner.intern("Pep_1"), 0, 0,
+                                           false});
+    // Long ids are not affected by the reallocation of the pool.
+    std::string long_id(100, 'x');
+    for (size_t i = 0; i < 100; ++i) {
+        auto id = long_id + std::to_string(i);
+        IdentData::SpectrumMatch spectrum_match = {};
+        spectrum_match.id = interner.intern(id);
+        spectrum_match.match_id = interner.intern(i % 2 ? "Pep_1" : "Pep_2");
+        ident_data.spectrum_matches.push_back(spectrum_match);
+        CHECK(interner.intern(id) == spectrum_match.id);
+    }
+    const auto &ids = ident_data.ids;
+    CHECK(ids.size() == 104);
+    // Looking up an id that is already in the pool doesn't modify it, even
+    // if the pool is full.
+    ident_data.ids.shrink_to_fit();
+    const auto *pool = ids.data();
+    CHECK(interner.intern(long_id + "42") ==
+          ident_data.spectrum_matches[42].id);
+    CHECK(ids.data() == pool);
+    CHECK(ids.size() == 104);
+    CHECK(ident_data.peptide_evidence[0].db_sequence_id ==
+          ident_data.db_sequences[0].id);
+    CHECK(ident_data.peptide_evidence[0].peptide_id ==
+          ident_data.peptides[0].id);
+    CHECK(ids[ident_data.spectrum_matches[99].id] == long_id + "99");
+
+    IdentData::resolve_references(ident_data);
+    CHECK(ident_data.spectrum_matches[0].match_index == IdentData::NO_INDEX);
+    CHECK(ident_data.spectrum_matches[1].match_index == 0);
+
+    // The ids are serialized as strings and interned again when reading.
+    std::stringstream stream;
+    REQUIRE(IdentData::Serialize::write_ident_data(stream, ident_data));
+    IdentData::IdentData read_data = {};
+    REQUIRE(IdentData::Serialize::read_ident_data(stream, &read_data));
+    CHECK(read_data.ids.size() == ids.size());
+    REQUIRE(read_data.spectrum_matches.size() == 100);
+    for (size_t i = 0; i < 100; ++i) {
+        const auto &a = ident_data.spectrum_matches[i];
+        const auto &b = read_data.spectrum_matches[i];
+        CHECK(read_data.ids[b.id] == ids[a.id]);
+        CHECK(read_data.ids[b.match_id] == ids[a.match_id]);
+        CHECK(b.match_index == a.match_index);
+    }
+    REQUIRE(read_data.peptide_evidence.size() == 1);
+    CHECK(read_data.peptide_evidence[0].db_sequence_index == 0);
+    CHECK(read_data.peptide_evidence[0].peptide_index == 0);
+    CHECK(read_data.ids[read_data.db_sequences[0].id] == "DBSeq_1");
+}
@@ -40,6 +40,41 @@ inline Centroid::Peak mock_gaussian_peak(size_t id, double height, double mz,
     return peak;
 }
 
+// Mock raw data with two Gaussian peaks. Points with an intensity below
+// min_intensity are discarded.
+inline RawData::RawData mock_raw_data(double min_intensity = 0) {
+    RawData::RawData raw_data = {};
+    raw_data.instrument_type = Instrument::ORBITRAP;
+    raw_data.min_mz = 400.0;
+    raw_data.max_mz = 402.0;
+    raw_data.min_rt = 0.0;
+    raw_data.max_rt = 60.0;
+    raw_data.resolution_ms1 = 70000;
+    raw_data.reference_mz = 200;
+    raw_data.fwhm_rt = 5;
+    for (double rt = raw_data.min_rt; rt <= raw_data.max_rt; rt += 0.5) {
+        RawData::Scan scan = {};
+        scan.retention_time = rt;
+        for (double mz = raw_data.min_mz; mz < raw_data.max_mz; mz += 0.002) {
+            double a = (mz - 400.5) / 0.002;
+            double b = (rt - 20.0) / 2.0;
+            double c = (mz - 401.2) / 0.003;
+            double d = (rt - 42.0) / 3.0;
+            double intensity = 1000 * std::exp(-0.5 * (a * a + b * b)) +
+                               500 * std::exp(-0.5 * (c * c + d * d));
+            if (intensity < min_intensity) {
+                continue;
+            }
+            scan.mz.push_back(mz);
+            scan.intensity.push_back(intensity);
+        }
+        scan.num_points = scan.mz.size();
+        raw_data.scans.push_back(scan);
+        raw_data.retention_times.push_back(rt);
+    }
+    return raw_data;
+}
+
 }  // namespace TestUtils
 
 #endif /* TESTS_TESTUTILS */
@@ -0,0 +1,91 @@
+#include <atomic>
+#include <vector>
+
+#include "doctest.h"
+
+#include "utils/thread_pool.hpp"
+
+TEST_CASE("Every item is processed once by the thread pool") {
+    ThreadPool::Pool pool(3);
+    CHECK(pool.size() == 3);
+    for (size_t num_items : {0, 1, 7, 1000}) {
+        for (size_t max_threads : {0, 1, 2, 4, 16}) {
+            for (size_t chunk_size : {0, 1, 3, 2000}) {
+                // The assertions are not thread safe, so the ranges are
+                // checked after the call.
+                std::vector<std::atomic<int>> visits(num_items);
+                std::atomic<bool> valid_ranges = true;
+                pool.parallel_for(
+                    num_items, max_threads,
+                    [&](size_t begin, size_t end) {
+                        if (begin >= end || end > num_items) {
+                            valid_ranges = false;
+                        }
+                        for (size_t i = begin; i < end; ++i) {
+                            ++visits[i];
+                        }
+                    },
+                    chunk_size);
+                CHECK(valid_ranges);
+                for (const auto &count : visits) {
+                    CHECK(count == 1);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Thread pool statistics") {
+    ThreadPool::Pool pool(3);
+    pool.reset_stats();
+    std::atomic<size_t> sum = 0;
+    auto add_range = [&sum](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            sum += i;
+        }
+    };
+
+    // A single thread doesn't create a job.
+    pool.parallel_for(100, 1, add_range, 10);
+    auto stats = pool.stats();
+    CHECK(stats.num_workers == 3);
+    CHECK(stats.jobs == 0);
+    CHECK(stats.tasks == 0);
+
+    // Each chunk of 10 items is a task.
+    pool.parallel_for(100, 4, add_range, 10);
+    stats = pool.stats();
+    CHECK(stats.jobs == 1);
+    CHECK(stats.tasks == 10);
+    CHECK(stats.steals <= stats.tasks);
+    CHECK(sum == 2 * 4950);
+
+    pool.reset_stats();
+    stats = pool.stats();
+    CHECK(stats.jobs == 0);
+    CHECK(stats.tasks == 0);
+    CHECK(stats.steals == 0);
+}
+
+TEST_CASE("Nested calls to the thread pool") {
+    ThreadPool::Pool pool(2);
+    std::vector<std::atomic<int>> visits(50 * 50);
+    pool.parallel_for(
+        50, 4,
+        [&](size_t begin, size_t end) {
+            for (size_t j = begin; j < end; ++j) {
+                pool.parallel_for(
+                    50, 4,
+                    [&](size_t inner_begin, size_t inner_end) {
+                        for (size_t i = inner_begin; i < inner_end; ++i) {
+                            ++visits[i + j * 50];
+                        }
+                    },
+                    1);
+            }
+        },
+        1);
+    for (const auto &count : visits) {
+        CHECK(count == 1);
+    }
+}
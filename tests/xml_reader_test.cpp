@@ -43,6 +43,100 @@ TEST_CASE("Reading a well formed tag") {
     }
 }
 
+TEST_CASE("Reading a well formed tag from a buffer") {
+    SUBCASE("Attributes") {
+        std::vector<std::string> table = {
+            "<testTag attr1=\"one two\" attr2=\"2.0001\">DATA</testTag>",
+            "<testTag attr1=\"one two\"   attr2=\"2.0001\">DATA</testTag>",
+            "<testTag\tattr1=\"one two\"\nattr2=\"2.0001\"\n>DATA</testTag>",
+            "<testTag attr1 = \"one two\" attr2='2.0001'  >DATA</testTag>",
+        };
+        for (auto& test : table) {
+            auto cursor = XmlReader::Cursor{test, 0};
+            auto parsed_tag = XmlReader::read_tag(cursor);
+            CHECK(parsed_tag != std::nullopt);
+            if (parsed_tag) {
+                CHECK(parsed_tag->name == "testTag");
+                CHECK(parsed_tag->num_attributes == 2);
+                CHECK_FALSE(parsed_tag->truncated);
+                CHECK(parsed_tag->attribute("attr1") == "one two");
+                CHECK(parsed_tag->attribute("attr2") == "2.0001");
+                CHECK(parsed_tag->attribute("attr3") == std::nullopt);
+                CHECK_FALSE(parsed_tag->closed);
+            }
+            auto data = XmlReader::read_data(cursor);
+            CHECK(data == "DATA");
+        }
+    }
+    SUBCASE("More attributes than fit in the view") {
+        size_t num_attributes = XmlReader::TagView::MAX_ATTRIBUTES + 8;
+        std::string test = "<testTag";
+        for (size_t i = 0; i < num_attributes; ++i) {
+            test += " attr" + std::to_string(i) + "='" + std::to_string(i) +
+                    "'";
+        }
+        test += "/>";
+        auto cursor = XmlReader::Cursor{test, 0};
+        auto parsed_tag = XmlReader::read_tag(cursor);
+        REQUIRE(parsed_tag != std::nullopt);
+        CHECK(parsed_tag->truncated);
+        CHECK(parsed_tag->closed);
+        CHECK(parsed_tag->num_attributes ==
+              XmlReader::TagView::MAX_ATTRIBUTES);
+        for (size_t i = 0; i < num_attributes; ++i) {
+            CHECK(parsed_tag->attribute("attr" + std::to_string(i)) ==
+                  std::to_string(i));
+        }
+        CHECK(parsed_tag->attribute("attr" + std::to_string(num_attributes)) ==
+              std::nullopt);
+
+        // Malformed attributes past the limit still fail the parse.
+        test.insert(test.size() - 2, " bad=value");
+        cursor = XmlReader::Cursor{test, 0};
+        CHECK(XmlReader::read_tag(cursor) == std::nullopt);
+    }
+    SUBCASE("Closing and self-closing tags") {
+        std::string test =
+            "  <cvParam accession=\"MS:1000579\"/>\n"
+            "  <binary/>\n"
+            "</spectrum>";
+        auto cursor = XmlReader::Cursor{test, 0};
+        auto parsed_tag = XmlReader::read_tag(cursor);
+        CHECK(parsed_tag != std::nullopt);
+        if (parsed_tag) {
+            CHECK(parsed_tag->name == "cvParam");
+            CHECK(parsed_tag->attribute("accession") == "MS:1000579");
+            CHECK(parsed_tag->closed);
+        }
+        parsed_tag = XmlReader::read_tag(cursor);
+        CHECK(parsed_tag != std::nullopt);
+        if (parsed_tag) {
+            CHECK(parsed_tag->name == "binary");
+            CHECK(parsed_tag->num_attributes == 0);
+            CHECK(parsed_tag->closed);
+        }
+        parsed_tag = XmlReader::read_tag(cursor);
+        CHECK(parsed_tag != std::nullopt);
+        if (parsed_tag) {
+            CHECK(parsed_tag->name == "spectrum");
+            CHECK(parsed_tag->closed);
+        }
+        CHECK(XmlReader::read_tag(cursor) == std::nullopt);
+        CHECK_FALSE(cursor.good());
+    }
+    SUBCASE("Malformed tags") {
+        std::vector<std::string> table = {
+            "<testTag attr1=\"one two>",
+            "<testTag attr1=one>",
+            "<testTag attr1=\"one\"",
+        };
+        for (auto& test : table) {
+            auto cursor = XmlReader::Cursor{test, 0};
+            CHECK(XmlReader::read_tag(cursor) == std::nullopt);
+        }
+    }
+}
+
 TEST_CASE("Reading scans") {
     // TODO: We probably want to include our own published data instead.
     // TODO: We should move the definitions of this to a different file for
@@ -152,6 +246,428 @@ TEST_CASE("Reading scans") {
 }
 
 TEST_CASE("Reading mzidentml") {
-    // TODO:...
-    CHECK(true);
+    std::string data =
+        "<MzIdentML>\n<SequenceCollection>\n"
+        "<DBSequence id=\"DBSeq_1\" accession=\"P1\" "
+        "searchDatabase_ref=\"db\">\n"
+        "<cvParam accession=\"MS:1001088\" value=\"Protein 1\"/>\n"
+        "</DBSequence>\n"
+        "<DBSequence id=\"DBSeq_2\" accession=\"P2\" "
+        "searchDatabase_ref=\"db\"/>\n"
+        "<Peptide id=\"Pep_1\">\n"
+        "<PeptideSequence>PEPTIDEK</PeptideSequence>\n"
+        "<Modification location=\"3\" residues=\"T\" "
+        "monoisotopicMassDelta=\"79.966\">\n"
+        "<cvParam accession=\"UNIMOD:21\" name=\"Phospho\"/>\n"
+        "</Modification>\n"
+        "</Peptide>\n"
+        "<Peptide id=\"Pep_2\">\n"
+        "<PeptideSequence>ANOTHERK</PeptideSequence>\n"
+        "</Peptide>\n"
+        "<PeptideEvidence id=\"PE_1\" dBSequence_ref=\"DBSeq_1\" "
+        "peptide_ref=\"Pep_1\" isDecoy=\"false\"/>\n"
+        "<PeptideEvidence id=\"PE_2\" dBSequence_ref=\"DBSeq_2\" "
+        "peptide_ref=\"Pep_2\" isDecoy=\"true\">\n"
+        "</PeptideEvidence>\n"
+        "</SequenceCollection>\n"
+        "<SpectrumIdentificationList>\n"
+        "<SpectrumIdentificationResult id=\"SIR_1\">\n"
+        "<SpectrumIdentificationItem id=\"SII_1_1\" chargeState=\"2\" "
+        "experimentalMassToCharge=\"500.5\" "
+        "calculatedMassToCharge=\"500.4\" peptide_ref=\"Pep_2\" "
+        "rank=\"2\" passThreshold=\"false\">\n"
+        "</SpectrumIdentificationItem>\n"
+        "<SpectrumIdentificationItem id=\"SII_1_2\" chargeState=\"3\" "
+        "experimentalMassToCharge=\"600.5\" "
+        "calculatedMassToCharge=\"600.4\" peptide_ref=\"Pep_1\" "
+        "rank=\"1\" passThreshold=\"true\">\n"
+        "</SpectrumIdentificationItem>\n"
+        "<cvParam accession=\"MS:1000016\" value=\"2\" "
+        "unitAccession=\"UO:0000031\"/>\n"
+        "</SpectrumIdentificationResult>\n"
+        "</SpectrumIdentificationList>\n</MzIdentML>\n";
+    double inf = std::numeric_limits<double>::infinity();
+
+    SUBCASE("All identifications") {
+        auto ident_data = XmlReader::read_mzidentml(data, false, false, false,
+                                                    0, inf, 0, inf);
+        CHECK(ident_data.db_sequences.size() == 2);
+        const auto &ids = ident_data.ids;
+        CHECK(ids[ident_data.db_sequences[0].id] == "DBSeq_1");
+        // Each distinct id is stored once and shared by its references.
+        CHECK(ids.size() == 8);
+        CHECK(ident_data.db_sequences[0].accession == "P1");
+        CHECK(ident_data.db_sequences[0].description == "Protein 1");
+        CHECK(ident_data.db_sequences[1].description == "");
+        CHECK(ident_data.peptides.size() == 2);
+        CHECK(ident_data.peptides[0].sequence == "PEPTIDEK");
+        CHECK(ident_data.peptides[0].modifications.size() == 1);
+        if (ident_data.peptides[0].modifications.size() == 1) {
+            const auto &modification = ident_data.peptides[0].modifications[0];
+            CHECK(modification.monoisotopic_mass_delta == 79.966);
+            CHECK(modification.residues == "T");
+            CHECK(modification.location == 3);
+            CHECK(modification.id ==
+                  std::vector<std::string>{"UNIMOD:21|Phospho"});
+        }
+        CHECK(ident_data.peptides[1].modifications.empty());
+        CHECK(ident_data.peptide_evidence.size() == 2);
+        if (ident_data.peptide_evidence.size() == 2) {
+            CHECK(ident_data.peptide_evidence[1].decoy);
+            CHECK(ident_data.peptide_evidence[1].db_sequence_index == 1);
+            CHECK(ident_data.peptide_evidence[1].peptide_index == 1);
+            CHECK(ident_data.peptide_evidence[1].peptide_id ==
+                  ident_data.peptides[1].id);
+        }
+        CHECK(ident_data.spectrum_matches.size() == 2);
+        if (ident_data.spectrum_matches.size() == 2) {
+            const auto &psm = ident_data.spectrum_matches[1];
+            CHECK(ids[psm.id] == "SII_1_2");
+            CHECK(psm.pass_threshold);
+            CHECK(ids[psm.match_id] == "Pep_1");
+            CHECK(psm.match_index == 0);
+            CHECK(psm.charge_state == 3);
+            CHECK(psm.experimental_mz == 600.5);
+            CHECK(psm.theoretical_mz == 600.4);
+            CHECK(psm.retention_time == 120.0);
+            CHECK(psm.rank == 1);
+        }
+    }
+
+    SUBCASE("Filtered identifications") {
+        auto ident_data = XmlReader::read_mzidentml(data, true, false, true,
+                                                    0, inf, 0, inf);
+        CHECK(ident_data.peptide_evidence.size() == 1);
+        CHECK(ident_data.spectrum_matches.size() == 1);
+        if (ident_data.spectrum_matches.size() == 1) {
+            CHECK(ident_data.ids[ident_data.spectrum_matches[0].id] ==
+                  "SII_1_2");
+        }
+        // The ids of the skipped elements are not added to the pool.
+        CHECK(ident_data.ids.size() == 6);
+        ident_data = XmlReader::read_mzidentml(data, false, true, false, 0,
+                                               inf, 0, 100);
+        CHECK(ident_data.spectrum_matches.empty());
+        ident_data = XmlReader::read_mzidentml(data, false, true, false, 0,
+                                               inf, 0, inf);
+        CHECK(ident_data.spectrum_matches.size() == 1);
+    }
+
+    SUBCASE("Resolving references") {
+        auto ident_data = XmlReader::read_mzidentml(data, false, false, false,
+                                                    0, inf, 0, inf);
+        // The references resolved while parsing are the same as those
+        // resolved after the fact.
+        auto resolved = ident_data;
+        IdentData::resolve_references(resolved);
+        for (size_t i = 0; i < ident_data.spectrum_matches.size(); ++i) {
+            CHECK(ident_data.spectrum_matches[i].match_index ==
+                  resolved.spectrum_matches[i].match_index);
+        }
+        for (size_t i = 0; i < ident_data.peptide_evidence.size(); ++i) {
+            CHECK(ident_data.peptide_evidence[i].db_sequence_index ==
+                  resolved.peptide_evidence[i].db_sequence_index);
+            CHECK(ident_data.peptide_evidence[i].peptide_index ==
+                  resolved.peptide_evidence[i].peptide_index);
+        }
+
+        ident_data.spectrum_matches[0].match_index = IdentData::NO_INDEX;
+        ident_data.spectrum_matches[1].match_id =
+            IdentData::IdInterner(ident_data.ids).intern("Unknown");
+        ident_data.peptide_evidence[0].db_sequence_index = IdentData::NO_INDEX;
+        IdentData::resolve_references(ident_data);
+        CHECK(ident_data.spectrum_matches[0].match_index == 1);
+        CHECK(ident_data.spectrum_matches[1].match_index ==
+              IdentData::NO_INDEX);
+        CHECK(ident_data.peptide_evidence[0].db_sequence_index == 0);
+    }
+}
+
+TEST_CASE("Finding mzML spectrum offsets") {
+    std::string spectra =
+        "<mzML>\n<run>\n<spectrumList count=\"2\">\n"
+        "<spectrum index=\"0\" id=\"scan=1\">\n</spectrum>\n"
+        "<spectrum index=\"1\" id=\"scan=2\">\n</spectrum>\n"
+        "</spectrumList>\n</run>\n</mzML>\n";
+    size_t first = spectra.find("<spectrum ");
+    size_t second = spectra.find("<spectrum ", first + 1);
+    SUBCASE("Without index") {
+        auto offsets = XmlReader::find_mzml_spectrum_offsets(spectra);
+        CHECK(offsets.size() == 2);
+        if (offsets.size() == 2) {
+            CHECK(offsets[0] == first);
+            CHECK(offsets[1] == second);
+        }
+    }
+    SUBCASE("With index") {
+        auto make_index = [&](size_t offset_a, size_t offset_b) {
+            std::string data = spectra;
+            size_t index_offset = data.size();
+            data += "<indexList count=\"1\">\n<index name=\"spectrum\">\n";
+            data += "<offset idRef=\"scan=1\">" + std::to_string(offset_a) +
+                    "</offset>\n";
+            data += "<offset idRef=\"scan=2\">" + std::to_string(offset_b) +
+                    "</offset>\n";
+            data += "</index>\n</indexList>\n<indexListOffset>" +
+                    std::to_string(index_offset) + "</indexListOffset>\n";
+            return data;
+        };
+        auto data = make_index(first, second);
+        auto offsets = XmlReader::find_mzml_spectrum_offsets(data);
+        CHECK(offsets == std::vector<size_t>{first, second});
+
+        // Invalid offsets fall back to scanning the buffer.
+        data = make_index(first + 1, second);
+        offsets = XmlReader::find_mzml_spectrum_offsets(data);
+        CHECK(offsets == std::vector<size_t>{first, second});
+    }
+}
+
+TEST_CASE("Reading an indexed mzXML retention time range") {
+    // Peaks: (100.0, 10.0), (200.0, 20.0) as 64 bit network order pairs.
+    std::string peaks =
+        "<peaks precision=\"64\" byteOrder=\"network\" "
+        "contentType=\"m/z-int\">"
+        "QFkAAAAAAABAJAAAAAAAAEBpAAAAAAAAQDQAAAAAAAA=</peaks>\n";
+    std::string data = "<mzXML>\n<msRun scanCount=\"6\">\n";
+    std::vector<size_t> offsets;
+    for (size_t i = 1; i <= 4; ++i) {
+        offsets.push_back(data.size());
+        data += "<scan num=\"" + std::to_string(2 * i - 1) +
+                "\" msLevel=\"1\" peaksCount=\"2\" retentionTime=\"PT" +
+                std::to_string(i * 10) + ".5S\">\n" + peaks;
+        if (i == 2 || i == 3) {
+            // Nested MS2 scan.
+            offsets.push_back(data.size());
+            data += "<scan num=\"" + std::to_string(2 * i) +
+                    "\" msLevel=\"2\" peaksCount=\"2\" retentionTime=\"PT" +
+                    std::to_string(i * 10) + ".7S\">\n" +
+                    "<precursorMz precursorScanNum=\"" +
+                    std::to_string(2 * i - 1) + "\">100.0</precursorMz>\n" +
+                    peaks + "</scan>\n";
+        }
+        data += "</scan>\n";
+    }
+    data += "</msRun>\n";
+    auto add_index = [&](const std::string &data, size_t shift) {
+        std::string indexed = data;
+        size_t index_offset = indexed.size();
+        indexed += "<index name=\"scan\">\n";
+        for (size_t i = 0; i < offsets.size(); ++i) {
+            indexed += "<offset id=\"" + std::to_string(i + 1) + "\">" +
+                       std::to_string(offsets[i] + shift) + "</offset>\n";
+        }
+        indexed += "</index>\n<indexOffset>" + std::to_string(index_offset) +
+                   "</indexOffset>\n</mzXML>\n";
+        return indexed;
+    };
+
+    for (size_t shift : {0, 1}) {
+        auto indexed = add_index(data, shift);
+        auto ms1 = XmlReader::read_mzxml(indexed, 0, 1000, 25, 45,
+                                         Instrument::ORBITRAP, 70000, 30000,
+                                         200, Polarity::BOTH, 1);
+        CHECK(ms1 != std::nullopt);
+        if (ms1) {
+            CHECK(ms1->scans.size() == 2);
+            CHECK(ms1->retention_times == std::vector<double>{30.5, 40.5});
+            CHECK(ms1->scans[0].scan_number == 5);
+            CHECK(ms1->scans[0].mz == std::vector<double>{100.0, 200.0});
+            CHECK(ms1->scans[0].intensity == std::vector<double>{10.0, 20.0});
+        }
+        auto ms2 = XmlReader::read_mzxml(indexed, 0, 1000, 25, 35,
+                                         Instrument::ORBITRAP, 70000, 30000,
+                                         200, Polarity::BOTH, 2);
+        CHECK(ms2 != std::nullopt);
+        if (ms2) {
+            CHECK(ms2->scans.size() == 1);
+            CHECK(ms2->retention_times == std::vector<double>{30.7});
+            CHECK(ms2->scans[0].scan_number == 6);
+            CHECK(ms2->scans[0].precursor_information.scan_number == 5);
+        }
+    }
+}
+
+TEST_CASE("Parsing xs:duration values") {
+    CHECK(XmlReader::parse_duration("PT0S") == 0.0);
+    CHECK(XmlReader::parse_duration("PT35.25S") == 35.25);
+    CHECK(XmlReader::parse_duration("PT60S") == 60.0);
+    CHECK(XmlReader::parse_duration("PT.5S") == 0.5);
+    CHECK(XmlReader::parse_duration("PT2M") == 120.0);
+    CHECK(XmlReader::parse_duration("PT2M3.5S") == 123.5);
+    CHECK(XmlReader::parse_duration("PT1H") == 3600.0);
+    CHECK(XmlReader::parse_duration("PT1H30M") == 5400.0);
+    CHECK(XmlReader::parse_duration("PT1H2M3.5S") == 3723.5);
+    CHECK(XmlReader::parse_duration("PT1H3.5S") == 3603.5);
+    CHECK(XmlReader::parse_duration("P1D") == 86400.0);
+    CHECK(XmlReader::parse_duration("P1DT1S") == 86401.0);
+    CHECK(XmlReader::parse_duration("-PT10S") == -10.0);
+    CHECK(XmlReader::parse_duration(" PT10S ") == 10.0);
+
+    // Malformed values.
+    CHECK(XmlReader::parse_duration("") == std::nullopt);
+    CHECK(XmlReader::parse_duration("P") == std::nullopt);
+    CHECK(XmlReader::parse_duration("PT") == std::nullopt);
+    CHECK(XmlReader::parse_duration("35.25") == std::nullopt);
+    CHECK(XmlReader::parse_duration("T35.25S") == std::nullopt);
+    CHECK(XmlReader::parse_duration("PT35.25") == std::nullopt);
+    CHECK(XmlReader::parse_duration("PTS") == std::nullopt);
+    CHECK(XmlReader::parse_duration("PT.S") == std::nullopt);
+    CHECK(XmlReader::parse_duration("PT1.2.3S") == std::nullopt);
+    CHECK(XmlReader::parse_duration("PT1S2M") == std::nullopt);
+    CHECK(XmlReader::parse_duration("PT1M1M") == std::nullopt);
+    CHECK(XmlReader::parse_duration("P1H") == std::nullopt);
+    CHECK(XmlReader::parse_duration("PT1D") == std::nullopt);
+    CHECK(XmlReader::parse_duration("P1Y") == std::nullopt);
+    CHECK(XmlReader::parse_duration("PT1X") == std::nullopt);
+    CHECK(XmlReader::parse_duration("PT1S junk") == std::nullopt);
+}
+
+// An mzML spectrum with two peaks, stored as little endian 64 bit arrays:
+// {100.0, 200.0} and {10.0, 20.0}.
+static std::string mzml_spectrum(size_t index, size_t ms_level,
+                                 std::string rt) {
+    auto array = [](std::string accession, std::string data) {
+        return "<binaryDataArray>\n"
+               "<cvParam accession=\"MS:1000523\"/>\n"
+               "<cvParam accession=\"" +
+               accession + "\"/>\n<binary>" + data +
+               "</binary>\n</binaryDataArray>\n";
+    };
+    return "<spectrum index=\"" + std::to_string(index) + "\">\n" +
+           "<cvParam accession=\"MS:1000511\" value=\"" +
+           std::to_string(ms_level) + "\"/>\n" +
+           "<cvParam accession=\"MS:1000016\" value=\"" + rt +
+           "\" unitAccession=\"UO:0000010\"/>\n" +
+           array("MS:1000514", "AAAAAAAAWUAAAAAAAABpQA==") +
+           array("MS:1000515", "AAAAAAAAJEAAAAAAAAA0QA==") + "</spectrum>\n";
+}
+
+TEST_CASE("Reading several MS levels in a single pass") {
+    auto check_levels = [](const std::vector<RawData::RawData> &levels,
+                           const std::vector<RawData::RawData> &expected) {
+        CHECK(levels.size() == expected.size());
+        for (size_t i = 0; i < levels.size() && i < expected.size(); ++i) {
+            CHECK(levels[i].scans.size() == expected[i].scans.size());
+            CHECK(levels[i].retention_times == expected[i].retention_times);
+            CHECK(levels[i].min_mz == expected[i].min_mz);
+            CHECK(levels[i].max_mz == expected[i].max_mz);
+            for (size_t j = 0; j < levels[i].scans.size() &&
+                               j < expected[i].scans.size();
+                 ++j) {
+                const auto &scan = levels[i].scans[j];
+                const auto &expected_scan = expected[i].scans[j];
+                CHECK(scan.scan_number == expected_scan.scan_number);
+                CHECK(scan.ms_level == expected_scan.ms_level);
+                CHECK(scan.mz == expected_scan.mz);
+                CHECK(scan.intensity == expected_scan.intensity);
+                CHECK(scan.precursor_information.scan_number ==
+                      expected_scan.precursor_information.scan_number);
+            }
+        }
+    };
+
+    SUBCASE("mzXML") {
+        // Peaks: (100.0, 10.0), (200.0, 20.0) as 64 bit network order pairs.
+        std::string peaks =
+            "<peaks precision=\"64\" byteOrder=\"network\" "
+            "contentType=\"m/z-int\">"
+            "QFkAAAAAAABAJAAAAAAAAEBpAAAAAAAAQDQAAAAAAAA=</peaks>\n";
+        auto scan = [&](size_t num, size_t ms_level, std::string rt) {
+            return "<scan num=\"" + std::to_string(num) + "\" msLevel=\"" +
+                   std::to_string(ms_level) + "\" peaksCount=\"2\" " +
+                   "retentionTime=\"PT" + rt + "S\">\n" + peaks;
+        };
+        // MS1 scans with two nested MS2 scans, one of them with a nested MS3
+        // scan.
+        std::string data = "<mzXML>\n<msRun scanCount=\"6\">\n";
+        data += scan(1, 1, "10") + "</scan>\n";
+        data += scan(2, 1, "20") + scan(3, 2, "21") + scan(4, 3, "22") +
+                "</scan>\n</scan>\n" + scan(5, 2, "23") + "</scan>\n" +
+                "</scan>\n";
+        data += scan(6, 1, "30") + "</scan>\n";
+        data += "</msRun>\n</mzXML>\n";
+
+        auto read_level = [&](size_t ms_level) {
+            return XmlReader::read_mzxml(data, 0, 1000, 0, 100,
+                                         Instrument::ORBITRAP, 70000, 30000,
+                                         200, Polarity::BOTH, ms_level)
+                .value();
+        };
+        auto levels = XmlReader::read_mzxml_levels(
+            data, 0, 1000, 0, 100, Instrument::ORBITRAP, 70000, 30000, 200,
+            Polarity::BOTH, {1, 2, 3});
+        CHECK(levels != std::nullopt);
+        if (levels) {
+            check_levels(levels.value(),
+                         {read_level(1), read_level(2), read_level(3)});
+            CHECK(levels->at(0).retention_times ==
+                  std::vector<double>{10, 20, 30});
+            CHECK(levels->at(1).retention_times == std::vector<double>{21, 23});
+            CHECK(levels->at(2).retention_times == std::vector<double>{22});
+            if (levels->at(1).scans.size() == 2) {
+                CHECK(levels->at(1)
+                          .scans[0]
+                          .precursor_information.scan_number == 2);
+                CHECK(levels->at(1)
+                          .scans[1]
+                          .precursor_information.scan_number == 2);
+            }
+            if (levels->at(2).scans.size() == 1) {
+                CHECK(levels->at(2)
+                          .scans[0]
+                          .precursor_information.scan_number == 3);
+            }
+        }
+    }
+
+    SUBCASE("mzML") {
+        std::string data = "<mzML>\n<run>\n<spectrumList count=\"4\">\n";
+        data += mzml_spectrum(0, 1, "10") + mzml_spectrum(1, 2, "11") +
+                mzml_spectrum(2, 2, "12") + mzml_spectrum(3, 1, "20");
+        data += "</spectrumList>\n</run>\n</mzML>\n";
+
+        auto read_level = [&](size_t ms_level) {
+            return XmlReader::read_mzml(data, 0, 1000, 0, 100,
+                                        Instrument::ORBITRAP, 70000, 30000,
+                                        200, Polarity::BOTH, ms_level)
+                .value();
+        };
+        for (size_t max_threads : {1, 4}) {
+            auto levels = XmlReader::read_mzml_levels(
+                data, 0, 1000, 0, 100, Instrument::ORBITRAP, 70000, 30000,
+                200, Polarity::BOTH, {2, 1}, max_threads);
+            CHECK(levels != std::nullopt);
+            if (levels) {
+                check_levels(levels.value(), {read_level(2), read_level(1)});
+                CHECK(levels->at(0).retention_times ==
+                      std::vector<double>{11, 12});
+                CHECK(levels->at(1).retention_times ==
+                      std::vector<double>{10, 20});
+            }
+        }
+    }
+}
+
+TEST_CASE("Reading an mzML retention time range") {
+    // The reading stops at the first spectrum past max_rt, so the spectrum in
+    // range that comes after it is ignored.
+    std::string data = "<mzML>\n<run>\n<spectrumList count=\"40\">\n";
+    for (size_t i = 0; i < 39; ++i) {
+        data += mzml_spectrum(i, 1, std::to_string(i));
+    }
+    data += mzml_spectrum(39, 1, "5");
+    data += "</spectrumList>\n</run>\n</mzML>\n";
+    std::vector<double> expected;
+    for (size_t i = 3; i <= 10; ++i) {
+        expected.push_back(i);
+    }
+    for (size_t max_threads : {1, 4}) {
+        auto raw_data = XmlReader::read_mzml(
+            data, 0, 1000, 2.5, 10, Instrument::ORBITRAP, 70000, 30000, 200,
+            Polarity::BOTH, 1, max_threads);
+        REQUIRE(raw_data);
+        CHECK(raw_data->retention_times == expected);
+        CHECK(raw_data->scans.size() == expected.size());
+    }
 }